@@ -0,0 +1,138 @@
+/*
+Microbenchmark for the PBO copy kernels (CopyKernels.h). Copies a single BC4 luma plane for different frame sizes and
+source stride patterns with every kernel supported by the CPU and compares the bandwidth against plain memcpy. Every
+copy is also written to an unaligned destination offset, so that the unaligned head and tail of the kernels are checked.
+Note that the destination is ordinary cached memory here, in the player it is write-combined PBO memory where the
+difference between memcpy and streaming stores is usually larger.
+
+usage: CopyKernelsBench [iterations]
+*/
+#include "CopyKernels.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+struct FrameSize
+{
+	const char* name;
+	unsigned int width;
+	unsigned int height;
+};
+
+struct StridePattern
+{
+	const char* name;
+	unsigned int extraBytes; // added to the row size to get the source stride
+};
+
+static double runCopy(COPY_KERNEL kernel, unsigned char* dst, const unsigned char* src, unsigned int rows, unsigned int rowBytes, unsigned int srcStride, int iterations)
+{
+	bool plainMemcpy = kernel == COPY_KERNEL_MEMCPY;
+	setStreamCopyKernel(kernel);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int it = 0; it < iterations; it++)
+	{
+		if (plainMemcpy)
+		{
+			//the reference: what the upload threads did before, row by row for strided pictures
+			if (srcStride == rowBytes)
+			{
+				std::memcpy(dst, src, (size_t)rows * rowBytes);
+			}
+			else
+			{
+				for (unsigned int i = 0; i < rows; i++)
+				{
+					std::memcpy(dst + (size_t)i * rowBytes, src + (size_t)i * srcStride, rowBytes);
+				}
+			}
+		}
+		else
+		{
+			streamCopyRows(dst, src, rows, rowBytes, srcStride);
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 20;
+	if (iterations < 1)
+		iterations = 1;
+
+	const FrameSize frameSizes[] = {
+		{ "1080p", 1920, 1088 },
+		{ "4K", 3840, 2160 },
+		{ "8K", 7680, 4320 },
+		{ "16K", 15360, 8640 },
+	};
+	const StridePattern stridePatterns[] = {
+		{ "contiguous", 0 },
+		{ "+64B", 64 },
+		{ "+4KB", 4096 },
+	};
+	const COPY_KERNEL kernels[] = { COPY_KERNEL_MEMCPY, COPY_KERNEL_SSE2, COPY_KERNEL_AVX2, COPY_KERNEL_AVX512, COPY_KERNEL_NEON };
+	const unsigned int dstOffsets[] = { 0, 7 }; // in bytes, within the 64 bytes of slack of the destination
+	const unsigned char POISON = 0xCD;
+	const COPY_KERNEL defaultKernel = getStreamCopyKernel();
+
+	printf("default kernel: %s, %d iterations\n", copyKernelToString(defaultKernel), iterations);
+	printf("%-6s %-11s %-4s %-7s %10s %10s %8s\n", "frame", "stride", "dst", "kernel", "ms/plane", "GB/s", "speedup");
+
+	for (const FrameSize& frame : frameSizes)
+	{
+		unsigned int rows = frame.height / 4;        //one BC4 block row covers 4 pixel rows
+		unsigned int rowBytes = frame.width / 4 * 8; //8 bytes per BC4 block
+		for (const StridePattern& pattern : stridePatterns)
+		{
+			unsigned int srcStride = rowBytes + pattern.extraBytes;
+			std::vector<unsigned char> src((size_t)rows * srcStride);
+			std::vector<unsigned char> dst((size_t)rows * rowBytes + 64);
+			for (size_t i = 0; i < src.size(); i++)
+			{
+				src[i] = (unsigned char)(i * 31);
+			}
+
+			for (unsigned int dstOffset : dstOffsets)
+			{
+				unsigned char* out = dst.data() + dstOffset;
+				size_t copyEnd = dstOffset + (size_t)rows * rowBytes;
+				double memcpyMs = 0;
+				for (COPY_KERNEL kernel : kernels)
+				{
+					if (!isStreamCopyKernelSupported(kernel))
+						continue;
+					//a kernel that skips bytes must not pass with the copy of the kernel before it
+					std::memset(dst.data(), POISON, dst.size());
+					runCopy(kernel, out, src.data(), rows, rowBytes, srcStride, 1); //warm up
+					double ms = runCopy(kernel, out, src.data(), rows, rowBytes, srcStride, iterations);
+					if (kernel == COPY_KERNEL_MEMCPY)
+						memcpyMs = ms;
+					bool correct = true;
+					for (unsigned int i = 0; i < rows && correct; i++)
+					{
+						correct = std::memcmp(out + (size_t)i * rowBytes, src.data() + (size_t)i * srcStride, rowBytes) == 0;
+					}
+					//nothing may be written in front of or behind the copy
+					for (size_t i = 0; i < dst.size() && correct; i++)
+					{
+						correct = (i >= dstOffset && i < copyEnd) || dst[i] == POISON;
+					}
+					if (!correct)
+					{
+						printf("ERROR: kernel %s produced a wrong copy at destination offset %u\n", copyKernelToString(kernel), dstOffset);
+						return 1;
+					}
+					double gbs = ((double)rows * rowBytes) / (ms * 1e6);
+					printf("%-6s %-11s +%-3u %-7s %10.3f %10.2f %7.2fx\n", frame.name, pattern.name, dstOffset, copyKernelToString(kernel), ms, gbs, memcpyMs / ms);
+				}
+			}
+		}
+	}
+	setStreamCopyKernel(defaultKernel);
+	return 0;
+}
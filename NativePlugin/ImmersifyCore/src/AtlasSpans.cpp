@@ -0,0 +1,72 @@
+#include "AtlasSpans.h"
+
+/***********************************************************************************************/
+bool canAllocateSpan(const std::vector<AtlasSpan>& freeSpans, size_t end, size_t limit, size_t size)
+{
+	if (limit - end >= size)
+		return true;
+	for (size_t i = 0; i < freeSpans.size(); i++)
+	{
+		if (freeSpans[i].size >= size)
+			return true;
+	}
+	return false;
+}
+
+/***********************************************************************************************/
+size_t allocateSpan(std::vector<AtlasSpan>& freeSpans, size_t& end, size_t size)
+{
+	//the smallest free span that fits, otherwise behind the end
+	int best = -1;
+	for (size_t i = 0; i < freeSpans.size(); i++)
+	{
+		if (freeSpans[i].size >= size && (best < 0 || freeSpans[i].size < freeSpans[best].size))
+		{
+			best = (int)i;
+		}
+	}
+	if (best < 0)
+	{
+		size_t offset = end;
+		end += size;
+		return offset;
+	}
+	size_t offset = freeSpans[best].offset;
+	freeSpans[best].offset += size;
+	freeSpans[best].size -= size;
+	if (freeSpans[best].size == 0)
+	{
+		freeSpans.erase(freeSpans.begin() + best);
+	}
+	return offset;
+}
+
+/***********************************************************************************************/
+void releaseSpan(std::vector<AtlasSpan>& freeSpans, size_t& end, size_t offset, size_t size)
+{
+	//the spans are sorted by their offset, neighbours are merged and a span at the end moves the end back
+	size_t i = 0;
+	while (i < freeSpans.size() && freeSpans[i].offset < offset)
+	{
+		i++;
+	}
+	AtlasSpan span;
+	span.offset = offset;
+	span.size = size;
+	freeSpans.insert(freeSpans.begin() + i, span);
+	if (i + 1 < freeSpans.size() && freeSpans[i].offset + freeSpans[i].size == freeSpans[i + 1].offset)
+	{
+		freeSpans[i].size += freeSpans[i + 1].size;
+		freeSpans.erase(freeSpans.begin() + i + 1);
+	}
+	if (i > 0 && freeSpans[i - 1].offset + freeSpans[i - 1].size == freeSpans[i].offset)
+	{
+		freeSpans[i - 1].size += freeSpans[i].size;
+		freeSpans.erase(freeSpans.begin() + i);
+	}
+	if (!freeSpans.empty() && freeSpans.back().offset + freeSpans.back().size == end)
+	{
+		end = freeSpans.back().offset;
+		freeSpans.pop_back();
+	}
+}
@@ -0,0 +1,53 @@
+#include "AtlasTextureAccess.h"
+#include <string.h>
+
+/***********************************************************************************************/
+AtlasTextureAccess::AtlasTextureAccess(GlVideoAtlas* atlas, unsigned int width, unsigned int height, CHROMA_SUBSAMPLING chroma_subsampling) : BaseTextureAccess()
+{
+	m_width = width;
+	m_height = height;
+	m_chroma_subsampling = chroma_subsampling;
+	m_ready = false;
+	m_picIsStrided = true;
+	m_atlas = atlas;
+	m_region = atlas->addRegion(this, chroma_subsampling, width, height);
+}
+
+/***********************************************************************************************/
+AtlasTextureAccess::~AtlasTextureAccess()
+{
+	if (m_atlas)
+	{
+		m_atlas->removeRegion(m_region);
+	}
+}
+
+/***********************************************************************************************/
+void AtlasTextureAccess::detach()
+{
+	m_atlas = nullptr;
+	m_region = -1;
+	m_ready = false;
+}
+
+/***********************************************************************************************/
+void AtlasTextureAccess::getLayout(PackedTextureLayout& layout) const
+{
+	if (!m_atlas)
+	{
+		memset(&layout, 0, sizeof(PackedTextureLayout));
+		return;
+	}
+	m_atlas->getRegionLayout(m_region, layout);
+}
+
+/***********************************************************************************************/
+bool AtlasTextureAccess::applyPictureData(const Spin_Picture* pic)
+{
+	if (!m_atlas || m_region < 0)
+		return false;
+	if (!m_atlas->stage(m_region, pic, m_picIsStrided))
+		return false;
+	m_ready = true;
+	return true;
+}
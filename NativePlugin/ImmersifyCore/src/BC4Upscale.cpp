@@ -0,0 +1,61 @@
+#include "ScrubCache.h"
+#include <algorithm>
+#include <cstring>
+
+/***********************************************************************************************/
+static inline uint64_t upscaleBC4Block(uint64_t block, const uint8_t* sourceTexels)
+{
+	// 16 bit endpoints, followed by 16 indices of 3 bit in row major order
+	uint64_t indices = block >> 16;
+	uint64_t result = block & 0xFFFF;
+	for (int i = 0; i < 16; i++)
+	{
+		result |= ((indices >> (3 * sourceTexels[i])) & 7) << (16 + 3 * i);
+	}
+	return result;
+}
+
+/***********************************************************************************************/
+void upscaleBC4Picture(const Spin_Picture* src, int log2Scale, Spin_Picture* dst)
+{
+	const int scale = 1 << log2Scale;
+	// the texel of the source block for every texel of a destination block, per position of the destination block
+	// within the source block
+	uint8_t sourceTexels[1 << MAX_SCRUB_DOWNSCALE][1 << MAX_SCRUB_DOWNSCALE][16];
+	for (int qy = 0; qy < scale; qy++)
+	{
+		for (int qx = 0; qx < scale; qx++)
+		{
+			for (int i = 0; i < 16; i++)
+			{
+				sourceTexels[qy][qx][i] = (uint8_t)(((qy * 4 + i / 4) / scale) * 4 + (qx * 4 + i % 4) / scale);
+			}
+		}
+	}
+
+	for (int p = 0; p < 4; p++)
+	{
+		const Spin_Plane& srcPlane = src->asPlanes[p];
+		const Spin_Plane& dstPlane = dst->asPlanes[p];
+		if (!srcPlane.pPlane || !dstPlane.pPlane || srcPlane.iWidth <= 0 || srcPlane.iHeight <= 0)
+			continue;
+		for (int by = 0; by < dstPlane.iHeight; by++)
+		{
+			const uint8_t* srcRow = (const uint8_t*)srcPlane.pPlane + (size_t)(std::min)(by >> log2Scale, srcPlane.iHeight - 1) * srcPlane.iStride * 8;
+			uint8_t* dstRow = (uint8_t*)dstPlane.pPlane + (size_t)by * dstPlane.iStride * 8;
+			if (scale == 1)
+			{
+				memcpy(dstRow, srcRow, (size_t)(std::min)(srcPlane.iWidth, dstPlane.iWidth) * 8);
+				continue;
+			}
+			const uint8_t(*rowTexels)[16] = sourceTexels[by & (scale - 1)];
+			for (int bx = 0; bx < dstPlane.iWidth; bx++)
+			{
+				uint64_t block;
+				memcpy(&block, srcRow + (size_t)(std::min)(bx >> log2Scale, srcPlane.iWidth - 1) * 8, 8);
+				block = upscaleBC4Block(block, rowTexels[bx & (scale - 1)]);
+				memcpy(dstRow + (size_t)bx * 8, &block, 8);
+			}
+		}
+	}
+}
@@ -0,0 +1,164 @@
+#include "BottleneckClassifier.h"
+#include "BaseTextureAccess.h"
+#include <stdio.h>
+#include <string.h>
+
+// the target frame rate counts as reached above this fraction of it
+const double BOTTLENECK_FPS_TOLERANCE = 0.95;
+
+/***********************************************************************************************/
+BottleneckClassifier::BottleneckClassifier()
+{
+	m_hasBaseline = false;
+	m_lastBottleneck = BOTTLENECK_UNKNOWN;
+	memset(&m_baseline, 0, sizeof(PlayerStats));
+	restart();
+}
+
+/***********************************************************************************************/
+void BottleneckClassifier::restart()
+{
+	m_windowStartMs = -1;
+	m_lastUpdateMs = -1;
+	m_updateIntervalSumMs = 0;
+	m_numUpdates = 0;
+	m_queueSizeSum = 0;
+	m_hasBaseline = false;
+}
+
+/***********************************************************************************************/
+bool BottleneckClassifier::addSample(double nowMs, int queueSize)
+{
+	if (m_windowStartMs < 0)
+	{
+		m_windowStartMs = nowMs;
+	}
+	if (m_lastUpdateMs >= 0)
+	{
+		m_updateIntervalSumMs += nowMs - m_lastUpdateMs;
+		m_numUpdates++;
+		m_queueSizeSum += queueSize;
+	}
+	m_lastUpdateMs = nowMs;
+	return nowMs - m_windowStartMs >= BOTTLENECK_WINDOW_MS;
+}
+
+/***********************************************************************************************/
+static double getSum(const LatencyStats& stats)
+{
+	return stats.meanMS * stats.count;
+}
+
+/***********************************************************************************************/
+static double perFrame(double sumMs, int64_t count)
+{
+	return count > 0 ? sumMs / count : 0;
+}
+
+/***********************************************************************************************/
+bool BottleneckClassifier::classify(double nowMs, const PlayerStats& stats, double targetFPS, int maxQueueSize, double gpuUploadMs, BottleneckReport& report)
+{
+	const PlayerStats& base = m_baseline;
+	bool valid = m_hasBaseline && m_numUpdates > 0 && targetFPS > 0 &&
+		stats.numDecodedFrames >= base.numDecodedFrames && stats.numPresentedFrames >= base.numPresentedFrames; //not reset in between
+	double windowMs = nowMs - m_windowStartMs;
+	int64_t numDecoded = stats.numDecodedFrames - base.numDecodedFrames;
+	int64_t numPresented = stats.numPresentedFrames - base.numPresentedFrames;
+
+	memset(&report, 0, sizeof(BottleneckReport));
+	report.version = BOTTLENECK_REPORT_VERSION;
+	report.size = sizeof(BottleneckReport);
+	report.bottleneck = BOTTLENECK_UNKNOWN;
+	report.windowMS = windowMs;
+	report.targetFPS = targetFPS;
+	report.gpuUploadMS = gpuUploadMs;
+	if (valid)
+	{
+		report.presentedFPS = numPresented * 1000.0 / windowMs;
+		report.decodedFPS = numDecoded * 1000.0 / windowMs;
+		report.readMSPerFrame = perFrame(getSum(stats.readTime) - getSum(base.readTime), numDecoded);
+		report.decodeMSPerFrame = perFrame(getSum(stats.decodeTime) - getSum(base.decodeTime), numDecoded);
+		report.uploadMSPerFrame = perFrame(getSum(stats.uploadTime) - getSum(base.uploadTime), stats.uploadTime.count - base.uploadTime.count);
+		report.updateIntervalMS = m_updateIntervalSumMs / m_numUpdates;
+		report.queueFill = maxQueueSize > 0 ? (double)m_queueSizeSum / m_numUpdates / maxQueueSize : 0;
+		report.numUnderruns = stats.numUnderruns - base.numUnderruns;
+		report.numDroppedFrames = stats.numDroppedFrames - base.numDroppedFrames;
+
+		double frameBudgetMs = 1000.0 / targetFPS;
+		if (report.presentedFPS >= BOTTLENECK_FPS_TOLERANCE * targetFPS)
+		{
+			report.bottleneck = BOTTLENECK_NONE;
+		}
+		else if (report.queueFill >= 0.5 && report.numUnderruns == 0)
+		{
+			// frames are waiting for the render thread
+			double uploadMs = report.uploadMSPerFrame + (gpuUploadMs > 0 ? gpuUploadMs : 0);
+			bool uploadBound = report.numDroppedFrames > 0 || uploadMs > 0.5 * frameBudgetMs;
+			report.bottleneck = uploadBound && report.updateIntervalMS <= frameBudgetMs ? BOTTLENECK_UPLOAD : BOTTLENECK_RENDER_CADENCE;
+		}
+		else if (report.updateIntervalMS > frameBudgetMs / BOTTLENECK_FPS_TOLERANCE)
+		{
+			report.bottleneck = BOTTLENECK_RENDER_CADENCE;
+		}
+		else
+		{
+			report.bottleneck = report.readMSPerFrame > report.decodeMSPerFrame ? BOTTLENECK_IO : BOTTLENECK_DECODE;
+		}
+	}
+
+	restart();
+	m_windowStartMs = nowMs;
+	m_lastUpdateMs = nowMs;
+	m_baseline = stats;
+	m_hasBaseline = true;
+
+	bool changed = report.bottleneck != m_lastBottleneck && report.bottleneck != BOTTLENECK_UNKNOWN;
+	if (report.bottleneck != BOTTLENECK_UNKNOWN)
+	{
+		m_lastBottleneck = (BOTTLENECK)report.bottleneck;
+	}
+	return changed;
+}
+
+/***********************************************************************************************/
+const char* BottleneckClassifier::getName(BOTTLENECK bottleneck)
+{
+	switch (bottleneck)
+	{
+	case BOTTLENECK_NONE: return "no bottleneck";
+	case BOTTLENECK_IO: return "I/O starved";
+	case BOTTLENECK_DECODE: return "decode bound";
+	case BOTTLENECK_UPLOAD: return "upload bound";
+	case BOTTLENECK_RENDER_CADENCE: return "render-thread cadence";
+	default: return "unknown";
+	}
+}
+
+/***********************************************************************************************/
+static const char* getChromaName(int chroma)
+{
+	switch (chroma)
+	{
+	case _400: return "400";
+	case _422: return "422";
+	case _444: return "444";
+	case _4444: return "4444";
+	default: return "420";
+	}
+}
+
+/***********************************************************************************************/
+void BottleneckClassifier::describe(const BottleneckReport& report, char* buffer, int bufferSize)
+{
+	if (!buffer || bufferSize <= 0)
+		return;
+	if (report.bottleneck == BOTTLENECK_UNKNOWN)
+	{
+		snprintf(buffer, bufferSize, "%s", getName(BOTTLENECK_UNKNOWN));
+		return;
+	}
+	snprintf(buffer, bufferSize, "%s at %dx%d %s, %.1f fps sustained (target %.1f, decoded %.1f): read %.2f ms, decode %.2f ms, upload %.2f ms (GPU %.2f ms) per frame, update every %.2f ms, queue %.0f%% full, %lld underruns, %lld dropped",
+		getName((BOTTLENECK)report.bottleneck), report.width, report.height, getChromaName(report.chroma), report.presentedFPS, report.targetFPS, report.decodedFPS,
+		report.readMSPerFrame, report.decodeMSPerFrame, report.uploadMSPerFrame, report.gpuUploadMS, report.updateIntervalMS, report.queueFill * 100.0,
+		(long long)report.numUnderruns, (long long)report.numDroppedFrames);
+}
@@ -0,0 +1,132 @@
+#include "Cadence.h"
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+
+/***********************************************************************************************/
+static int64_t greatestCommonDivisor(int64_t a, int64_t b)
+{
+	while (b != 0)
+	{
+		int64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/***********************************************************************************************/
+Cadence::Cadence()
+{
+	m_frameRateNum = 0;
+	m_frameRateDen = 1;
+	m_refreshNum = 0;
+	m_refreshDen = 1;
+}
+
+/***********************************************************************************************/
+void Cadence::set(int64_t frameRateNum, int64_t frameRateDen, double refreshRateHz)
+{
+	m_frameRateNum = 0;
+	m_frameRateDen = 1;
+	m_refreshNum = 0;
+	m_refreshDen = 1;
+	if (frameRateNum <= 0 || frameRateDen <= 0 || refreshRateHz <= 0)
+		return;
+	int64_t divisor = greatestCommonDivisor(frameRateNum, frameRateDen);
+	m_frameRateNum = frameRateNum / divisor;
+	m_frameRateDen = frameRateDen / divisor;
+
+	// the NTSC rates (59.94, 119.88 Hz) are reported rounded, so they are snapped to n * 1000 / 1001
+	double ntsc = refreshRateHz * 1.001;
+	if (std::fabs(ntsc - std::floor(ntsc + 0.5)) < 0.01 && std::fabs(refreshRateHz - std::floor(refreshRateHz + 0.5)) > 0.01)
+	{
+		m_refreshNum = (int64_t)std::floor(ntsc + 0.5) * 1000;
+		m_refreshDen = 1001;
+	}
+	else
+	{
+		m_refreshNum = (int64_t)std::floor(refreshRateHz * 1000.0 + 0.5);
+		m_refreshDen = 1000;
+	}
+	divisor = greatestCommonDivisor(m_refreshNum, m_refreshDen);
+	m_refreshNum /= divisor;
+	m_refreshDen /= divisor;
+}
+
+/***********************************************************************************************/
+double Cadence::getVsyncInterval() const
+{
+	return isActive() ? 1000.0 * m_refreshDen / m_refreshNum : 0;
+}
+
+/***********************************************************************************************/
+double Cadence::getFrameDuration() const
+{
+	return isActive() ? 1000.0 * m_frameRateDen / m_frameRateNum : 0;
+}
+
+/***********************************************************************************************/
+int64_t Cadence::getFrame(double ms) const
+{
+	return (int64_t)std::floor(ms * m_frameRateNum / (1000.0 * m_frameRateDen) + 0.5);
+}
+
+/***********************************************************************************************/
+int64_t Cadence::getVsync(int64_t frame) const
+{
+	// round(frame * refresh / frameRate) = floor((2 * frame * refresh + frameRate) / (2 * frameRate)) on integers
+	int64_t num = frame * m_refreshNum * m_frameRateDen;
+	int64_t den = m_refreshDen * m_frameRateNum;
+	int64_t value = 2 * num + den;
+	int64_t result = value / (2 * den);
+	if (value < 0 && result * 2 * den != value)
+		result--; //floor for the frames before the first one
+	return result;
+}
+
+/***********************************************************************************************/
+void Cadence::describe(char* buffer, int bufferSize) const
+{
+	if (!buffer || bufferSize <= 0)
+		return;
+	if (!isActive())
+	{
+		snprintf(buffer, bufferSize, "no cadence");
+		return;
+	}
+
+	// the shortest pattern that is closest to the exact ratio of vsyncs per frame
+	double vsyncsPerFrame = (double)(m_refreshNum * m_frameRateDen) / (double)(m_refreshDen * m_frameRateNum);
+	int length = 1;
+	double bestError = 1.0;
+	for (int i = 1; i <= MAX_CADENCE_PATTERN; i++)
+	{
+		double vsyncs = vsyncsPerFrame * i;
+		double error = vsyncs - std::floor(vsyncs + 0.5);
+		if (std::fabs(error) < std::fabs(bestError) - 1e-9)
+		{
+			bestError = error;
+			length = i;
+		}
+	}
+
+	char pattern[64] = "";
+	int shown = length < 2 ? 2 : length;
+	for (int i = 0; i < shown; i++)
+	{
+		char entry[16];
+		snprintf(entry, sizeof(entry), i == 0 ? "%d" : ":%d", getNumVsyncs(i));
+		strncat(pattern, entry, sizeof(pattern) - strlen(pattern) - 1);
+	}
+	double fps = (double)m_frameRateNum / m_frameRateDen;
+	double hz = (double)m_refreshNum / m_refreshDen;
+	if (std::fabs(bestError) < 1e-9)
+	{
+		snprintf(buffer, bufferSize, "%s (%.3f fps at %.2f Hz)", pattern, fps, hz);
+	}
+	else
+	{
+		snprintf(buffer, bufferSize, "%s, one vsync %s every %.0f frames (%.3f fps at %.2f Hz)", pattern, bestError > 0 ? "more" : "less", length / std::fabs(bestError), fps, hz);
+	}
+}
@@ -0,0 +1,341 @@
+#include "CopyKernels.h"
+#include <cstring>
+#include <stdint.h>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define COPY_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define COPY_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC compiles every intrinsic without extra flags, gcc and clang need the target attribute per function
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+const size_t MIN_STREAM_COPY_BYTES = 4096;   //below this size streaming stores are not worth it
+const size_t PREFETCH_DISTANCE = 512;        //bytes ahead of the current source position
+
+typedef void(*CopyBodyFunc)(unsigned char* dst, const unsigned char* src, size_t size);
+
+/***********************************************************************************************/
+static void copyBodyMemcpy(unsigned char* dst, const unsigned char* src, size_t size)
+{
+	std::memcpy(dst, src, size);
+}
+
+#if COPY_KERNELS_X86
+/***********************************************************************************************/
+static void copyBodySSE2(unsigned char* dst, const unsigned char* src, size_t size)
+{
+	size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+	if (head > size)
+		head = size;
+	std::memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	size -= head;
+
+	size_t blocks = size / 64;
+	for (size_t i = 0; i < blocks; i++)
+	{
+		_mm_prefetch((const char*)src + PREFETCH_DISTANCE, _MM_HINT_T0);
+		__m128i a = _mm_loadu_si128((const __m128i*)(src + 0));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+		__m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+		_mm_stream_si128((__m128i*)(dst + 0), a);
+		_mm_stream_si128((__m128i*)(dst + 16), b);
+		_mm_stream_si128((__m128i*)(dst + 32), c);
+		_mm_stream_si128((__m128i*)(dst + 48), d);
+		src += 64;
+		dst += 64;
+	}
+	std::memcpy(dst, src, size - blocks * 64);
+}
+
+/***********************************************************************************************/
+TARGET_AVX2 static void copyBodyAVX2(unsigned char* dst, const unsigned char* src, size_t size)
+{
+	size_t head = (32 - ((uintptr_t)dst & 31)) & 31;
+	if (head > size)
+		head = size;
+	std::memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	size -= head;
+
+	size_t blocks = size / 128;
+	for (size_t i = 0; i < blocks; i++)
+	{
+		_mm_prefetch((const char*)src + PREFETCH_DISTANCE, _MM_HINT_T0);
+		_mm_prefetch((const char*)src + PREFETCH_DISTANCE + 64, _MM_HINT_T0);
+		__m256i a = _mm256_loadu_si256((const __m256i*)(src + 0));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + 32));
+		__m256i c = _mm256_loadu_si256((const __m256i*)(src + 64));
+		__m256i d = _mm256_loadu_si256((const __m256i*)(src + 96));
+		_mm256_stream_si256((__m256i*)(dst + 0), a);
+		_mm256_stream_si256((__m256i*)(dst + 32), b);
+		_mm256_stream_si256((__m256i*)(dst + 64), c);
+		_mm256_stream_si256((__m256i*)(dst + 96), d);
+		src += 128;
+		dst += 128;
+	}
+	std::memcpy(dst, src, size - blocks * 128);
+}
+
+/***********************************************************************************************/
+TARGET_AVX512 static void copyBodyAVX512(unsigned char* dst, const unsigned char* src, size_t size)
+{
+	size_t head = (64 - ((uintptr_t)dst & 63)) & 63;
+	if (head > size)
+		head = size;
+	std::memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	size -= head;
+
+	size_t blocks = size / 256;
+	for (size_t i = 0; i < blocks; i++)
+	{
+		for (size_t p = 0; p < 256; p += 64)
+		{
+			_mm_prefetch((const char*)src + PREFETCH_DISTANCE + p, _MM_HINT_T0);
+		}
+		__m512i a = _mm512_loadu_si512((const void*)(src + 0));
+		__m512i b = _mm512_loadu_si512((const void*)(src + 64));
+		__m512i c = _mm512_loadu_si512((const void*)(src + 128));
+		__m512i d = _mm512_loadu_si512((const void*)(src + 192));
+		_mm512_stream_si512((__m512i*)(dst + 0), a);
+		_mm512_stream_si512((__m512i*)(dst + 64), b);
+		_mm512_stream_si512((__m512i*)(dst + 128), c);
+		_mm512_stream_si512((__m512i*)(dst + 192), d);
+		src += 256;
+		dst += 256;
+	}
+	std::memcpy(dst, src, size - blocks * 256);
+}
+#endif
+
+#if COPY_KERNELS_NEON
+/***********************************************************************************************/
+static void copyBodyNEON(unsigned char* dst, const unsigned char* src, size_t size)
+{
+	//there is no streaming store intrinsic on ARM, but the wide loads/stores and the prefetch still help
+	size_t blocks = size / 64;
+	for (size_t i = 0; i < blocks; i++)
+	{
+#if !defined(_MSC_VER)
+		__builtin_prefetch(src + PREFETCH_DISTANCE, 0, 0);
+#endif
+		uint8x16x4_t v = vld1q_u8_x4(src);
+		vst1q_u8_x4(dst, v);
+		src += 64;
+		dst += 64;
+	}
+	std::memcpy(dst, src, size - blocks * 64);
+}
+#endif
+
+/***********************************************************************************************/
+#if COPY_KERNELS_X86
+static void cpuid(int info[4], int leaf, int subleaf)
+{
+#if defined(_MSC_VER)
+	__cpuidex(info, leaf, subleaf);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	info[0] = (int)a;
+	info[1] = (int)b;
+	info[2] = (int)c;
+	info[3] = (int)d;
+#endif
+}
+
+static uint64_t xgetbv0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif
+
+/***********************************************************************************************/
+bool isStreamCopyKernelSupported(COPY_KERNEL kernel)
+{
+	switch (kernel)
+	{
+	case COPY_KERNEL_MEMCPY:
+		return true;
+#if COPY_KERNELS_X86
+	case COPY_KERNEL_SSE2:
+	case COPY_KERNEL_AVX2:
+	case COPY_KERNEL_AVX512:
+	{
+		int info[4];
+		cpuid(info, 0, 0);
+		int maxLeaf = info[0];
+		cpuid(info, 1, 0);
+		bool sse2 = (info[3] & (1 << 26)) != 0;
+		if (kernel == COPY_KERNEL_SSE2)
+			return sse2;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || maxLeaf < 7)
+			return false;
+		uint64_t xcr0 = xgetbv0();
+		if ((xcr0 & 0x6) != 0x6) //OS saves xmm and ymm state
+			return false;
+		cpuid(info, 7, 0);
+		if (kernel == COPY_KERNEL_AVX2)
+			return (info[1] & (1 << 5)) != 0;
+		return (info[1] & (1 << 16)) != 0 && (xcr0 & 0xE6) == 0xE6; //avx512f and OS saves opmask and zmm state
+	}
+#endif
+#if COPY_KERNELS_NEON
+	case COPY_KERNEL_NEON:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+/***********************************************************************************************/
+static CopyBodyFunc getCopyBody(COPY_KERNEL kernel)
+{
+	switch (kernel)
+	{
+#if COPY_KERNELS_X86
+	case COPY_KERNEL_SSE2: return copyBodySSE2;
+	case COPY_KERNEL_AVX2: return copyBodyAVX2;
+	case COPY_KERNEL_AVX512: return copyBodyAVX512;
+#endif
+#if COPY_KERNELS_NEON
+	case COPY_KERNEL_NEON: return copyBodyNEON;
+#endif
+	default: return copyBodyMemcpy;
+	}
+}
+
+/***********************************************************************************************/
+static COPY_KERNEL detectBestKernel()
+{
+	const COPY_KERNEL candidates[] = { COPY_KERNEL_AVX512, COPY_KERNEL_AVX2, COPY_KERNEL_SSE2, COPY_KERNEL_NEON };
+	for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++)
+	{
+		if (isStreamCopyKernelSupported(candidates[i]))
+			return candidates[i];
+	}
+	return COPY_KERNEL_MEMCPY;
+}
+
+// COPY_KERNEL, can be changed while the upload workers copy. Every copy reads it once, so its body and fence match.
+static std::atomic<int> s_kernel(detectBestKernel());
+
+/***********************************************************************************************/
+static inline void streamFence(COPY_KERNEL kernel)
+{
+	//streaming stores are weakly ordered, they have to be visible before another thread is told that the copy is done
+#if COPY_KERNELS_X86
+	if (kernel != COPY_KERNEL_MEMCPY)
+		_mm_sfence();
+#endif
+}
+
+/***********************************************************************************************/
+void streamCopy(unsigned char* dst, const unsigned char* src, size_t size)
+{
+	if (size < MIN_STREAM_COPY_BYTES)
+	{
+		std::memcpy(dst, src, size);
+		return;
+	}
+	COPY_KERNEL kernel = (COPY_KERNEL)s_kernel.load(std::memory_order_relaxed);
+	getCopyBody(kernel)(dst, src, size);
+	streamFence(kernel);
+}
+
+/***********************************************************************************************/
+void streamCopyRows(unsigned char* dst, const unsigned char* src, unsigned int rows, unsigned int rowBytes, unsigned int srcStride)
+{
+	streamCopyRows(dst, rowBytes, src, srcStride, rows, rowBytes);
+}
+
+/***********************************************************************************************/
+void streamCopyRows(unsigned char* dst, unsigned int dstStride, const unsigned char* src, unsigned int srcStride, unsigned int rows, unsigned int rowBytes)
+{
+	if (srcStride == rowBytes && dstStride == rowBytes)
+	{
+		streamCopy(dst, src, (size_t)rows * rowBytes);
+		return;
+	}
+	if ((size_t)rows * rowBytes < MIN_STREAM_COPY_BYTES)
+	{
+		for (unsigned int i = 0; i < rows; i++)
+		{
+			std::memcpy(dst + (size_t)i * dstStride, src + (size_t)i * srcStride, rowBytes);
+		}
+		return;
+	}
+	COPY_KERNEL kernel = (COPY_KERNEL)s_kernel.load(std::memory_order_relaxed);
+	CopyBodyFunc copyBody = getCopyBody(kernel);
+	for (unsigned int i = 0; i < rows; i++)
+	{
+#if COPY_KERNELS_X86
+		//the in-row prefetch does not reach the next row when the source is strided
+		if (i + 1 < rows)
+			_mm_prefetch((const char*)(src + srcStride), _MM_HINT_T0);
+#endif
+		copyBody(dst, src, rowBytes);
+		dst += dstStride;
+		src += srcStride;
+	}
+	streamFence(kernel);
+}
+
+/***********************************************************************************************/
+COPY_KERNEL getStreamCopyKernel()
+{
+	return (COPY_KERNEL)s_kernel.load(std::memory_order_relaxed);
+}
+
+/***********************************************************************************************/
+bool setStreamCopyKernel(COPY_KERNEL kernel)
+{
+	if (!isStreamCopyKernelSupported(kernel))
+		return false;
+	s_kernel.store(kernel, std::memory_order_relaxed); //copies that already started finish with the previous kernel
+	return true;
+}
+
+/***********************************************************************************************/
+const char* copyKernelToString(COPY_KERNEL kernel)
+{
+	switch (kernel)
+	{
+	case COPY_KERNEL_MEMCPY: return "memcpy";
+	case COPY_KERNEL_SSE2: return "sse2";
+	case COPY_KERNEL_AVX2: return "avx2";
+	case COPY_KERNEL_AVX512: return "avx512";
+	case COPY_KERNEL_NEON: return "neon";
+	default: return "unknown";
+	}
+}
@@ -6,6 +6,9 @@
 #include <Utils.h>
 #include <bitset> 
 #include <AppUtils.h>
+#include "PlayerEvents.h"
+#include "Logger.h"
+#include "Tracer.h"
 
 using namespace std;
 const int DEFAULT_BUFFER_QUEUE_MAX_SIZE = 16;
@@ -17,16 +20,16 @@ void printErrorCode(int err)
 	switch (err)
 	{
 	case SD_E_LICENSECONTAINER_NOT_FOUND:
-		cout << "LICENSECONTAINER_NOT_FOUND" << endl;
+		LOG_ERROR("LICENSECONTAINER_NOT_FOUND");
 		break;
 	case SD_E_LICENSE_NOT_FOUND:
-		cout << "LICENSE_NOT_FOUND" << endl;
+		LOG_ERROR("LICENSE_NOT_FOUND");
 		break;
 	case SD_E_FEATURE_NOT_AVAILABLE:
-		cout << "FEATURE_NOT_AVAILABLE" << endl;
+		LOG_ERROR("FEATURE_NOT_AVAILABLE");
 		break;
 	default:
-		cout << "Error code not found: " << err << endl;
+		LOG_ERROR("Error code not found: " << err);
 		return;
 	}
 }
@@ -39,17 +42,25 @@ DWORD WINAPI decodeThread(void* Param)
 	pkt.data = NULL;
 	pkt.size = 0;
 	Decoder* This = (Decoder*)Param;
+	Tracer::setThreadName("decoder");
 	while (This->isActive)
 	{
 		if (This->decode(pkt) < 0)
 		{
-			cout << "decoder error!" << endl;
+			LOG_ERROR("decoder error!");
 			return -1;
 		}
 	}
 	return 0;
 }
 
+/***********************************************************************************************/
+static int interruptCallback(void* opaque)
+{
+	// polled by ffmpeg while it blocks on I/O, a non zero value lets the call return with an error
+	return ((Decoder*)opaque)->isReopenRequested() ? 1 : 0;
+}
+
 /***********************************************************************************************/
 Decoder::Decoder()
 {
@@ -57,6 +68,19 @@ Decoder::Decoder()
 	m_bDescriptInitialized = false;
 	m_bVideoIsSeekable = false;
 	m_iOutframes = 0;
+	m_outPtsMS = 0;
+	m_timeBase.num = 1;
+	m_timeBase.den = 1000;
+	m_startPts = 0;
+	m_lastPtsMS = -1;
+	m_timelineStart = true;
+	m_requestedDiscardMode = SE_FDM_None;
+	m_discardMode = SE_FDM_None;
+	m_skipUntilPtsMS = -1;
+	m_requestedScrubDownScale = -1;
+	m_scrubDownScale = -1;
+	m_scrubToMSecond = -1;
+	m_scrubPtsMS = -1;
 	m_hHEVCDecoder = NULL;
 	m_pNalUnit = NULL;
 	m_picOut = NULL;
@@ -64,6 +88,12 @@ Decoder::Decoder()
 	m_streamIndex = -1;
 	m_decodingTime = 0;
 	m_avformatContext = 0;
+	thandle = NULL;
+	isActive = false;
+	m_outPicIsStrided = false;
+	m_numStridedPictures = 0;
+	m_heartbeats = nullptr;
+	m_reopenRequested = false;
 }
 
 /***********************************************************************************************/
@@ -75,7 +105,9 @@ Decoder::~Decoder()
 /***********************************************************************************************/
 void Decoder::stop()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	isActive = false;
+	m_cv.notify_all(); // wake up the decode thread if it is waiting for free space in the queue
 }
 
 /***********************************************************************************************/
@@ -107,7 +139,7 @@ void Decoder::createDecoder(int iNumOutPictureBuffer, int iNumThreads, int maxQu
 	int res = readLicenseConfig(sLicConfig);  //read liceense configuration from config file (licenseconfig.txt)
 	if (res != 0) {
 		//if reading license configuration failed, set pLicConfg to NULL pointer,
-		printf("Warning: read license configuration failed\n");
+		LOG_WARNING("read license configuration failed");
 	}
 	// initialize license
 	if (SpinLib_InitLicense(&sLicConfig)) {
@@ -116,17 +148,28 @@ void Decoder::createDecoder(int iNumOutPictureBuffer, int iNumThreads, int maxQu
 
 	m_sDecParam.bCalcHash = 0;
 	m_sDecParam.ePixFmtMeth = SE_PFCAT_BC4;
+	m_sDecParam.fLogFunc = Logger::spinLogFunc;
+	m_sDecParam.hLogHandle = NULL;
+	m_sDecParam.eDiscardMode = (SE_FrameDiscardMode)m_requestedDiscardMode.load();
+	m_discardMode = m_sDecParam.eDiscardMode;
 	m_currentErrorCode = SpinDecLib_Open(&m_hHEVCDecoder, &m_sDecParam);
 	printErrorCode(m_currentErrorCode);
 	m_iOutframes = 0;
+	m_outPtsMS = 0;
+	m_lastPtsMS = -1;
+	m_timelineStart = true;
 }
 
 /***********************************************************************************************/
 void Decoder::destroy()
 {
-	isActive = false;
-	WaitForSingleObject(thandle, INFINITE);
-	CloseHandle(thandle);
+	stop();
+	if (thandle)
+	{
+		WaitForSingleObject(thandle, INFINITE);
+		CloseHandle(thandle);
+		thandle = NULL;
+	}
 
 	if (m_hHEVCDecoder)
 	{
@@ -137,11 +180,17 @@ void Decoder::destroy()
 		// empty picture buffers
 		std::list<PictureContainer*>::iterator ppic = m_lDecPicPool.begin();
 		for (; ppic != m_lDecPicPool.end(); ppic++) {
-			SpinLib_FreeFrame(&(*ppic)->pHEVCPic->sPic);
+			if ((*ppic)->externalMemory) {
+				m_pictureMemory->releasePicture((*ppic)->pHEVCPic->sPic.pPlanesData);
+			}
+			else {
+				SpinLib_FreeFrame(&(*ppic)->pHEVCPic->sPic);
+			}
 			delete (*ppic)->pHEVCPic;
 			delete *ppic;
 		}
 		m_lDecPicPool.clear();
+		m_scrubCache.clear();
 
 		memset(&m_sDecParam, 0, sizeof(SpinDec_Param));
 		m_hHEVCDecoder = NULL;
@@ -174,16 +223,18 @@ VideoInformation Decoder::loadMP4(const char* src_filename)
 
 	/* open input file, and allocate format context */
 	if (avformat_open_input(&m_avformatContext, src_filename, NULL, NULL) < 0) {
-		fprintf(stderr, "Could not open source file %s\n", src_filename);
+		LOG_ERROR("Could not open source file " << src_filename);
 		//exit(1);
 		m_currentErrorCode = -5001;
 	}
+	m_videoPath = src_filename;
+	setInterruptCallback();
 	m_avformatContext->probesize = 5000000 * 20; //5000000 is the default size that doesn't seem to be enough for hight resolution hevc pictures
-	cout << "probsize: " << m_avformatContext->probesize << endl;
+	LOG_DEBUG("probesize: " << m_avformatContext->probesize);
 
 	/* retrieve stream information */
 	if (avformat_find_stream_info(m_avformatContext, NULL) < 0) {
-		fprintf(stderr, "Could not find stream information\n");
+		LOG_ERROR("Could not find stream information");
 		//exit(1);
 		m_currentErrorCode = -5002;
 	}
@@ -196,7 +247,7 @@ VideoInformation Decoder::loadMP4(const char* src_filename)
 	//AVPixelFormat
 	if (m_streamIndex == -1)
 	{
-		cout << "no video stream could be found in the file..." << endl;
+		LOG_ERROR("no video stream could be found in the file...");
 		//exit(1); // Didn't find a video stream
 		m_currentErrorCode = -5003;
 	}
@@ -205,9 +256,12 @@ VideoInformation Decoder::loadMP4(const char* src_filename)
 	assert(pCodecCtx != NULL);
 	VideoInformation videoInformation;
 	videoInformation.fps = (double)m_avformatContext->streams[m_streamIndex]->r_frame_rate.num / (double)m_avformatContext->streams[m_streamIndex]->r_frame_rate.den;
+	videoInformation.frameRateNum = m_avformatContext->streams[m_streamIndex]->r_frame_rate.num;
+	videoInformation.frameRateDen = m_avformatContext->streams[m_streamIndex]->r_frame_rate.den;
 	videoInformation.videoPath = string(src_filename);
-	double time_base = (double)m_avformatContext->streams[m_streamIndex]->time_base.num / (double)m_avformatContext->streams[m_streamIndex]->time_base.den;
-	videoInformation.durationMS = max(-1.0 ,(double)m_avformatContext->streams[m_streamIndex]->duration * time_base * 1000.0);
+	m_timeBase = m_avformatContext->streams[m_streamIndex]->time_base;
+	m_startPts = m_avformatContext->streams[m_streamIndex]->start_time != AV_NOPTS_VALUE ? m_avformatContext->streams[m_streamIndex]->start_time : 0;
+	videoInformation.durationMS = max(-1.0 ,(double)m_avformatContext->streams[m_streamIndex]->duration * av_q2d(m_timeBase) * 1000.0);
 	m_bVideoIsSeekable = videoInformation.durationMS > 0;
 	AVPacket pkt;
 	av_init_packet(&pkt);
@@ -217,7 +271,7 @@ VideoInformation Decoder::loadMP4(const char* src_filename)
 
 	if (m_currentErrorCode != 0)
 	{
-		cout << "An error occurred. Error code:" << m_currentErrorCode << endl;
+		LOG_ERROR("An error occurred. Error code:" << m_currentErrorCode);
 		return videoInformation;
 	}
 
@@ -254,7 +308,7 @@ VideoInformation Decoder::loadMP4(const char* src_filename)
 			m_bDescriptInitialized = true;
 			videoInformation.width = m_hDescript.sPicDesc.asPlanes[0].iWidth * 4; //mul with 4 because of BC4
 			videoInformation.height = m_hDescript.sPicDesc.asPlanes[0].iHeight * 4;
-			cout << "vieo width:" << videoInformation.width << " video height:" << videoInformation.height << " framerate: " << videoInformation.fps << " pixelformat:" << pCodecCtx->format << " duration in MS:" << videoInformation.durationMS << endl;
+			LOG_INFO("video width:" << videoInformation.width << " video height:" << videoInformation.height << " framerate: " << videoInformation.fps << " pixelformat:" << pCodecCtx->format << " duration in MS:" << videoInformation.durationMS);
 			xPrintVideoInfo(m_hDescript);
 		}
 		timeoutCounter++;
@@ -263,7 +317,7 @@ VideoInformation Decoder::loadMP4(const char* src_filename)
 	if (timeoutCounter == 500)
 	{
 		//break after max number of n (e.g. 500) trials, obviously the file cannot be read by SPIN-Decoder
-		cout << "The video stream is not supported by SPIN-Decoder, please check the format." << endl;
+		LOG_ERROR("The video stream is not supported by SPIN-Decoder, please check the format.");
 		return videoInformation;
 	}
 
@@ -271,25 +325,33 @@ VideoInformation Decoder::loadMP4(const char* src_filename)
 	if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar420)
 	{
 		videoInformation.chroma_subsampling = _420;
-		cout << "pixelformat: 420" << endl;
+		LOG_INFO("pixelformat: 420");
 	}
 	else if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar422) {
 		videoInformation.chroma_subsampling = _422;
-		cout << "pixelformat: 422" << endl;
+		LOG_INFO("pixelformat: 422");
 	}
 	else if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar444) {
 		videoInformation.chroma_subsampling = _444;
-		cout << "pixelformat: 444" << endl;
+		LOG_INFO("pixelformat: 444");
+	}
+	else if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar400) {
+		videoInformation.chroma_subsampling = _400;
+		LOG_INFO("pixelformat: 400");
+	}
+	else if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar4444) {
+		videoInformation.chroma_subsampling = _4444;
+		LOG_INFO("pixelformat: 4444");
 	}
 	else {
-		cout << "pixelformat: " << SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) << " is not supported." << endl;
+		LOG_ERROR("pixelformat: " << SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) << " is not supported.");
 	}
 
 	if (fileIsSeekable())
 	{
 		//SEEK to begin of the file: !Experimental!
 		av_seek_frame(m_avformatContext, m_streamIndex, 0, AVSEEK_FLAG_BACKWARD);
-		cout << "file is seekable" << endl;
+		LOG_INFO("file is seekable");
 	}
 	else 
 	{
@@ -297,16 +359,303 @@ VideoInformation Decoder::loadMP4(const char* src_filename)
 		avformat_close_input(&m_avformatContext);
 		m_avformatContext = NULL;
 		if (avformat_open_input(&m_avformatContext, src_filename, NULL, NULL) < 0) {
-			fprintf(stderr, "Could not open source file %s\n", src_filename);
+			LOG_ERROR("Could not open source file " << src_filename);
 			m_currentErrorCode = -5004;
 		}
-		cout << "file is not seekable" << endl;
+		setInterruptCallback();
+		LOG_INFO("file is not seekable");
 	}
 	videoInformation.isInitialized = true;
 	m_AV_EndOfFile = false;
 	return videoInformation;
 }
 
+/***********************************************************************************************/
+void Decoder::setInterruptCallback()
+{
+	if (m_avformatContext)
+	{
+		m_avformatContext->interrupt_callback.callback = interruptCallback;
+		m_avformatContext->interrupt_callback.opaque = this;
+	}
+}
+
+/***********************************************************************************************/
+bool Decoder::reopenInput()
+{
+	/*
+	Called by the decoder thread when the watchdog requested it, e.g. because av_read_frame hung on a network share.
+	The input is opened again and the decoding continues at the last read position.
+	*/
+	double decoderTime = getDecoderTime();
+	int64_t positionMs = decoderTime > 0 ? (int64_t)(decoderTime * 1000.0) : 0;
+	m_reopenRequested = false;
+	avformat_close_input(&m_avformatContext);
+	m_avformatContext = NULL;
+	if (avformat_open_input(&m_avformatContext, m_videoPath.c_str(), NULL, NULL) < 0) {
+		LOG_ERROR("Could not reopen source file " << m_videoPath);
+		m_currentErrorCode = -5004;
+		return false;
+	}
+	m_avformatContext->probesize = 5000000 * 20;
+	if (avformat_find_stream_info(m_avformatContext, NULL) < 0) {
+		LOG_ERROR("Could not find stream information after reopening " << m_videoPath);
+		m_currentErrorCode = -5002;
+		return false;
+	}
+	setInterruptCallback();
+	if (m_bVideoIsSeekable && positionMs > 0) {
+		m_seekToMSecond = positionMs;
+	}
+	LOG_INFO("reopened " << m_videoPath << " at " << positionMs << " ms");
+	return true;
+}
+
+/***********************************************************************************************/
+bool Decoder::reopenDecoder()
+{
+	/*
+	Called by the decoder thread when the discard mode or the scrub mode changed, which SpinDecLib only takes when it
+	is opened. The stream continues at the key frame before the last decoded picture, the pictures up to that one are
+	only decoded again for their references. After scrubbing it continues the same way with the exact frame of the last
+	scrub position.
+	*/
+	SE_FrameDiscardMode discardMode = (SE_FrameDiscardMode)m_requestedDiscardMode.load();
+	int scrubDownScale = m_requestedScrubDownScale;
+	bool wasScrubbing = m_scrubDownScale >= 0;
+	m_numReopens.add();
+	SpinDecLib_InvalidateInFlightPictures(m_hHEVCDecoder);
+	SpinDecLib_Close(&m_hHEVCDecoder);
+	m_sDecParam.eDiscardMode = scrubDownScale >= 0 ? SE_FDM_NonKey : discardMode;
+	m_sDecParam.iLog2DownScale = (std::max)(scrubDownScale, 0);
+	m_discardMode = discardMode;
+	m_scrubDownScale = scrubDownScale;
+	m_currentErrorCode = SpinDecLib_Open(&m_hHEVCDecoder, &m_sDecParam);
+	if (m_currentErrorCode != 0) {
+		LOG_ERROR("could not open the decoder again with the discard mode " << getDiscardModeName(m_sDecParam.eDiscardMode) << " and the downscale " << m_sDecParam.iLog2DownScale);
+		printErrorCode(m_currentErrorCode);
+		return false;
+	}
+	{
+		// the closed library does not return the pictures it still held
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (std::list<PictureContainer*>::iterator pic = m_lDecPicPool.begin(); pic != m_lDecPicPool.end(); pic++) {
+			if (std::find(frameQueue.begin(), frameQueue.end(), *pic) == frameQueue.end()) {
+				(*pic)->needoutput = false;
+			}
+		}
+	}
+	m_scrubCache.releaseAcquired();
+
+	if (scrubDownScale >= 0) {
+		if (!wasScrubbing) {
+			m_scrubPtsMS = -1;
+		}
+		// the planes of the output pictures at the scrub resolution, rounded up to whole BC4 blocks
+		Spin_Picture desc = getOutputPictureDesc();
+		for (int i = 0; i < 4; i++) {
+			desc.asPlanes[i].iWidth = (desc.asPlanes[i].iWidth + (1 << scrubDownScale) - 1) >> scrubDownScale;
+			desc.asPlanes[i].iHeight = (desc.asPlanes[i].iHeight + (1 << scrubDownScale) - 1) >> scrubDownScale;
+			desc.asPlanes[i].iMarginX = 0;
+			desc.asPlanes[i].iMarginY = 0;
+			desc.asPlanes[i].iStride = 0;
+		}
+		m_scrubCache.configure(desc);
+		LOG_INFO("scrubbing with key frames at 1/" << (1 << scrubDownScale) << " of the resolution");
+		return true;
+	}
+
+	double resumePtsMS = m_lastPtsMS;
+	double skipUntilPtsMS = m_lastPtsMS;
+	int64_t scrubToMSecond = m_scrubToMSecond.exchange(-1);
+	if (wasScrubbing && scrubToMSecond >= 0) {
+		m_scrubPtsMS = (double)scrubToMSecond; //requested after the last key frame was shown
+	}
+	if (wasScrubbing && m_scrubPtsMS >= 0) {
+		// the frame that is visible at the scrub position
+		double fps = getFrameRate();
+		resumePtsMS = m_scrubPtsMS;
+		skipUntilPtsMS = m_scrubPtsMS - (fps > 0 ? 1000.0 / fps : 0);
+		m_timelineStart = true;
+		m_seekPending = true;
+	}
+	if (resumePtsMS >= 0 && m_bVideoIsSeekable) {
+		if (av_seek_frame(m_avformatContext, m_streamIndex, msToPts(resumePtsMS), AVSEEK_FLAG_BACKWARD) >= 0) {
+			m_skipUntilPtsMS = skipUntilPtsMS;
+		}
+		else {
+			LOG_WARNING("could not seek back to " << resumePtsMS << " ms, the decoding continues with the next key frame");
+		}
+	}
+	LOG_INFO("reopened the decoder with the discard mode " << getDiscardModeName(discardMode) << " from " << resumePtsMS << " ms on, " << m_numReopens.get() << " reopens so far");
+	return true;
+}
+
+/***********************************************************************************************/
+bool Decoder::isDecoderConfigChanged() const
+{
+	return m_requestedDiscardMode != m_discardMode || m_requestedScrubDownScale != m_scrubDownScale;
+}
+
+/***********************************************************************************************/
+void Decoder::setScrubMode(bool scrubbing, int log2DownScale)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_requestedScrubDownScale = scrubbing ? (std::min)((std::max)(log2DownScale, 0), MAX_SCRUB_DOWNSCALE) : -1;
+	m_cv.notify_all();
+}
+
+/***********************************************************************************************/
+void Decoder::scrubToMSecond(int64_t scrubToMSecond)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_scrubToMSecond = scrubToMSecond; //only the latest position is shown, the ones in between are dropped
+	m_cv.notify_all();
+}
+
+/***********************************************************************************************/
+bool Decoder::scrub(int64_t scrubToMSecond)
+{
+	/*
+	Shows the key frame at or before the scrub position. A cached key frame is shown without seeking, any other one is
+	decoded alone, since the library discards everything but key frames in the scrub mode.
+	*/
+	TRACE_SCOPE("scrub");
+	AVStream* stream = m_avformatContext->streams[m_streamIndex];
+	int64_t targetPts = msToPts((double)scrubToMSecond);
+	int index = av_index_search_timestamp(stream, targetPts, AVSEEK_FLAG_BACKWARD);
+	int64_t key = index >= 0 ? stream->index_entries[index].timestamp : targetPts; //without an index every position is a key of its own
+	m_scrubPtsMS = (double)scrubToMSecond;
+	ScrubPicture* scrubPicture = m_scrubCache.find(key);
+	if (!scrubPicture) {
+		scrubPicture = decodeKeyFrame(key);
+	}
+	if (scrubPicture) {
+		queueScrubPicture(scrubPicture);
+	}
+	return m_currentErrorCode >= 0;
+}
+
+/***********************************************************************************************/
+ScrubPicture* Decoder::decodeKeyFrame(int64_t key)
+{
+	if (av_seek_frame(m_avformatContext, m_streamIndex, key, AVSEEK_FLAG_BACKWARD) < 0) {
+		LOG_WARNING("could not seek to the key frame at " << ptsToMS(key) << " ms");
+		return NULL;
+	}
+	SpinDecLib_InvalidateInFlightPictures(m_hHEVCDecoder);
+	m_scrubCache.releaseAcquired();
+
+	AVPacket pkt;
+	av_init_packet(&pkt);
+	pkt.data = NULL;
+	pkt.size = 0;
+	SpinDec_Picture* picIn = NULL;
+	SpinDec_Picture* picOut = NULL;
+	bool hasPicOut = false;
+	while (!hasPicOut && isActive) {
+		int avret;
+		{
+			HeartbeatScope heartbeat(m_heartbeats, WATCHDOG_STAGE_DEMUX);
+			avret = av_read_frame(m_avformatContext, &pkt);
+		}
+		if (avret < 0) {
+			break;
+		}
+		if (pkt.stream_index != m_streamIndex) {
+			av_packet_unref(&pkt);
+			continue;
+		}
+		if (picIn == NULL) {
+			picIn = m_scrubCache.acquire();
+		}
+		unsigned int consumedBytes = 0;
+		bool usedPicIn = false;
+		bool isKeyFrame = (pkt.flags & AV_PKT_FLAG_KEY) != 0;
+		m_bytesRead.add(pkt.size);
+		double start = SpinLib_GetRealTime();
+		{
+			int64_t pts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+			TRACE_SCOPE_ID("DecodeAU", pts);
+			HeartbeatScope heartbeat(m_heartbeats, WATCHDOG_STAGE_DECODE);
+			m_currentErrorCode = SpinDecLib_DecodeAU(m_hHEVCDecoder, pkt.data, pkt.size, pts, m_bMp4Markers, &consumedBytes, picIn, &usedPicIn, &picOut, &hasPicOut, NULL);
+		}
+		av_packet_unref(&pkt);
+		m_decodeTimeHistogram.record((SpinLib_GetRealTime() - start) * 1000.0);
+		if (m_currentErrorCode < 0) {
+			return NULL;
+		}
+		if (usedPicIn) {
+			picIn = NULL;
+		}
+		if (!hasPicOut && isKeyFrame) {
+			// the library would hold the key frame back until the next one for the reordering
+			SpinDecLib_FlushInFlightPictures(m_hHEVCDecoder);
+			hasPicOut = SpinDecLib_GetDecPicture(m_hHEVCDecoder, &picOut, true) != 0;
+		}
+	}
+	ScrubPicture* scrubPicture = hasPicOut ? m_scrubCache.insert(picOut, key) : NULL;
+	SpinDecLib_InvalidateInFlightPictures(m_hHEVCDecoder);
+	m_scrubCache.releaseAcquired();
+	if (!scrubPicture) {
+		return NULL;
+	}
+	m_numDecodedFrames.add();
+	scrubPicture->pts = picOut->sPic.llPts != AV_NOPTS_VALUE ? picOut->sPic.llPts : key;
+	scrubPicture->ptsMS = ptsToMS(scrubPicture->pts);
+	scrubPicture->frameNumber = (int)llround(scrubPicture->ptsMS * getFrameRate() / 1000.0);
+	return scrubPicture;
+}
+
+/***********************************************************************************************/
+void Decoder::queueScrubPicture(const ScrubPicture* scrubPicture)
+{
+	SpinDec_Picture* pic = getNewPictureBuffer();
+	if (!pic) {
+		return;
+	}
+	PictureContainer* picCon = m_mExtPic[pic->sPic.pPlanesData];
+	upscaleBC4Picture(&scrubPicture->pic.sPic, m_scrubDownScale, &pic->sPic);
+	pic->dDecodingTime = scrubPicture->pic.dDecodingTime;
+	pic->dFrameLatency = scrubPicture->pic.dFrameLatency;
+	pic->iQp = scrubPicture->pic.iQp;
+	pic->uiCodedPicSize = scrubPicture->pic.uiCodedPicSize;
+	picCon->pts = scrubPicture->pts;
+	picCon->ptsMS = scrubPicture->ptsMS;
+	picCon->frameNumber = scrubPicture->frameNumber;
+	picCon->discontinuity = true;
+	picCon->scrubbed = true;
+	picCon->decodingTime = 0;
+	picCon->decodingSteps = 0;
+	picCon->queuedTime = SpinLib_GetRealTime();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	frameQueue.push_back(picCon);
+	m_cv.notify_one();
+	PlayerEvents::post(m_eventOwner, PLAYER_EVENT_SEEK_COMPLETE, picCon->frameNumber);
+}
+
+/***********************************************************************************************/
+void Decoder::setDiscardMode(SE_FrameDiscardMode discardMode)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_requestedDiscardMode = discardMode;
+	m_cv.notify_all();
+}
+
+/***********************************************************************************************/
+const char* Decoder::getDiscardModeName(SE_FrameDiscardMode discardMode)
+{
+	switch (discardMode)
+	{
+	case SE_FDM_None: return "none";
+	case SE_FDM_NonRef: return "non reference";
+	case SE_FDM_Temporal: return "temporal";
+	case SE_FDM_NonIntra: return "non intra";
+	case SE_FDM_NonKey: return "non key";
+	default: return "unknown";
+	}
+}
+
 /***********************************************************************************************/
 bool  Decoder::fileIsSeekable() {
 	if (m_avformatContext->pb->seekable == 0) {
@@ -325,12 +674,84 @@ double Decoder::getDecoderTime()
 	
 	double dMediaTime = std::nan("0");
 	AVStream* pStream = m_avformatContext->streams[m_streamIndex];
-	if (pStream->cur_dts >= 0) {
-		dMediaTime = (double)pStream->cur_dts / pStream->time_base.den;
+	if (pStream->cur_dts != AV_NOPTS_VALUE && pStream->cur_dts >= 0) {
+		dMediaTime = ptsToMS(pStream->cur_dts) / 1000.0;
 	}
 	return dMediaTime;
 }
 
+/***********************************************************************************************/
+double Decoder::ptsToMS(int64_t pts) const
+{
+	return (double)(pts - m_startPts) * av_q2d(m_timeBase) * 1000.0;
+}
+
+/***********************************************************************************************/
+int64_t Decoder::msToPts(double ms) const
+{
+	return m_startPts + (int64_t)llround(ms / 1000.0 / av_q2d(m_timeBase));
+}
+
+/***********************************************************************************************/
+void Decoder::setPresentationTime(PictureContainer* pPicCon, const SpinDec_Picture* pic)
+{
+	/*
+	The decoder returns the pictures in presentation order with the pts that was passed to SpinDecLib_DecodeAU for
+	their access unit. Streams without timestamps continue the last pts with the nominal frame duration.
+	*/
+	double fps = getFrameRate();
+	pPicCon->pts = pic->sPic.llPts;
+	if (pPicCon->pts != AV_NOPTS_VALUE)
+	{
+		pPicCon->ptsMS = ptsToMS(pPicCon->pts);
+	}
+	else
+	{
+		pPicCon->ptsMS = m_lastPtsMS < 0 ? 0 : m_lastPtsMS + (fps > 0 ? 1000.0 / fps : 0);
+	}
+	m_lastPtsMS = pPicCon->ptsMS;
+	pPicCon->discontinuity = m_timelineStart;
+	pPicCon->scrubbed = false;
+	m_timelineStart = false;
+	pPicCon->frameNumber = (int)llround(pPicCon->ptsMS * fps / 1000.0);
+}
+
+/***********************************************************************************************/
+double Decoder::getFrameRate() const
+{
+	AVRational frameRate = m_avformatContext->streams[m_streamIndex]->r_frame_rate;
+	return frameRate.num > 0 && frameRate.den > 0 ? av_q2d(frameRate) : 0;
+}
+
+/***********************************************************************************************/
+int Decoder::getQueueSize() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return (int)frameQueue.size();
+}
+
+/***********************************************************************************************/
+void Decoder::getStats(PlayerStats& stats) const
+{
+	stats.numDecodedFrames = m_numDecodedFrames.get();
+	stats.bytesRead = m_bytesRead.get();
+	stats.numDecoderReopens = m_numReopens.get();
+	m_decodeTimeHistogram.getStats(stats.decodeTime);
+	m_queueTimeHistogram.getStats(stats.timeInQueue);
+	m_readTimeHistogram.getStats(stats.readTime);
+}
+
+/***********************************************************************************************/
+void Decoder::resetStats()
+{
+	m_numDecodedFrames.reset();
+	m_bytesRead.reset();
+	m_numReopens.reset();
+	m_decodeTimeHistogram.reset();
+	m_queueTimeHistogram.reset();
+	m_readTimeHistogram.reset();
+}
+
 /***********************************************************************************************/
 const PictureContainer* Decoder::getPic()
 {
@@ -339,9 +760,11 @@ const PictureContainer* Decoder::getPic()
 		std::lock_guard<std::mutex> lock(m_mutex);
 		PictureContainer* pc = frameQueue.front();//free previous used pic
 		pc->needoutput = false;
-		frameQueue.pop();
+		frameQueue.pop_front();
 		pc = frameQueue.front(); //return the front of the queue
 		m_iOutframes = pc->frameNumber;
+		m_outPtsMS = pc->ptsMS;
+		m_queueTimeHistogram.record((SpinLib_GetRealTime() - pc->queuedTime) * 1000.0);
 		m_cv.notify_one();
 		return pc;
 	}
@@ -352,19 +775,33 @@ const PictureContainer* Decoder::getPic()
 		PictureContainer* pc = frameQueue.front();
 		pc->needoutput = false;
 		m_iOutframes = pc->frameNumber;
-		frameQueue.pop();
+		m_outPtsMS = pc->ptsMS;
+		frameQueue.pop_front();
+		m_queueTimeHistogram.record((SpinLib_GetRealTime() - pc->queuedTime) * 1000.0);
 		m_cv.notify_one();
 		return pc;
 	}
 	return NULL;
 }
 
+/***********************************************************************************************/
+const PictureContainer* Decoder::peekPic(int ahead) const
+{
+	// the front of the queue is the picture returned by the last getPic(), it stays there until the next one is taken
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if ((int)frameQueue.size() > ahead + 1)
+	{
+		return frameQueue[ahead + 1];
+	}
+	return NULL;
+}
+
 /***********************************************************************************************/
 int Decoder::decode(AVPacket pkt)
 {
 	if (m_currentErrorCode != 0)
 	{
-		cout << "An error occurred... Error code:" << m_currentErrorCode << endl;
+		LOG_ERROR("An error occurred... Error code:" << m_currentErrorCode);
 		return m_currentErrorCode;
 	}
 
@@ -372,13 +809,16 @@ int Decoder::decode(AVPacket pkt)
 	SpinDec_Picture* picOut = NULL;
 	SpinDec_Picture* picIn = NULL;
 	bool _endOfFile = false;
-	double _fps = (double)m_avformatContext->streams[m_streamIndex]->r_frame_rate.num / (double)m_avformatContext->streams[m_streamIndex]->r_frame_rate.den;
 	while (isActive) //get slices of a single frame until it is complete and return
 	{
 		if (m_seekToMSecond >= 0) {
 			int avret;
-			int64_t targetDTS = max(0, m_seekToMSecond/1000.0) * m_avformatContext->streams[m_streamIndex]->time_base.den;
-			int64_t diffDTS = min(m_avformatContext->streams[m_streamIndex]->duration, targetDTS) - m_avformatContext->streams[m_streamIndex]->cur_dts;
+			AVStream* stream = m_avformatContext->streams[m_streamIndex];
+			int64_t targetDTS = msToPts(max(0, m_seekToMSecond));
+			if (stream->duration != AV_NOPTS_VALUE) {
+				targetDTS = min(m_startPts + stream->duration, targetDTS);
+			}
+			int64_t diffDTS = targetDTS - stream->cur_dts;
 			if (diffDTS < 0) {
 				avret = av_seek_frame(m_avformatContext, m_streamIndex, targetDTS, AVSEEK_FLAG_FRAME | AVSEEK_FLAG_BACKWARD);
 			}
@@ -388,19 +828,61 @@ int Decoder::decode(AVPacket pkt)
 			if (avret >= 0) {
 				SpinDecLib_InvalidateInFlightPictures(m_hHEVCDecoder);
 				m_seekToMSecond = -1;
+				m_seekPending = true;
+				m_timelineStart = true;
+				m_skipUntilPtsMS = -1;
 			}
 			else {
-				cout << "ERROR: could not seek. Please check if seeking is supported for the video format." << endl;
+				LOG_ERROR("could not seek. Please check if seeking is supported for the video format.");
+				m_seekToMSecond = -1; //drop the request, otherwise the loop below would retry it without ever blocking
 			}
 		}
 
-		if (frameQueue.size() >= m_bufferQueueMaxSize) {
+		{
+			// block (instead of spinning) until the sequencer consumed a picture, a seek was requested or the decoder got stopped
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this] { return !isActive || m_seekToMSecond >= 0 || isDecoderConfigChanged() || ((int)frameQueue.size() < m_bufferQueueMaxSize && (m_scrubDownScale < 0 || m_scrubToMSecond >= 0)); });
+		}
+		if (!isActive) {
+			break;
+		}
+		if (m_seekToMSecond >= 0) {
+			continue;
+		}
+		if (m_reopenRequested) {
+			if (!reopenInput()) {
+				break;
+			}
 			continue;
 		}
-		int avret = av_read_frame(m_avformatContext, &pkt);
+		if (isDecoderConfigChanged()) {
+			if (!reopenDecoder()) {
+				break;
+			}
+			picIn = NULL; //returned to the pool
+			continue;
+		}
+		if (m_scrubDownScale >= 0) {
+			int64_t scrubToMSecond = m_scrubToMSecond.exchange(-1);
+			if (scrubToMSecond >= 0 && !scrub(scrubToMSecond)) {
+				break;
+			}
+			continue;
+		}
+		int avret;
+		{
+			TRACE_SCOPE("read");
+			HeartbeatScope heartbeat(m_heartbeats, WATCHDOG_STAGE_DEMUX);
+			double readStart = SpinLib_GetRealTime();
+			avret = av_read_frame(m_avformatContext, &pkt);
+			m_readTimeHistogram.record((SpinLib_GetRealTime() - readStart) * 1000.0);
+		}
 		if (avret < 0) {
+			if (m_reopenRequested) {
+				continue; //interrupted, see reopenInput()
+			}
 			_endOfFile = avret == (int)AVERROR_EOF;
-			cout << "The end of file reached, check if loop is active\n";
+			LOG_DEBUG("The end of file reached, check if loop is active");
 			break;
 		}
 		if (pkt.stream_index != m_streamIndex) {
@@ -416,22 +898,27 @@ int Decoder::decode(AVPacket pkt)
 		if (picIn == NULL) {
 			picIn = getNewPictureBuffer();
 		}
-		double start;
-		if (m_writeLogs)
+		m_bytesRead.add(pkt.size);
+		double start = SpinLib_GetRealTime();
 		{
-			start = SpinLib_GetRealTime();
+			int64_t pts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts; //the decoder attaches it to the picture of this access unit
+			TRACE_SCOPE_ID("DecodeAU", pts);
+			HeartbeatScope heartbeat(m_heartbeats, WATCHDOG_STAGE_DECODE);
+			m_currentErrorCode = SpinDecLib_DecodeAU(m_hHEVCDecoder, pkt.data, pkt.size, pts, m_bMp4Markers, &consumedBytes, picIn, &usedPicIn, &picOut, &hasPicOut, NULL);
 		}
-		m_currentErrorCode = SpinDecLib_DecodeAU(m_hHEVCDecoder, pkt.data, pkt.size, pkt.pts, m_bMp4Markers, &consumedBytes, picIn, &usedPicIn, &picOut, &hasPicOut, NULL);
 		av_packet_unref(&pkt);
+		double decodeTime = SpinLib_GetRealTime() - start;
+		m_decodeTimeHistogram.record(decodeTime * 1000.0);
 		if (m_writeLogs)
 		{
-			m_decodingTime += (SpinLib_GetRealTime() - start);
+			m_decodingTime += decodeTime;
 			decodingSteps++;
 		}
 		if (m_currentErrorCode >= 0)
 		{
 			if (hasPicOut)
 			{
+				TRACE_SCOPE("output");
 				PictureContainer* picOutCon = m_mExtPic[picOut->sPic.pPlanesData];
 				if (m_writeLogs)
 				{
@@ -440,10 +927,26 @@ int Decoder::decode(AVPacket pkt)
 					m_decodingTime = 0;
 					decodingSteps = 0;
 				}
-				std::lock_guard<std::mutex> lock(m_mutex);
-				frameQueue.push(picOutCon);
-				m_cv.notify_one();
-				picOutCon->frameNumber = getDecoderTime() * _fps;	
+				m_numDecodedFrames.add();
+				setPresentationTime(picOutCon, picOut);
+				if (m_skipUntilPtsMS >= 0 && picOutCon->ptsMS <= m_skipUntilPtsMS)
+				{
+					picOutCon->needoutput = false; //was queued before the decoder got opened again
+					m_timelineStart = m_timelineStart || picOutCon->discontinuity; //passed on to the first queued picture
+				}
+				else
+				{
+					m_skipUntilPtsMS = -1;
+					picOutCon->queuedTime = SpinLib_GetRealTime();
+					std::lock_guard<std::mutex> lock(m_mutex);
+					frameQueue.push_back(picOutCon);
+					m_cv.notify_one();
+					if (m_seekPending)
+					{
+						m_seekPending = false;
+						PlayerEvents::post(m_eventOwner, PLAYER_EVENT_SEEK_COMPLETE, picOutCon->frameNumber);
+					}
+				}
 			}
 
 			if (usedPicIn) {
@@ -454,15 +957,24 @@ int Decoder::decode(AVPacket pkt)
 	// flush all pictures inside the decoder library
 	SpinDecLib_FlushInFlightPictures(m_hHEVCDecoder);
 	while (SpinDecLib_GetDecPicture(m_hHEVCDecoder, &picOut, true)) {
+		if (m_mExtPic.find(picOut->sPic.pPlanesData) == m_mExtPic.end()) {
+			continue; //a key frame that was decoded for scrubbing
+		}
 		PictureContainer* picOutCon = m_mExtPic[picOut->sPic.pPlanesData];
+		m_numDecodedFrames.add();
+		setPresentationTime(picOutCon, picOut);
+		picOutCon->queuedTime = SpinLib_GetRealTime();
 		std::lock_guard<std::mutex> lock(m_mutex);
-		frameQueue.push(picOutCon);
+		frameQueue.push_back(picOutCon);
 		m_cv.notify_one();
-		cout << "flushing rest pictures... " << endl;
+		LOG_DEBUG("flushing rest pictures... ");
 	}
 
 	if (m_shouldLoop && _endOfFile)
 	{
+		PlayerEvents::post(m_eventOwner, PLAYER_EVENT_LOOP);
+		m_lastPtsMS = -1;
+		m_timelineStart = true;
 		if (fileIsSeekable())
 		{
 			auto stream = m_avformatContext->streams[m_streamIndex];
@@ -474,9 +986,10 @@ int Decoder::decode(AVPacket pkt)
 			const char* src_filename = m_avformatContext->url;
 			m_avformatContext = NULL;
 			if (avformat_open_input(&m_avformatContext, src_filename, NULL, NULL) < 0) {
-				fprintf(stderr, "Could not open source file %s\n", src_filename);
+				LOG_ERROR("Could not open source file " << src_filename);
 				m_currentErrorCode = -5004;
 			}
+			setInterruptCallback();
 		}
 	}
 	else if (_endOfFile) {
@@ -492,31 +1005,128 @@ void Decoder::allocPictureBuffer(PictureContainer* pPicCon)
 	SpinDec_Picture* pic = new SpinDec_Picture;
 	memset(pic, 0, sizeof(SpinDec_Picture));
 
-	pic->sPic = m_hDescript.sPicDesc;
+	pic->sPic = getOutputPictureDesc();
+
+	if (!allocPackedFrame(&pic->sPic))
+	{
+		//problem with special pixel types?
+		pic->sPic.asPlanes[0].iAlign = 64;
+		if (SpinLib_AllocFrame(&pic->sPic)) {
+			LOG_ERROR("Failed to allocate frame buffer!");
+			throw exception();
+		}
+		if (m_numStridedPictures++ == 0)
+		{
+			LOG_WARNING("the pictures cannot be allocated without stride, every row has to be uploaded separately.");
+		}
+	}
+	m_outPicIsStrided = pictureIsStrided(&pic->sPic);
+	// store picture in picture container and flag as "needs output" 
+	pPicCon->pHEVCPic = pic;
+	pPicCon->needoutput = true;
+	pPicCon->externalMemory = false;
+	if (m_pictureMemory && !m_outPicIsStrided) //the rows of a strided picture are copied, which the external memory is not made for
+	{
+		moveToExternalMemory(pPicCon);
+	}
+	// store the picture container with the picture as a reference for easier access
+	m_mExtPic[pic->sPic.pPlanesData] = pPicCon;
+}
 
-	//problem with special pixel types?
-	pic->sPic.asPlanes[0].iAlign = 64;
+/***********************************************************************************************/
+Spin_Picture Decoder::getOutputPictureDesc() const
+{
+	Spin_Picture desc = m_hDescript.sPicDesc;
 
 	if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar420)
 	{
-		pic->sPic.ePixFormat = SE_PF_BC4_420;
+		desc.ePixFormat = SE_PF_BC4_420;
 	}
 	else if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar422) {
-		pic->sPic.ePixFormat = SE_PF_BC4_422;
+		desc.ePixFormat = SE_PF_BC4_422;
 	}
 	else if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar444) {
-		pic->sPic.ePixFormat = SE_PF_BC4_444;
+		desc.ePixFormat = SE_PF_BC4_444;
+	}
+	else if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar400) {
+		desc.ePixFormat = SE_PF_BC4_400;
 	}
+	else if (SD_CastToPlanar(m_hDescript.sPicDesc.ePixFormat) == SE_PF_Planar4444) {
+		desc.ePixFormat = SE_PF_BC4_4444;
+	}
+	return desc;
+}
 
-	if (SpinLib_AllocFrame(&pic->sPic)) {
-		fprintf(stderr, "Failed to allocate frame buffer! \n");
-		throw exception();
+/***********************************************************************************************/
+bool Decoder::allocPackedFrame(Spin_Picture* pic)
+{
+	/*
+	In ExtInt mode the BC4 output pictures are never used as reference, so they need no margins. Without margins and
+	with the stride equal to the width every plane is one contiguous block, that is uploaded with a single copy (or no
+	copy at all). If the rows do not fit the 64 byte alignment, the alignment is lowered to the size of a BC4 block.
+	*/
+	const int alignments[] = { 64, 8 };
+	Spin_Picture desc = *pic;
+	for (int a = 0; a < 2; a++)
+	{
+		*pic = desc;
+		for (int i = 0; i < 4; i++)
+		{
+			pic->asPlanes[i].iMarginX = 0;
+			pic->asPlanes[i].iMarginY = 0;
+			pic->asPlanes[i].iStride = 0; //let the library choose the smallest stride for the alignment
+			pic->asPlanes[i].iAlign = alignments[a];
+		}
+		if (SpinLib_AllocFrame(pic) == 0)
+		{
+			if (!pictureIsStrided(pic))
+				return true;
+			SpinLib_FreeFrame(pic);
+		}
 	}
-	// store the picture container with the picture as a reference for easier access
-	m_mExtPic[pic->sPic.pPlanesData] = pPicCon;
-	// store picture in picture container and flag as "needs output" 
-	pPicCon->pHEVCPic = pic;
-	pPicCon->needoutput = true;
+	*pic = desc;
+	return false;
+}
+
+/***********************************************************************************************/
+bool Decoder::moveToExternalMemory(PictureContainer* pPicCon)
+{
+	/*
+	The layout of the planes (stride, margins, alignment) is taken from the allocation of SpinLib_AllocFrame, only the
+	memory is replaced. If the external memory is not available (yet), the picture keeps its own memory and the
+	request is recorded, so that the owner of the external memory can create it.
+	*/
+	Spin_Picture* pic = &pPicCon->pHEVCPic->sPic;
+	unsigned char* data = m_pictureMemory->allocatePicture(pic->iAllocSize);
+	if (!data)
+	{
+		m_pictureMemory->reserve((unsigned int)m_lDecPicPool.size() + 1, pic->iAllocSize);
+		return false;
+	}
+
+	Spin_Picture layout = *pic;
+	unsigned char* oldData = (unsigned char*)pic->pPlanesData;
+	SpinLib_FreeFrame(pic);
+	*pic = layout;
+	pic->pPlanesData = data;
+	for (int i = 0; i < 4; i++)
+	{
+		if (layout.asPlanes[i].pPlane)
+		{
+			pic->asPlanes[i].pPlane = data + ((unsigned char*)layout.asPlanes[i].pPlane - oldData);
+		}
+	}
+	pPicCon->externalMemory = true;
+	return true;
+}
+
+/***********************************************************************************************/
+bool Decoder::isPictureInUse(PictureContainer* pPicCon)
+{
+	if (pPicCon->needoutput)
+		return true;
+	// the GPU might still read a picture from the external memory, after the sequencer released it
+	return pPicCon->externalMemory && m_pictureMemory->isPictureInUse(pPicCon->pHEVCPic->sPic.pPlanesData);
 }
 
 /***********************************************************************************************/
@@ -534,15 +1144,19 @@ SpinDec_Picture* Decoder::getNewPictureBuffer()
 
 	std::list<PictureContainer*>::iterator pic = m_lDecPicPool.begin();
 	for (; pic != m_lDecPicPool.end(); pic++) {
-		if (!(*pic)->needoutput) {
+		if (!isPictureInUse(*pic)) {
 			// unused picture found, reuse it
 			(*pic)->needoutput = true;
-			//TODO get if picture is strided.
+			if (m_pictureMemory && !(*pic)->externalMemory) {
+				// the external memory might have been created after this picture was allocated
+				void* oldData = (*pic)->pHEVCPic->sPic.pPlanesData;
+				if (moveToExternalMemory(*pic)) {
+					m_mExtPic.erase(oldData);
+					m_mExtPic[(*pic)->pHEVCPic->sPic.pPlanesData] = *pic;
+				}
+			}
 			SpinDec_Picture *spic = (*pic)->pHEVCPic;
-			const Spin_Plane *planeY = &spic->sPic.asPlanes[0];
-			const Spin_Plane *planeCb = &spic->sPic.asPlanes[1];
-			const Spin_Plane *planeCr = &spic->sPic.asPlanes[2];
-			m_outPicIsStrided = planeY->iWidth != planeY->iStride || planeCb->iWidth != planeCb->iStride || planeCr->iWidth != planeCr->iStride;
+			m_outPicIsStrided = pictureIsStrided(&spic->sPic);
 			return spic;
 		}
 	}
@@ -571,9 +1185,9 @@ void  Decoder::xPrintPicInfo(const SpinDec_Picture* picOut) {
 
 /***********************************************************************************************/
 void  Decoder::xPrintVideoInfo(const SpinDec_Descript & decDescript) {
-	stringstream ss;
-	ss << "*** Decoding information ***";
-	ss << "* Video resolution : " << decDescript.sPicDesc.asPlanes[0].iWidth << "x" << decDescript.sPicDesc.asPlanes[0].iHeight;
+	// one message per line, the whole description would exceed LOG_MESSAGE_LENGTH
+	LOG_INFO("*** Decoding information ***");
+	LOG_INFO("* Video resolution : " << decDescript.sPicDesc.asPlanes[0].iWidth << "x" << decDescript.sPicDesc.asPlanes[0].iHeight);
 	const char* cspaces[SE_NUM_ColorSpaces] = { "bt601", "bt709", "bt2020" };
 	const char* transfer[SE_NUM_TransferFuncs] = {
 		"sdr",
@@ -583,8 +1197,8 @@ void  Decoder::xPrintVideoInfo(const SpinDec_Descript & decDescript) {
 	string cm;
 	const char* cmstr[2] = { "rgba", "yuva" };
 	const char* cm_cstr = cm.c_str();
-	ss << "* Chroma format    : " << cm_cstr << " " << strChromaFmt[SD_CastToPlanar(decDescript.sPicDesc.ePixFormat)];
-	ss << "* Color space      : " << cspaces[decDescript.sPicDesc.eColorSpace] << (decDescript.sPicDesc.eColorRange == SE_CR_Limited ? 'l' : 'f') << " " << transfer[decDescript.sPicDesc.eTransferFunc];
+	LOG_INFO("* Chroma format    : " << cm_cstr << " " << strChromaFmt[SD_CastToPlanar(decDescript.sPicDesc.ePixFormat)]);
+	LOG_INFO("* Color space      : " << cspaces[decDescript.sPicDesc.eColorSpace] << (decDescript.sPicDesc.eColorRange == SE_CR_Limited ? 'l' : 'f') << " " << transfer[decDescript.sPicDesc.eTransferFunc]);
 
 	string pixmeth;
 	switch (SD_GetPixFmtCat(decDescript.sPicDesc.ePixFormat)) {
@@ -608,10 +1222,9 @@ void  Decoder::xPrintVideoInfo(const SpinDec_Descript & decDescript) {
 		break;
 	}
 
-	ss << "* Format type      : " << pixmeth.c_str();
-	ss << "* Luma bitdepth    : " << decDescript.sPicDesc.aiBitdepth[0];
-	ss << "* Chroma bitdepth  : " << decDescript.sPicDesc.aiBitdepth[1];
-	cout << ss.str() << endl;
+	LOG_INFO("* Format type      : " << pixmeth.c_str());
+	LOG_INFO("* Luma bitdepth    : " << decDescript.sPicDesc.aiBitdepth[0]);
+	LOG_INFO("* Chroma bitdepth  : " << decDescript.sPicDesc.aiBitdepth[1]);
 }
 
 
@@ -647,7 +1260,9 @@ bool Decoder::getPicIsStrided() {
 
 /***********************************************************************************************/
 void Decoder::seekToMSecond(int64_t seekToMSecond) {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_seekToMSecond = seekToMSecond; 
+	m_cv.notify_all();
 }
 
 /***********************************************************************************************/
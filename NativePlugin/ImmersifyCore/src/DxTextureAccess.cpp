@@ -31,8 +31,14 @@ void DxTextureAccess::setDxDevice(ID3D11Device* device)
 	// Get the ID3D11DeviceContext
 	m_device->GetImmediateContext(&m_ctx);
 	m_d3dtexY->GetDevice(&m_device);
-	m_d3dtexU->GetDevice(&m_device);
-	m_d3dtexV->GetDevice(&m_device);
+	if (m_d3dtexU)
+	{
+		m_d3dtexU->GetDevice(&m_device); //there are no chroma textures for 4:0:0 videos
+	}
+	if (m_d3dtexV)
+	{
+		m_d3dtexV->GetDevice(&m_device);
+	}
 }
 
 bool DxTextureAccess::applyPictureData(const Spin_Picture * pic)
@@ -41,34 +47,24 @@ bool DxTextureAccess::applyPictureData(const Spin_Picture * pic)
 	if (m_d3dtexY)
 	{
 		const Spin_Plane *planeY = &pic->asPlanes[0];
-		unsigned int width = planeY->iWidth * 8;
+		unsigned int rowPitch = planeY->iStride * 8; //one row of BC4 blocks, including the stride of strided pictures
 		// Use ID3D11DeviceContext::UpdateSubresource to fill the default texture with data from a pointer provided by the application.
-		m_ctx->UpdateSubresource(m_d3dtexY, 0, nullptr, planeY->pPlane, width, 1); // planeY->iWidth * 8;
+		m_ctx->UpdateSubresource(m_d3dtexY, 0, nullptr, planeY->pPlane, rowPitch, 1);
 	}
 
 	if (m_d3dtexU)
 	{
 		const Spin_Plane *planeCb = &pic->asPlanes[1];
-		unsigned int width = planeCb->iWidth * 8;
-		//if (m_chroma_subsampling == CHROMA_SUBSAMPLING::_420)
-		//{
-		//	width /= 2;
-		//}
-
-		m_ctx->UpdateSubresource(m_d3dtexU, 0, nullptr, planeCb->pPlane, width, 1); // planeCb->iWidth * 8
+		unsigned int rowPitch = planeCb->iStride * 8;
+		m_ctx->UpdateSubresource(m_d3dtexU, 0, nullptr, planeCb->pPlane, rowPitch, 1);
 	}
 
 	if (m_d3dtexV)
 	{
 		const Spin_Plane *planeCr = &pic->asPlanes[2];
 
-		unsigned int width = planeCr->iWidth * 8;
-		//if (m_chroma_subsampling == CHROMA_SUBSAMPLING::_420)
-		//{
-		//	width /= 2;
-		//}
-
-		m_ctx->UpdateSubresource(m_d3dtexV, 0, nullptr, planeCr->pPlane, width, 1); // planeCr->iWidth * 8
+		unsigned int rowPitch = planeCr->iStride * 8;
+		m_ctx->UpdateSubresource(m_d3dtexV, 0, nullptr, planeCr->pPlane, rowPitch, 1);
 	}
 
 	if (m_ready == false)
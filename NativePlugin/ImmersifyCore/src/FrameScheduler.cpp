@@ -0,0 +1,221 @@
+#include "FrameScheduler.h"
+#include "Logger.h"
+#include <cmath>
+
+/***********************************************************************************************/
+FrameScheduler::FrameScheduler()
+{
+	m_rate = 1.0;
+	m_lastUpdateTime = -1;
+	m_renderIntervalMs = DEFAULT_RENDER_INTERVAL_MS;
+	m_presentTime = 0;
+	m_lastDriftMs = 0;
+	m_cadenceBroken = false;
+	reset();
+}
+
+/***********************************************************************************************/
+void FrameScheduler::reset()
+{
+	m_hasEpoch = false;
+	m_epochTime = 0;
+	m_epochPtsMS = 0;
+	m_hasLastFrame = false;
+	m_lastPtsMS = 0;
+	m_lastPresentTime = 0;
+}
+
+/***********************************************************************************************/
+void FrameScheduler::setRate(double rate, double nowMs)
+{
+	if (rate == m_rate)
+		return;
+	if (hasTimeline() && rate > 0)
+	{
+		// continue the timeline from the current media time, so that the clock does not jump
+		m_epochPtsMS = getMediaTime(nowMs);
+		m_epochTime = nowMs;
+	}
+	else
+	{
+		m_hasEpoch = false;
+	}
+	m_rate = rate;
+}
+
+/***********************************************************************************************/
+void FrameScheduler::setCadence(const Cadence& cadence)
+{
+	m_cadence = cadence;
+	m_hasEpoch = false; //the next frame starts the pattern
+}
+
+/***********************************************************************************************/
+void FrameScheduler::beginUpdate(double nowMs)
+{
+	/*
+	A texture updated now is shown with the next vsync. The update calls jitter within the render frame, so the vsync
+	is predicted from the previous one and only pulled slowly towards the measured time. Otherwise a frame whose target
+	time is close to the middle between two vsyncs would alternately be shown early and late.
+	*/
+	double measured = nowMs + m_renderIntervalMs;
+	if (m_lastUpdateTime >= 0)
+	{
+		double interval = nowMs - m_lastUpdateTime;
+		if (usesCadence())
+		{
+			m_renderIntervalMs = m_cadence.getVsyncInterval(); //known exactly
+		}
+		else if (interval > 0 && interval < MAX_RENDER_INTERVAL_MS)
+		{
+			m_renderIntervalMs += (interval - m_renderIntervalMs) / 16.0;
+		}
+		double predicted = m_presentTime + m_renderIntervalMs;
+		m_presentTime = std::fabs(measured - predicted) < m_renderIntervalMs / 2 ? predicted + (measured - predicted) / 16.0 : measured;
+	}
+	else
+	{
+		m_presentTime = measured;
+	}
+	m_lastUpdateTime = nowMs;
+}
+
+/***********************************************************************************************/
+double FrameScheduler::getTargetTime(double ptsMS) const
+{
+	if (usesCadence())
+	{
+		// the first vsync of the frame in the pattern that started with the epoch frame, without rounding errors
+		int64_t frame = m_cadence.getFrame(ptsMS - m_epochPtsMS);
+		return m_epochTime + m_cadence.getVsync(frame) * m_cadence.getVsyncInterval();
+	}
+	return m_epochTime + (ptsMS - m_epochPtsMS) / m_rate;
+}
+
+/***********************************************************************************************/
+double FrameScheduler::getMediaTime(double nowMs) const
+{
+	return m_epochPtsMS + (nowMs - m_epochTime) * m_rate;
+}
+
+/***********************************************************************************************/
+bool FrameScheduler::isDue(double ptsMS) const
+{
+	if (!hasTimeline())
+		return true;
+	return getTargetTime(ptsMS) <= m_presentTime + m_renderIntervalMs / 2;
+}
+
+/***********************************************************************************************/
+double FrameScheduler::getTimeUntilDue(double ptsMS, double nowMs) const
+{
+	if (!hasTimeline())
+		return 0;
+	// due in the update whose vsync is closest to the target time
+	return getTargetTime(ptsMS) - m_renderIntervalMs * 1.5 - nowMs;
+}
+
+/***********************************************************************************************/
+void FrameScheduler::startTimeline(double ptsMS)
+{
+	m_hasEpoch = true;
+	m_epochTime = m_presentTime;
+	m_epochPtsMS = ptsMS;
+	m_hasLastFrame = false;
+}
+
+/***********************************************************************************************/
+SCHEDULE_DECISION FrameScheduler::decide(const PictureContainer* next, const PictureContainer* following)
+{
+	if (!next)
+		return SCHEDULE_WAIT;
+	if (m_rate <= 0)
+		return SCHEDULE_PRESENT;
+	if (!m_hasEpoch || next->discontinuity)
+	{
+		startTimeline(next->ptsMS);
+		return SCHEDULE_PRESENT;
+	}
+	double target = getTargetTime(next->ptsMS);
+	if (std::fabs(target - m_presentTime) > MAX_SCHEDULE_OFFSET_MS)
+	{
+		// e.g. the decoder fell behind by more than the queue, catching up would skip everything that is decoded
+		LOG_WARNING("frame at " << next->ptsMS << " ms is " << (int)(m_presentTime - target) << " ms off its target time, the timeline is restarted");
+		m_resyncCounter.add();
+		startTimeline(next->ptsMS);
+		return SCHEDULE_PRESENT;
+	}
+	if (!isDue(next->ptsMS))
+		return SCHEDULE_WAIT;
+	if (following && !following->discontinuity && isDue(following->ptsMS))
+	{
+		if (usesCadence() && m_cadence.getNumVsyncs(m_cadence.getFrame(next->ptsMS - m_epochPtsMS)) > 0)
+		{
+			addCadenceBreak(); //e.g. 120 fps at 60 Hz skips every other frame by design
+		}
+		m_skippedCounter.add();
+		return SCHEDULE_SKIP;
+	}
+	return SCHEDULE_PRESENT;
+}
+
+/***********************************************************************************************/
+double FrameScheduler::framePresented(double ptsMS)
+{
+	if (!hasTimeline())
+	{
+		m_lastDriftMs = 0;
+		return 0;
+	}
+	double presentTime = m_presentTime;
+	m_lastDriftMs = presentTime - getTargetTime(ptsMS);
+	m_driftHistogram.record(std::fabs(m_lastDriftMs));
+	if (usesCadence() && std::fabs(m_lastDriftMs) >= m_cadence.getVsyncInterval() / 2)
+	{
+		addCadenceBreak(); //shown at another vsync than the pattern asks for
+	}
+	if (m_hasLastFrame && ptsMS > m_lastPtsMS)
+	{
+		double expectedInterval = (ptsMS - m_lastPtsMS) / m_rate;
+		m_judderHistogram.record(std::fabs((presentTime - m_lastPresentTime) - expectedInterval));
+	}
+	m_hasLastFrame = true;
+	m_lastPtsMS = ptsMS;
+	m_lastPresentTime = presentTime;
+	return m_lastDriftMs;
+}
+
+/***********************************************************************************************/
+void FrameScheduler::addCadenceBreak()
+{
+	m_cadenceBreakCounter.add();
+	m_cadenceBroken = true;
+}
+
+/***********************************************************************************************/
+bool FrameScheduler::takeCadenceBreak()
+{
+	bool broken = m_cadenceBroken;
+	m_cadenceBroken = false;
+	return broken;
+}
+
+/***********************************************************************************************/
+void FrameScheduler::getStats(PlayerStats& stats) const
+{
+	stats.numSkippedFrames = m_skippedCounter.get();
+	stats.numResyncs = m_resyncCounter.get();
+	stats.numCadenceBreaks = m_cadenceBreakCounter.get();
+	m_driftHistogram.getStats(stats.drift);
+	m_judderHistogram.getStats(stats.judder);
+}
+
+/***********************************************************************************************/
+void FrameScheduler::resetStats()
+{
+	m_skippedCounter.reset();
+	m_resyncCounter.reset();
+	m_cadenceBreakCounter.reset();
+	m_driftHistogram.reset();
+	m_judderHistogram.reset();
+}
@@ -0,0 +1,181 @@
+#include "FrameTelemetry.h"
+#include <string.h>
+#include <algorithm>
+
+const DWORD TELEMETRY_WRITE_INTERVAL_MS = 100;
+const size_t TELEMETRY_WRITE_BATCH = 256;
+
+/***********************************************************************************************/
+FrameTelemetry::FrameTelemetry()
+{
+	m_file = NULL;
+	m_thread = NULL;
+	m_run = false;
+	m_numLostRecords = 0;
+}
+
+/***********************************************************************************************/
+FrameTelemetry::~FrameTelemetry()
+{
+	if (m_thread)
+	{
+		m_run = false;
+		WaitForSingleObject(m_thread, INFINITE);
+		CloseHandle(m_thread);
+	}
+	if (m_file)
+	{
+		fclose(m_file);
+	}
+}
+
+/***********************************************************************************************/
+bool FrameTelemetry::open(const std::string& path)
+{
+	m_file = fopen(path.c_str(), "wb");
+	if (!m_file)
+		return false;
+
+	FrameTelemetryFileHeader header;
+	memcpy(header.magic, "IFTR", 4);
+	header.version = FRAME_TELEMETRY_VERSION;
+	header.recordSize = sizeof(FrameRecord);
+	header.reserved = 0;
+	fwrite(&header, sizeof(header), 1, m_file);
+
+	m_run = true;
+	m_thread = CreateThread(NULL, 0, run, (void*)this, 0, NULL);
+	return true;
+}
+
+/***********************************************************************************************/
+void FrameTelemetry::record(const FrameRecord& frameRecord)
+{
+	if (!m_queue.push(frameRecord))
+	{
+		m_numLostRecords++;
+	}
+}
+
+/***********************************************************************************************/
+DWORD WINAPI FrameTelemetry::run(void* param)
+{
+	FrameTelemetry* This = (FrameTelemetry*)param;
+	while (This->m_run)
+	{
+		This->drain();
+		Sleep(TELEMETRY_WRITE_INTERVAL_MS);
+	}
+	This->drain();
+	return 0;
+}
+
+/***********************************************************************************************/
+void FrameTelemetry::drain()
+{
+	FrameRecord batch[TELEMETRY_WRITE_BATCH];
+	size_t numRecords = 0;
+	bool written = false;
+	while (m_queue.pop(batch[numRecords]))
+	{
+		if (++numRecords == TELEMETRY_WRITE_BATCH)
+		{
+			fwrite(batch, sizeof(FrameRecord), numRecords, m_file);
+			numRecords = 0;
+			written = true;
+		}
+	}
+	if (numRecords > 0)
+	{
+		fwrite(batch, sizeof(FrameRecord), numRecords, m_file);
+		written = true;
+	}
+	if (written)
+	{
+		fflush(m_file);
+	}
+}
+
+/***********************************************************************************************/
+bool FrameTelemetry::exportRecords(const char* binaryPath, const char* outputPath, TELEMETRY_FORMAT format)
+{
+	FILE* in = fopen(binaryPath, "rb");
+	if (!in)
+		return false;
+	FrameTelemetryFileHeader header;
+	if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, "IFTR", 4) != 0 || header.version != FRAME_TELEMETRY_VERSION || header.recordSize != sizeof(FrameRecord))
+	{
+		fclose(in);
+		return false;
+	}
+	FILE* out = fopen(outputPath, "w");
+	if (!out)
+	{
+		fclose(in);
+		return false;
+	}
+
+	const char* fields = "frameNumber,presentTimeMS,frameIntervalMS,decodeMS,decodingTimeMS,frameLatencyMS,uploadMS,queueSize,decodingSteps,qp,codedSize,uploadFailed,gpuUploadMS,ptsMS";
+	if (format == TELEMETRY_FORMAT_CSV)
+	{
+		fprintf(out, "%s\n", fields);
+	}
+	else
+	{
+		fprintf(out, "[\n");
+	}
+
+	FrameRecord r;
+	bool first = true;
+	while (fread(&r, sizeof(FrameRecord), 1, in) == 1)
+	{
+		writeRecord(out, r, format, first);
+		first = false;
+	}
+	if (format == TELEMETRY_FORMAT_JSON)
+	{
+		fprintf(out, "\n]\n");
+	}
+	fclose(out);
+	fclose(in);
+	return true;
+}
+
+/***********************************************************************************************/
+void FrameTelemetry::writeRecord(FILE* out, const FrameRecord& r, TELEMETRY_FORMAT format, bool first)
+{
+	if (format == TELEMETRY_FORMAT_CSV)
+	{
+		fprintf(out, "%lld,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%d,%d,%u,%d,%.3f,%.3f\n", (long long)r.frameNumber, r.presentTimeMS, r.frameIntervalMS, r.decodeMS, r.decodingTimeMS, r.frameLatencyMS, r.uploadMS, r.queueSize, r.decodingSteps, r.qp, r.codedSize, r.uploadFailed, r.gpuUploadMS, r.ptsMS);
+	}
+	else
+	{
+		fprintf(out, "%s  {\"frameNumber\": %lld, \"presentTimeMS\": %.3f, \"frameIntervalMS\": %.3f, \"decodeMS\": %.3f, \"decodingTimeMS\": %.3f, \"frameLatencyMS\": %.3f, \"uploadMS\": %.3f, \"queueSize\": %d, \"decodingSteps\": %d, \"qp\": %d, \"codedSize\": %u, \"uploadFailed\": %d, \"gpuUploadMS\": %.3f, \"ptsMS\": %.3f}",
+			first ? "" : ",\n", (long long)r.frameNumber, r.presentTimeMS, r.frameIntervalMS, r.decodeMS, r.decodingTimeMS, r.frameLatencyMS, r.uploadMS, r.queueSize, r.decodingSteps, r.qp, r.codedSize, r.uploadFailed, r.gpuUploadMS, r.ptsMS);
+	}
+}
+
+/***********************************************************************************************/
+void FrameHistory::record(const FrameRecord& frameRecord)
+{
+	int64_t index = m_numRecords.load(std::memory_order_relaxed);
+	m_records[index % FRAME_HISTORY_SIZE].write(frameRecord);
+	m_numRecords.store(index + 1, std::memory_order_release);
+}
+
+/***********************************************************************************************/
+void FrameHistory::getRecords(double durationMs, std::vector<FrameRecord>& records) const
+{
+	records.clear();
+	int64_t numRecords = m_numRecords.load(std::memory_order_acquire);
+	int64_t first = numRecords > FRAME_HISTORY_SIZE - 1 ? numRecords - (FRAME_HISTORY_SIZE - 1) : 0; //the oldest one might be overwritten right now
+	for (int64_t i = numRecords - 1; i >= first; i--)
+	{
+		FrameRecord frameRecord;
+		m_records[i % FRAME_HISTORY_SIZE].read(frameRecord);
+		if (!records.empty() && frameRecord.presentTimeMS < records.front().presentTimeMS - durationMs)
+			break;
+		records.push_back(frameRecord);
+	}
+	std::reverse(records.begin(), records.end());
+}
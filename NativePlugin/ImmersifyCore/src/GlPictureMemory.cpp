@@ -0,0 +1,211 @@
+#include "GlPictureMemory.h"
+#include <Console.h>
+#include <Utils.h>
+#include <algorithm>
+#include "Logger.h"
+
+const size_t PICTURE_SLOT_ALIGNMENT = 256;
+const unsigned int NUMBER_GPU_PICTURES = 2; //pictures that are still read by the GPU while the decoder fills the queue
+
+/***********************************************************************************************/
+GlPictureMemory::GlPictureMemory()
+{
+	m_buffer = 0;
+	m_base = nullptr;
+	m_slotSize = 0;
+	m_numSlots = 0;
+	m_requestedSlots = 0;
+	m_requestedSlotSize = 0;
+	m_createFailed = false;
+}
+
+/***********************************************************************************************/
+GlPictureMemory::~GlPictureMemory()
+{
+	release();
+}
+
+/***********************************************************************************************/
+void GlPictureMemory::reserve(unsigned int numPictures, size_t pictureSize)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_buffer || m_createFailed)
+		return; //the buffer cannot grow, further pictures fall back to the decoders own memory
+	m_requestedSlots = (std::max)(m_requestedSlots, numPictures);
+	m_requestedSlotSize = (std::max)(m_requestedSlotSize, pictureSize);
+}
+
+/***********************************************************************************************/
+unsigned char* GlPictureMemory::allocatePicture(size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_base || size > m_slotSize)
+		return nullptr;
+	for (unsigned int i = 0; i < m_numSlots; i++)
+	{
+		if (!m_allocated[i])
+		{
+			m_allocated[i] = true;
+			return m_base + i * m_slotSize;
+		}
+	}
+	return nullptr;
+}
+
+/***********************************************************************************************/
+void GlPictureMemory::releasePicture(const void* pictureData)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int slot = getSlot(pictureData);
+	if (slot >= 0)
+	{
+		m_allocated[slot] = false;
+	}
+}
+
+/***********************************************************************************************/
+bool GlPictureMemory::isPictureInUse(const void* pictureData)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int slot = getSlot(pictureData);
+	return slot >= 0 && m_inUse[slot];
+}
+
+/***********************************************************************************************/
+int GlPictureMemory::getSlot(const void* pictureData) const
+{
+	const GLubyte* data = (const GLubyte*)pictureData;
+	if (!m_base || data < m_base || data >= m_base + m_numSlots * m_slotSize)
+		return -1;
+	return (int)((data - m_base) / m_slotSize);
+}
+
+/***********************************************************************************************/
+bool GlPictureMemory::contains(const void* pictureData)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return getSlot(pictureData) >= 0;
+}
+
+/***********************************************************************************************/
+void GlPictureMemory::update()
+{
+	unsigned int requestedSlots;
+	size_t requestedSlotSize;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		requestedSlots = m_buffer ? 0 : m_requestedSlots;
+		requestedSlotSize = m_requestedSlotSize;
+	}
+	if (requestedSlots > 0)
+	{
+		//creating a big buffer takes a while, the decoder must not be blocked meanwhile
+		create(requestedSlots + NUMBER_GPU_PICTURES, requestedSlotSize);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (unsigned int i = 0; i < m_numSlots; i++)
+	{
+		if (!m_fences[i])
+			continue;
+		GLenum result = glClientWaitSync(m_fences[i], 0, 0);
+		if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+		{
+			glDeleteSync(m_fences[i]);
+			m_fences[i] = 0;
+			m_inUse[i] = false;
+		}
+	}
+}
+
+/***********************************************************************************************/
+bool GlPictureMemory::create(unsigned int numSlots, size_t slotSize)
+{
+	/*
+	In SE_PBM_ExtInt mode the decoder keeps its reference pictures internally and only writes the BC4 output into the
+	external pictures, it never reads them back. The texture access only uploads them with the GPU, pictures that would
+	have to be copied by the upload workers (strided ones or those of a packed texture) are not placed in here. So
+	write-only (possibly write-combined) memory is fine here.
+	*/
+	slotSize = (slotSize + PICTURE_SLOT_ALIGNMENT - 1) / PICTURE_SLOT_ALIGNMENT * PICTURE_SLOT_ALIGNMENT;
+	GLsizeiptr size = (GLsizeiptr)slotSize * numSlots;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, 0, flags);
+	GLubyte* base = (GLubyte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_requestedSlots = 0;
+	if (!base)
+	{
+		LOG_WARNING("could not map " << size / (1024 * 1024) << " MB for zero copy pictures, the pictures will be copied.");
+		glDeleteBuffers(1, &buffer);
+		m_createFailed = true;
+		return false;
+	}
+	m_buffer = buffer;
+	m_base = base;
+	m_slotSize = slotSize;
+	m_numSlots = numSlots;
+	m_allocated.assign(numSlots, false);
+	m_inUse.assign(numSlots, false);
+	m_fences.assign(numSlots, 0);
+	return true;
+}
+
+/***********************************************************************************************/
+void GlPictureMemory::disable()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_buffer)
+	{
+		m_createFailed = true;
+		m_requestedSlots = 0;
+	}
+}
+
+/***********************************************************************************************/
+void GlPictureMemory::markInUse(const void* pictureData)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	int slot = getSlot(pictureData);
+	if (slot < 0)
+		return;
+	if (m_fences[slot])
+	{
+		glDeleteSync(m_fences[slot]);
+	}
+	m_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_inUse[slot] = true;
+}
+
+/***********************************************************************************************/
+void GlPictureMemory::release()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (size_t i = 0; i < m_fences.size(); i++)
+	{
+		if (m_fences[i])
+		{
+			glDeleteSync(m_fences[i]);
+		}
+	}
+	if (m_buffer)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &m_buffer);
+	}
+	m_buffer = 0;
+	m_base = nullptr;
+	m_slotSize = 0;
+	m_numSlots = 0;
+	m_allocated.clear();
+	m_inUse.clear();
+	m_fences.clear();
+}
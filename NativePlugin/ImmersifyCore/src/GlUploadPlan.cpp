@@ -0,0 +1,164 @@
+#include "GlUploadPlan.h"
+#include <string.h>
+
+/***********************************************************************************************/
+template<CHROMA_SUBSAMPLING Chroma>
+static GlUploadPlan* createPlan(bool strided, bool packed, unsigned int width, unsigned int height, const UploadWorkerPool* pool)
+{
+	if (packed)
+	{
+		if (strided) return new GlUploadPlanT<Chroma, true, true>(width, height, pool);
+		return new GlUploadPlanT<Chroma, false, true>(width, height, pool);
+	}
+	if (strided) return new GlUploadPlanT<Chroma, true, false>(width, height, pool);
+	return new GlUploadPlanT<Chroma, false, false>(width, height, pool);
+}
+
+/***********************************************************************************************/
+GlUploadPlan* GlUploadPlan::create(CHROMA_SUBSAMPLING chroma, bool strided, bool packed, unsigned int width, unsigned int height, const UploadWorkerPool* pool)
+{
+	switch (chroma)
+	{
+	case _400: return createPlan<_400>(strided, packed, width, height, pool);
+	case _422: return createPlan<_422>(strided, packed, width, height, pool);
+	case _444: return createPlan<_444>(strided, packed, width, height, pool);
+	case _4444: return createPlan<_4444>(strided, packed, width, height, pool);
+	default: return createPlan<_420>(strided, packed, width, height, pool);
+	}
+}
+
+/***********************************************************************************************/
+static void getChromaLayout(CHROMA_SUBSAMPLING chroma, int& numPlanes, unsigned int& divX, unsigned int& divY)
+{
+	switch (chroma)
+	{
+	case _400: numPlanes = ChromaLayout<_400>::NumPlanes; divX = ChromaLayout<_400>::DivX; divY = ChromaLayout<_400>::DivY; break;
+	case _422: numPlanes = ChromaLayout<_422>::NumPlanes; divX = ChromaLayout<_422>::DivX; divY = ChromaLayout<_422>::DivY; break;
+	case _444: numPlanes = ChromaLayout<_444>::NumPlanes; divX = ChromaLayout<_444>::DivX; divY = ChromaLayout<_444>::DivY; break;
+	case _4444: numPlanes = ChromaLayout<_4444>::NumPlanes; divX = ChromaLayout<_4444>::DivX; divY = ChromaLayout<_4444>::DivY; break;
+	default: numPlanes = ChromaLayout<_420>::NumPlanes; divX = ChromaLayout<_420>::DivX; divY = ChromaLayout<_420>::DivY; break;
+	}
+}
+
+/***********************************************************************************************/
+static void computePlanes(int numPlanes, unsigned int chromaDivX, unsigned int chromaDivY, unsigned int width, unsigned int height, PlaneUpload planes[], PlaneUpload& packedTexture)
+{
+	/*
+	Computes the size of every plane and its position in the packed texture. The positions are multiples of the BC4
+	block size, so every plane starts at a block boundary of the packed texture.
+	*/
+	for (int i = 0; i < numPlanes; i++)
+	{
+		PlaneUpload& plane = planes[i];
+		bool chromaPlane = i == 1 || i == 2; //the alpha plane has the size of the luma plane
+		plane.width = chromaPlane ? width / chromaDivX : width;
+		plane.height = chromaPlane ? height / chromaDivY : height;
+		plane.rows = (plane.height + 3) / 4;
+		plane.rowBytes = ((plane.width + 3) / 4) * 8;
+		plane.imageSize = plane.rows * plane.rowBytes;
+	}
+
+	unsigned int textureWidth = planes[0].rowBytes / 8 * 4;
+	unsigned int y = 0;
+	for (int i = 0; i < numPlanes; i++)
+	{
+		planes[i].x = 0;
+		planes[i].y = y;
+		if (i == 1 && numPlanes > 2 && (planes[1].rowBytes + planes[2].rowBytes) / 8 * 4 <= textureWidth)
+		{
+			// both chroma planes fit next to each other
+			planes[2].x = planes[1].rowBytes / 8 * 4;
+			planes[2].y = y;
+			y += planes[1].rows * 4;
+			i++;
+			continue;
+		}
+		y += planes[i].rows * 4;
+	}
+
+	packedTexture.width = textureWidth;
+	packedTexture.height = y;
+	packedTexture.rows = y / 4;
+	packedTexture.rowBytes = planes[0].rowBytes;
+	packedTexture.imageSize = packedTexture.rows * packedTexture.rowBytes;
+	packedTexture.offset = 0;
+	packedTexture.dstStride = packedTexture.rowBytes;
+	packedTexture.x = 0;
+	packedTexture.y = 0;
+}
+
+/***********************************************************************************************/
+void GlUploadPlan::getPackedLayout(CHROMA_SUBSAMPLING chroma, unsigned int width, unsigned int height, PackedTextureLayout& layout)
+{
+	int numPlanes;
+	unsigned int divX, divY;
+	getChromaLayout(chroma, numPlanes, divX, divY);
+	PlaneUpload planes[MAX_UPLOAD_PLANES];
+	PlaneUpload packedTexture;
+	computePlanes(numPlanes, divX, divY, width, height, planes, packedTexture);
+
+	memset(&layout, 0, sizeof(PackedTextureLayout));
+	layout.textureWidth = packedTexture.width;
+	layout.textureHeight = packedTexture.height;
+	layout.numPlanes = numPlanes;
+	for (int i = 0; i < numPlanes; i++)
+	{
+		layout.planeRects[i][0] = planes[i].x;
+		layout.planeRects[i][1] = planes[i].y;
+		layout.planeRects[i][2] = planes[i].width;
+		layout.planeRects[i][3] = planes[i].height;
+	}
+}
+
+/***********************************************************************************************/
+GlUploadPlan::GlUploadPlan(int numPlanes, unsigned int chromaDivX, unsigned int chromaDivY, bool packed, unsigned int width, unsigned int height, const UploadWorkerPool* pool)
+{
+	m_numPlanes = numPlanes;
+	computePlanes(numPlanes, chromaDivX, chromaDivY, width, height, m_planes, m_packedTexture);
+
+	m_frameSize = 0;
+	for (int i = 0; i < m_numPlanes; i++)
+	{
+		PlaneUpload& plane = m_planes[i];
+		if (packed)
+		{
+			plane.dstStride = m_packedTexture.rowBytes;
+			plane.offset = (GLintptr)(plane.y / 4) * m_packedTexture.rowBytes + (plane.x / 4) * 8;
+		}
+		else
+		{
+			plane.dstStride = plane.rowBytes;
+			plane.offset = m_frameSize;
+			m_frameSize += plane.imageSize;
+		}
+	}
+	if (packed)
+	{
+		m_frameSize = m_packedTexture.imageSize;
+	}
+
+	for (int i = 0; i < m_numPlanes; i++)
+	{
+		const PlaneUpload& plane = m_planes[i];
+		unsigned int rowsPerSlice = pool->getRowsPerSlice(m_frameSize, plane.rows, plane.rowBytes);
+		for (unsigned int row = 0; row < plane.rows; row += rowsPerSlice)
+		{
+			SliceUpload slice;
+			slice.plane = i;
+			slice.firstRow = row;
+			slice.rows = plane.rows - row < rowsPerSlice ? plane.rows - row : rowsPerSlice;
+			m_slices.push_back(slice);
+		}
+	}
+}
+
+/***********************************************************************************************/
+void GlUploadPlan::uploadFrame(const GLuint textures[], GLintptr frameOffset) const
+{
+	GLintptr planeOffsets[MAX_UPLOAD_PLANES];
+	for (int i = 0; i < m_numPlanes; i++)
+	{
+		planeOffsets[i] = frameOffset + m_planes[i].offset;
+	}
+	uploadTextures(textures, planeOffsets);
+}
@@ -0,0 +1,382 @@
+#include "GlVideoAtlas.h"
+#include "AtlasTextureAccess.h"
+#include <Console.h>
+#include <Utils.h>
+#include "Logger.h"
+#include "Tracer.h"
+
+const size_t ATLAS_FRAME_ALIGNMENT = 256;
+
+/***********************************************************************************************/
+GlVideoAtlas::GlVideoAtlas(GLuint texture, unsigned int width, unsigned int height)
+{
+	m_texture = texture;
+	m_width = width;
+	m_height = height;
+	m_uploadPool = UploadWorkerPool::acquire();
+	m_maxWaitForGPUUploadMs = 100;
+	m_persistentMapping = false;
+	for (int i = 0; i < NUMBER_ATLAS_SLOTS; i++)
+	{
+		m_buffers[i] = 0;
+		m_mapped[i] = nullptr;
+		m_fences[i] = 0;
+	}
+	m_slotSize = 0;
+	m_slotUsed = 0;
+	m_stagingSlot = -1;
+	m_pendingSlot = -1;
+	m_nextSlot = 0;
+}
+
+/***********************************************************************************************/
+GlVideoAtlas::~GlVideoAtlas()
+{
+	waitForAllJobs();
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		AtlasRegion* region = m_regions[i];
+		if (!region)
+			continue;
+		//the sequencers that still use the atlas cannot upload anymore
+		region->owner->detach();
+		delete region->plans[0];
+		delete region->plans[1];
+		delete region;
+	}
+	m_regions.clear();
+	releaseBuffers();
+	UploadWorkerPool::release();
+}
+
+/***********************************************************************************************/
+int GlVideoAtlas::addRegion(AtlasTextureAccess* owner, CHROMA_SUBSAMPLING chroma, unsigned int videoWidth, unsigned int videoHeight)
+{
+	PackedTextureLayout layout;
+	GlUploadPlan::getPackedLayout(chroma, videoWidth, videoHeight, layout);
+	unsigned int regionWidth = layout.textureWidth;
+	unsigned int regionHeight = layout.textureHeight;
+
+	//best fit: the lowest shelf the region fits into, otherwise a new shelf below the last one
+	int shelf = -1;
+	for (size_t i = 0; i < m_shelves.size(); i++)
+	{
+		const Shelf& s = m_shelves[i];
+		if (s.height >= regionHeight && canAllocateSpan(s.freeSpans, s.usedWidth, m_width, regionWidth) && (shelf < 0 || s.height < m_shelves[shelf].height))
+		{
+			shelf = (int)i;
+		}
+	}
+	if (shelf < 0)
+	{
+		unsigned int y = m_shelves.empty() ? 0 : m_shelves.back().y + m_shelves.back().height;
+		if (regionWidth > m_width || y + regionHeight > m_height)
+		{
+			LOG_WARNING("the video atlas has no space left for a video with " << videoWidth << "x" << videoHeight << " pixels.");
+			return -1;
+		}
+		Shelf s;
+		s.y = y;
+		s.height = regionHeight;
+		s.usedWidth = 0;
+		s.numRegions = 0;
+		m_shelves.push_back(s);
+		shelf = (int)m_shelves.size() - 1;
+	}
+
+	AtlasRegion* region = new AtlasRegion();
+	region->owner = owner;
+	region->x = (unsigned int)allocateSpan(m_shelves[shelf].freeSpans, m_shelves[shelf].usedWidth, regionWidth);
+	region->y = m_shelves[shelf].y;
+	region->shelf = shelf;
+	region->layout = layout;
+	region->plans[0] = GlUploadPlan::create(chroma, false, true, videoWidth, videoHeight, m_uploadPool);
+	region->plans[1] = GlUploadPlan::create(chroma, true, true, videoWidth, videoHeight, m_uploadPool);
+	//the frames of all regions are stored one after another in every slot of the upload ring, the ring only grows if
+	//the frame fits into no space of a removed region
+	region->slotSize = (region->plans[0]->getFrameSize() + ATLAS_FRAME_ALIGNMENT - 1) / ATLAS_FRAME_ALIGNMENT * ATLAS_FRAME_ALIGNMENT;
+	region->slotOffset = allocateSpan(m_freeSlotSpans, m_slotUsed, region->slotSize);
+	for (int i = 0; i < NUMBER_ATLAS_SLOTS; i++)
+	{
+		region->staged[i] = false;
+	}
+	m_shelves[shelf].numRegions++;
+
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		if (!m_regions[i])
+		{
+			m_regions[i] = region;
+			return (int)i;
+		}
+	}
+	m_regions.push_back(region);
+	return (int)m_regions.size() - 1;
+}
+
+/***********************************************************************************************/
+void GlVideoAtlas::removeRegion(int regionIndex)
+{
+	if (regionIndex < 0 || regionIndex >= (int)m_regions.size() || !m_regions[regionIndex])
+		return;
+
+	AtlasRegion* region = m_regions[regionIndex];
+	m_uploadPool->wait(&region->job);
+	Shelf& shelf = m_shelves[region->shelf];
+	shelf.numRegions--;
+	releaseSpan(shelf.freeSpans, shelf.usedWidth, region->x, region->layout.textureWidth);
+	releaseSpan(m_freeSlotSpans, m_slotUsed, region->slotOffset, region->slotSize);
+	while (!m_shelves.empty() && m_shelves.back().numRegions == 0)
+	{
+		m_shelves.pop_back(); //the space below the last used shelf can take a shelf of any height again
+	}
+	delete region->plans[0];
+	delete region->plans[1];
+	delete region;
+	m_regions[regionIndex] = nullptr;
+}
+
+/***********************************************************************************************/
+int GlVideoAtlas::getNumRegions() const
+{
+	int numRegions = 0;
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		if (m_regions[i])
+		{
+			numRegions++;
+		}
+	}
+	return numRegions;
+}
+
+/***********************************************************************************************/
+void GlVideoAtlas::getRegionLayout(int regionIndex, PackedTextureLayout& layout) const
+{
+	memset(&layout, 0, sizeof(PackedTextureLayout));
+	if (regionIndex < 0 || regionIndex >= (int)m_regions.size() || !m_regions[regionIndex])
+		return;
+
+	const AtlasRegion* region = m_regions[regionIndex];
+	layout = region->layout;
+	layout.textureWidth = m_width;
+	layout.textureHeight = m_height;
+	for (int i = 0; i < layout.numPlanes; i++)
+	{
+		layout.planeRects[i][0] += region->x;
+		layout.planeRects[i][1] += region->y;
+	}
+}
+
+/***********************************************************************************************/
+bool GlVideoAtlas::stage(int regionIndex, const Spin_Picture* pic, bool picIsStrided)
+{
+	TRACE_SCOPE_ID("atlas stage", regionIndex);
+	AtlasRegion* region = m_regions[regionIndex];
+	if (m_slotUsed > m_slotSize && !createBuffers(m_slotUsed))
+		return false;
+	if (m_stagingSlot < 0 && !openSlot())
+	{
+		LOG_WARNING("timeout for GPU upload reached!");
+		return false;
+	}
+	if (!m_uploadPool->wait(&region->job, m_maxWaitForGPUUploadMs))
+	{
+		LOG_WARNING("timeout for GPU upload reached!");
+		return false;
+	}
+
+	region->job.clear();
+	region->plans[picIsStrided ? 1 : 0]->addCopies(region->job, pic, m_mapped[m_stagingSlot] + region->slotOffset);
+	m_uploadPool->submit(&region->job);
+	region->staged[m_stagingSlot] = true;
+	return true;
+}
+
+/***********************************************************************************************/
+void GlVideoAtlas::commit()
+{
+	TRACE_SCOPE("atlas commit");
+	/*
+	Uploads the frames that were staged before the previous commit, their copies had a whole frame to finish. The
+	frames staged since then are uploaded with the next commit.
+	*/
+	if (m_pendingSlot >= 0)
+	{
+		uploadSlot(m_pendingSlot);
+	}
+	m_pendingSlot = m_stagingSlot;
+	m_stagingSlot = -1;
+}
+
+/***********************************************************************************************/
+void GlVideoAtlas::uploadSlot(int slot)
+{
+	//without persistent mapping the buffer gets unmapped below, so no worker may write into it anymore
+	unsigned int timeoutMs = m_persistentMapping ? m_maxWaitForGPUUploadMs : INFINITE;
+	bool anyStaged = false;
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		AtlasRegion* region = m_regions[i];
+		if (!region || !region->staged[slot])
+			continue;
+		if (!m_uploadPool->wait(&region->job, timeoutMs))
+		{
+			LOG_WARNING("timeout for GPU upload reached!");
+			region->staged[slot] = false; //keeps the previous frame of this video
+			continue;
+		}
+		anyStaged = true;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[slot]);
+	if (!m_persistentMapping && m_mapped[slot])
+	{
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		m_mapped[slot] = nullptr;
+	}
+	if (anyStaged)
+	{
+		//one bind of the atlas and the buffer for all videos, every video is a single sub image of the atlas
+		glBindTexture(GL_TEXTURE_2D, m_texture);
+		for (size_t i = 0; i < m_regions.size(); i++)
+		{
+			AtlasRegion* region = m_regions[i];
+			if (!region || !region->staged[slot])
+				continue;
+			const PlaneUpload& texture = region->plans[0]->getPackedTexture();
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, region->x, region->y, texture.width, texture.height, GL_COMPRESSED_RED_RGTC1, texture.imageSize, (GLvoid*)region->slotOffset);
+			region->staged[slot] = false;
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (anyStaged)
+	{
+		if (m_fences[slot])
+		{
+			glDeleteSync(m_fences[slot]);
+		}
+		m_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+/***********************************************************************************************/
+bool GlVideoAtlas::openSlot()
+{
+	int slot = m_nextSlot;
+	if (m_fences[slot])
+	{
+		GLuint64 timeoutNs = (GLuint64)m_maxWaitForGPUUploadMs * 1000000;
+		GLenum result = glClientWaitSync(m_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNs);
+		if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+			return false;
+		glDeleteSync(m_fences[slot]);
+		m_fences[slot] = 0;
+	}
+	if (!m_persistentMapping)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[slot]);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, m_slotSize, 0, GL_STREAM_DRAW);
+		m_mapped[slot] = (GLubyte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_slotSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (!m_mapped[slot])
+		{
+			LOG_WARNING("could not map the upload buffer of the video atlas.");
+			printGlError();
+			return false;
+		}
+	}
+	m_stagingSlot = slot;
+	m_nextSlot = (slot + 1) % NUMBER_ATLAS_SLOTS;
+	return true;
+}
+
+/***********************************************************************************************/
+void GlVideoAtlas::waitForAllJobs()
+{
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		if (m_regions[i])
+		{
+			m_uploadPool->wait(&m_regions[i]->job);
+		}
+	}
+}
+
+/***********************************************************************************************/
+bool GlVideoAtlas::createBuffers(size_t slotSize)
+{
+	/*
+	Called when a region was added after the ring was created. The frames that are staged but not uploaded yet are
+	dropped, every video keeps its previous frame until it stages the next one.
+	*/
+	waitForAllJobs();
+	releaseBuffers();
+
+	m_slotSize = slotSize;
+	glGenBuffers(NUMBER_ATLAS_SLOTS, m_buffers);
+	m_persistentMapping = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	for (int i = 0; i < NUMBER_ATLAS_SLOTS && m_persistentMapping; i++)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[i]);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, m_slotSize, 0, flags);
+		m_mapped[i] = (GLubyte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_slotSize, flags);
+		if (!m_mapped[i])
+		{
+			LOG_WARNING("could not map the persistent upload buffers of the video atlas, using glMapBufferRange instead.");
+			printGlError();
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			//buffers with immutable storage cannot be orphaned, so all of them are created again
+			releaseBuffers();
+			m_slotSize = slotSize;
+			glGenBuffers(NUMBER_ATLAS_SLOTS, m_buffers);
+			m_persistentMapping = false;
+		}
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return true;
+}
+
+/***********************************************************************************************/
+void GlVideoAtlas::releaseBuffers()
+{
+	for (int i = 0; i < NUMBER_ATLAS_SLOTS; i++)
+	{
+		if (m_fences[i])
+		{
+			glDeleteSync(m_fences[i]);
+			m_fences[i] = 0;
+		}
+		if (m_mapped[i])
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[i]);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			m_mapped[i] = nullptr;
+		}
+	}
+	if (m_buffers[0])
+	{
+		glDeleteBuffers(NUMBER_ATLAS_SLOTS, m_buffers);
+	}
+	for (int i = 0; i < NUMBER_ATLAS_SLOTS; i++)
+	{
+		m_buffers[i] = 0;
+	}
+	for (size_t i = 0; i < m_regions.size(); i++)
+	{
+		if (!m_regions[i])
+			continue;
+		for (int j = 0; j < NUMBER_ATLAS_SLOTS; j++)
+		{
+			m_regions[i]->staged[j] = false;
+		}
+	}
+	m_slotSize = 0;
+	m_stagingSlot = -1;
+	m_pendingSlot = -1;
+	m_nextSlot = 0;
+}
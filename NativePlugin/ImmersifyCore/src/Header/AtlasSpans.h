@@ -0,0 +1,25 @@
+#pragma once
+
+#ifndef __atlasSpans_H__
+#define __atlasSpans_H__
+
+#include <stddef.h>
+#include <vector>
+
+// a free range of a shelf (in pixels) or of the upload slots (in bytes)
+struct AtlasSpan
+{
+	size_t offset;
+	size_t size;
+};
+
+/*
+Best fit allocation of the ranges of the video atlas: a range is taken from the smallest free span it fits into,
+otherwise from behind the used end. Released ranges are merged with their free neighbours, and a free span that reaches
+the end moves the end back, so that the atlas does not grow when its videos are swapped.
+*/
+bool canAllocateSpan(const std::vector<AtlasSpan>& freeSpans, size_t end, size_t limit, size_t size);
+size_t allocateSpan(std::vector<AtlasSpan>& freeSpans, size_t& end, size_t size);
+void releaseSpan(std::vector<AtlasSpan>& freeSpans, size_t& end, size_t offset, size_t size);
+
+#endif
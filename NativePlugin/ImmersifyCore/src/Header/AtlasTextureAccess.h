@@ -0,0 +1,30 @@
+#pragma once
+
+#ifndef __atlasTextureAccess_H__
+#define __atlasTextureAccess_H__
+
+#include "BaseTextureAccess.h"
+#include "GlVideoAtlas.h"
+
+/*
+Texture access of a video that is a part of a GlVideoAtlas. applyPictureData() only stages the frame in the upload
+ring of the atlas, the texture is updated by GlVideoAtlas::commit() together with all other videos of the atlas.
+*/
+class AtlasTextureAccess : public BaseTextureAccess
+{
+public:
+	AtlasTextureAccess(GlVideoAtlas* atlas, unsigned int width, unsigned int height, CHROMA_SUBSAMPLING chroma_subsampling);
+	~AtlasTextureAccess() override;
+
+	virtual bool applyPictureData(const Spin_Picture* pic) override;
+	virtual void clearBuffer() override { m_ready = false; }
+	bool hasRegion() const { return m_region >= 0; }
+	void getLayout(PackedTextureLayout& layout) const;
+	void detach(); // called by the atlas when it gets deleted before this texture access
+
+private:
+	GlVideoAtlas* m_atlas;
+	int m_region;
+};
+
+#endif
@@ -4,10 +4,16 @@
 #define __baseTextureAccess_H__
 
 #include <spindec.h>
+#include "ExternalPictureMemory.h"
+
+class PlayerHeartbeats;
+
 enum CHROMA_SUBSAMPLING {
 	_420 = 0,
 	_422 = 1,
-	_444 = 2
+	_444 = 2,
+	_400 = 3,	// monochrome, luma only
+	_4444 = 4	// 4:4:4 with an alpha plane
 };
 
 class BaseTextureAccess
@@ -20,6 +26,16 @@ public:
 	unsigned int height() const { return m_height; }
 	CHROMA_SUBSAMPLING getChromaSubSampling() { return m_chroma_subsampling; }
 	virtual bool applyPictureData(const Spin_Picture* pic) = 0;
+	// drops the frames that are not uploaded yet, e.g. before the playback starts
+	virtual void clearBuffer() {}
+	// uploads a frame that was staged by applyPictureData() before, if its copies are done already
+	virtual void flush() {}
+	// memory the decoder can decode into directly, NULL if the texture access has none
+	virtual ExternalPictureMemory* getExternalPictureMemory() { return nullptr; }
+	// GPU time of the latest upload whose measurement is done (usually a few frames old), -1 if not measured
+	virtual double getGpuUploadTime() const { return -1; }
+	// the heartbeats the upload reports to, see Watchdog
+	void setHeartbeats(PlayerHeartbeats* heartbeats) { m_heartbeats = heartbeats; }
 
 protected:	
 	unsigned int m_width;
@@ -28,6 +44,7 @@ protected:
 
 	bool m_ready;
 	bool m_picIsStrided;
+	PlayerHeartbeats* m_heartbeats = nullptr;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef __bottleneckClassifier_H__
+#define __bottleneckClassifier_H__
+
+#include <stdint.h>
+#include "PlayerStats.h"
+
+const int BOTTLENECK_REPORT_VERSION = 1;
+const double BOTTLENECK_WINDOW_MS = 2000.0; // the classification covers the last window only
+
+enum BOTTLENECK {
+	BOTTLENECK_UNKNOWN = 0,			// not enough data yet
+	BOTTLENECK_NONE = 1,			// the target frame rate is reached
+	BOTTLENECK_IO = 2,				// the decoder waits for av_read_frame
+	BOTTLENECK_DECODE = 3,			// SpinDecLib_DecodeAU cannot keep up
+	BOTTLENECK_UPLOAD = 4,			// decoded frames are waiting, but the texture upload is too slow
+	BOTTLENECK_RENDER_CADENCE = 5	// decoded frames are waiting, but update() is not called often enough
+};
+
+/*
+Result of the last classification window with the numbers it is based on. Like the PlaybackSnapshot the layout only
+grows at the end.
+*/
+struct BottleneckReport
+{
+	int32_t version;			// BOTTLENECK_REPORT_VERSION
+	int32_t size;				// sizeof(BottleneckReport)
+	int32_t bottleneck;			// BOTTLENECK
+	int32_t width;				// of the video
+	int32_t height;
+	int32_t chroma;				// CHROMA_SUBSAMPLING
+	double windowMS;
+	double targetFPS;
+	double presentedFPS;		// sustained during the window
+	double decodedFPS;
+	double readMSPerFrame;		// av_read_frame
+	double decodeMSPerFrame;	// SpinDecLib_DecodeAU
+	double uploadMSPerFrame;	// render thread time of applyPictureData
+	double gpuUploadMS;			// latest GPU upload time, -1 if unknown
+	double updateIntervalMS;	// average time between two update() calls
+	double queueFill;			// average number of decoded frames waiting, relative to the queue size
+	int64_t numUnderruns;		// during the window
+	int64_t numDroppedFrames;
+};
+
+/*
+Classifies the stage that limits the frame rate of one player from the differences of its PlayerStats over a window
+of BOTTLENECK_WINDOW_MS. If the target frame rate is not reached, a full queue means that the consumer side (upload or
+render thread) is too slow, an empty queue that the decoder thread is, split by where it spends its time.
+Used by the render thread of the sequencer only.
+*/
+class BottleneckClassifier
+{
+public:
+	BottleneckClassifier();
+
+	// starts a new window, e.g. after a pause
+	void restart();
+	// called with every update(), returns true if the window is complete and classify() should be called
+	bool addSample(double nowMs, int queueSize);
+	// returns true if the bottleneck differs from the previous window
+	bool classify(double nowMs, const PlayerStats& stats, double targetFPS, int maxQueueSize, double gpuUploadMs, BottleneckReport& report);
+
+	static const char* getName(BOTTLENECK bottleneck);
+	// one line for operators, e.g. "decode bound at 7680x4320 444, 43.0 fps sustained (target 60.0), ..."
+	static void describe(const BottleneckReport& report, char* buffer, int bufferSize);
+
+private:
+	double m_windowStartMs;
+	double m_lastUpdateMs;
+	double m_updateIntervalSumMs;
+	int64_t m_numUpdates;
+	int64_t m_queueSizeSum;
+	bool m_hasBaseline;			// m_baseline holds the stats at the start of the window
+	PlayerStats m_baseline;
+	BOTTLENECK m_lastBottleneck;
+};
+
+#endif
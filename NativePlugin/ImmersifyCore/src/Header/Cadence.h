@@ -0,0 +1,38 @@
+#pragma once
+
+#ifndef __cadence_H__
+#define __cadence_H__
+
+#include <stdint.h>
+
+const int MAX_CADENCE_PATTERN = 10; // frames of the longest pattern that is described exactly
+
+/*
+Maps the frames of a video with a rational frame rate onto the vsyncs of a display with a known refresh rate, e.g. 3:2
+for 24 fps at 60 Hz or 5:5 at 120 Hz. Frame k is shown from vsync round(k * refresh / frameRate) on, computed with
+integers, so the pattern never drifts, also for 23.976 fps at 60 Hz where it has to break once every 400 frames.
+Refresh rates like 59.94 Hz are taken as 60000/1001.
+*/
+class Cadence
+{
+public:
+	Cadence();
+	// refreshRateHz <= 0 or an invalid frame rate disables the cadence
+	void set(int64_t frameRateNum, int64_t frameRateDen, double refreshRateHz);
+	bool isActive() const { return m_frameRateNum > 0 && m_refreshNum > 0; }
+	double getVsyncInterval() const;	// in ms
+	double getFrameDuration() const;	// in ms
+	int64_t getFrame(double ms) const;	// frame that is due ms after the first one
+	int64_t getVsync(int64_t frame) const;	// first vsync of the frame, counted from the first frame
+	int getNumVsyncs(int64_t frame) const { return (int)(getVsync(frame + 1) - getVsync(frame)); }
+	// e.g. "3:2 (23.976 fps at 59.94 Hz)" or "3:2, one vsync more every 400 frames (23.976 fps at 60.00 Hz)"
+	void describe(char* buffer, int bufferSize) const;
+
+private:
+	int64_t m_frameRateNum;
+	int64_t m_frameRateDen;
+	int64_t m_refreshNum;
+	int64_t m_refreshDen;
+};
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef __copyKernels_H__
+#define __copyKernels_H__
+
+#include <stddef.h>
+
+/*
+Copy kernels for writing picture data into mapped upload buffers (PBOs). The destination is write-combined memory
+that is never read back by the CPU, so the kernels use non-temporal (streaming) stores that bypass the cache and
+prefetch the source rows ahead of the copy. The best kernel for the CPU is selected once at runtime.
+*/
+enum COPY_KERNEL {
+	COPY_KERNEL_MEMCPY = 0,
+	COPY_KERNEL_SSE2 = 1,
+	COPY_KERNEL_AVX2 = 2,
+	COPY_KERNEL_AVX512 = 3,
+	COPY_KERNEL_NEON = 4
+};
+
+// copies size bytes with streaming stores. Falls back to memcpy for small copies.
+void streamCopy(unsigned char* dst, const unsigned char* src, size_t size);
+
+// copies rows of rowBytes each from a strided source into a tightly packed destination
+void streamCopyRows(unsigned char* dst, const unsigned char* src, unsigned int rows, unsigned int rowBytes, unsigned int srcStride);
+
+// same as streamCopyRows, but the destination rows are dstStride bytes apart
+void streamCopyRows(unsigned char* dst, unsigned int dstStride, const unsigned char* src, unsigned int srcStride, unsigned int rows, unsigned int rowBytes);
+
+COPY_KERNEL getStreamCopyKernel();
+bool isStreamCopyKernelSupported(COPY_KERNEL kernel);
+// overrides the automatically selected kernel (e.g. for benchmarking), also while copies are running. Returns false if
+// the CPU does not support it.
+bool setStreamCopyKernel(COPY_KERNEL kernel);
+const char* copyKernelToString(COPY_KERNEL kernel);
+
+#endif
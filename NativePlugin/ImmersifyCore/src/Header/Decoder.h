@@ -13,7 +13,14 @@
 #include <cstring>
 #include <future>
 #include <queue>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include "BaseTextureAccess.h"
+#include "LatencyHistogram.h"
+#include "Watchdog.h"
+#include "ScrubCache.h"
 
 static const char* strChromaFmt[] = { "400", "420", "422", "444", "Undefined" };
 
@@ -33,18 +40,49 @@ typedef struct VideoInformation {
 	int width = -1;
 	int height = -1;
 	double fps = 0.0;
+	int frameRateNum = 0;	// r_frame_rate of the stream, e.g. 24000/1001
+	int frameRateDen = 1;
 	int64_t durationMS = 0.0;
 	bool isInitialized = false;
 	CHROMA_SUBSAMPLING chroma_subsampling;
 	std::string videoPath;
 } VideoInformation;
 
+// true if the rows of a plane are not packed without gaps, i.e. every row has to be copied separately
+inline bool pictureIsStrided(const Spin_Picture* pic)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		if (pic->asPlanes[i].pPlane && pic->asPlanes[i].iStride != pic->asPlanes[i].iWidth)
+			return true;
+	}
+	return false;
+}
+
+// bytes of the BC4 blocks of all planes
+inline size_t getPictureSize(const Spin_Picture* pic)
+{
+	size_t size = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (pic->asPlanes[i].pPlane)
+			size += (size_t)pic->asPlanes[i].iWidth * pic->asPlanes[i].iHeight * 8;
+	}
+	return size;
+}
+
 typedef struct PictureContainer {
 	SpinDec_Picture* pHEVCPic; // actual picture
 	bool needoutput; // true if the picture still needs to be displayed / written to output
 	double decodingTime;
 	int decodingSteps;
-	int frameNumber;
+	int frameNumber;		// derived from ptsMS and the frame rate
+	int64_t pts;			// presentation time stamp in the time base of the stream, as returned by SpinDecLib_DecodeAU
+	double ptsMS;			// presentation time relative to the start of the stream
+	bool discontinuity;		// first picture after the start, a seek or a loop
+	bool scrubbed;			// a key frame shown while scrubbing, scaled up from the resolution of the scrub mode
+	double queuedTime; // when the picture was put into the frame queue, in s
+	bool externalMemory; // the planes live in the ExternalPictureMemory instead of memory from SpinLib_AllocFrame
 } PictureContainer;
 
 
@@ -52,7 +90,7 @@ class Decoder
 {
 	std::list<PictureContainer*> m_lDecPicPool;
 	std::map<void*, PictureContainer*> m_mExtPic;
-	std::queue<PictureContainer*> frameQueue;
+	std::deque<PictureContainer*> frameQueue;
 	
 	mutable std::mutex m_mutex;
 	std::condition_variable m_cv;
@@ -60,7 +98,7 @@ class Decoder
 public:
   Decoder();
   ~Decoder();
-  bool isActive;
+  std::atomic<bool> isActive;
   void  createDecoder(int iNumOutPictureBuffer = -1, int iNumThreads = -1, int maxQueueSize = -1, bool writeLogs =  false);
   VideoInformation loadMP4(const char* src_filename);
   void  destroy();  
@@ -68,13 +106,43 @@ public:
   void   run(bool shouldLoop);
   void   stop();
   const PictureContainer* getPic();
+  // the picture the ahead + 1 th next getPic() returns, without taking it. NULL if it is not decoded yet.
+  const PictureContainer* peekPic(int ahead) const;
   bool isFinished();
   bool getPicIsStrided();
+  int getNumStridedPictures() const { return m_numStridedPictures; }
   bool getSeekingIsSupported();
   bool isVideoFileLoaded();
   int getCurrentFrameNumber();
+  // presentation time of the picture returned by the last getPic() in ms
+  double getCurrentPtsMS() const { return m_outPtsMS; }
+  int getQueueSize() const;
+  int getMaxQueueSize() const { return m_bufferQueueMaxSize; }
   int getCurrentErrorCode();
   void seekToMSecond(int64_t seekForMSeconds);
+  // memory to decode the pictures into (e.g. mapped upload buffers of the texture access). Has to outlive the decoder.
+  void setExternalPictureMemory(ExternalPictureMemory* pictureMemory) { m_pictureMemory = pictureMemory; }
+  // the sequencer the PlayerEvents of the decoder thread are posted for
+  void setEventOwner(const void* owner) { m_eventOwner = owner; }
+  // the heartbeats the decoder thread reports its stages to, can be NULL
+  void setHeartbeats(PlayerHeartbeats* heartbeats) { m_heartbeats = heartbeats; }
+  // interrupts a blocking read and lets the decoder thread open the input again at the current position
+  void requestReopen() { m_reopenRequested = true; }
+  bool isReopenRequested() const { return m_reopenRequested; }
+  // frames the decoder library skips without decoding them (e.g. for fast playback). Applied by the decoder thread,
+  // which has to open the library again and continues at the last decoded picture.
+  void setDiscardMode(SE_FrameDiscardMode discardMode);
+  SE_FrameDiscardMode getDiscardMode() const { return (SE_FrameDiscardMode)m_discardMode.load(); }
+  static const char* getDiscardModeName(SE_FrameDiscardMode discardMode);
+  // the scrub mode decodes only the key frames, at 1 / 2^log2DownScale of the resolution, and shows the one at or
+  // before the position of scrubToMSecond(). Stopping it decodes the exact frame of the last position.
+  void setScrubMode(bool scrubbing, int log2DownScale);
+  void scrubToMSecond(int64_t scrubToMSecond);
+  int64_t getNumScrubCacheHits() const { return m_scrubCache.getNumHits(); }
+  int64_t getNumScrubCacheMisses() const { return m_scrubCache.getNumMisses(); }
+  // fills the decoder part of the stats, can be called from any thread
+  void getStats(PlayerStats& stats) const;
+  void resetStats();
 
 private:
 	SpinDec_Param m_sDecParam;
@@ -89,10 +157,28 @@ private:
 	bool m_bVideoIsSeekable;
 	SpinDec_Descript m_hDescript;
 	int m_iOutframes;
+	double m_outPtsMS;
+	AVRational m_timeBase;		// of the video stream
+	int64_t m_startPts;			// pts of the first frame of the stream in m_timeBase
+	double m_lastPtsMS;			// of the last decoded picture, for pictures without pts
+	bool m_timelineStart;		// the next decoded picture starts a new timeline
+	std::atomic<int> m_requestedDiscardMode;	// SE_FrameDiscardMode
+	std::atomic<int> m_discardMode;				// the one the library was opened with
+	double m_skipUntilPtsMS;	// pictures up to this pts are decoded again after reopening the library, but not queued
+	std::atomic<int> m_requestedScrubDownScale;	// -1 if not scrubbing
+	int m_scrubDownScale;		// the library was opened with, -1 if not scrubbing
+	std::atomic<int64_t> m_scrubToMSecond;	// the latest scrub position that is not shown yet, -1 if none
+	double m_scrubPtsMS;		// the last scrub position, -1 if none
+	ScrubCache m_scrubCache;
 	int m_bufferQueueMaxSize;
 	int m_streamIndex;
 	int m_currentErrorCode = 0;
 	int64_t m_seekToMSecond = -1;
+	bool m_seekPending = false; // a seek was done, but no picture was decoded since then
+	const void* m_eventOwner = nullptr;
+	std::atomic<PlayerHeartbeats*> m_heartbeats;
+	std::atomic<bool> m_reopenRequested;
+	std::string m_videoPath;
 	double m_decodingTime;
 	uint8_t *m_pNalUnit;
 	SpinDec_Picture* m_picOut;
@@ -100,13 +186,36 @@ private:
 	HANDLE thandle;
 	DWORD threadid;
 	SpinDec_Picture* getNewPictureBuffer();
+	bool moveToExternalMemory(PictureContainer* pPicCon);
+	bool allocPackedFrame(Spin_Picture* pic);
+	std::atomic<int> m_numStridedPictures; // pictures that could not be allocated without stride
+	bool isPictureInUse(PictureContainer* pPicCon);
+	ExternalPictureMemory* m_pictureMemory = nullptr;
 	bool fileIsSeekable();
+	void setInterruptCallback();
+	bool reopenInput();
+	bool reopenDecoder();
+	bool isDecoderConfigChanged() const;
+	bool scrub(int64_t scrubToMSecond);
+	ScrubPicture* decodeKeyFrame(int64_t key);
+	void queueScrubPicture(const ScrubPicture* scrubPicture);
+	Spin_Picture getOutputPictureDesc() const;
+	double getFrameRate() const;	// nominal, 0 if unknown
 	
 	void   allocPictureBuffer(PictureContainer* pPicCon);         
 	void  xPrintPicInfo(const SpinDec_Picture* pPic);           
 	void  xPrintVideoInfo(const SpinDec_Descript & rDecDescript);
 	double getDecoderTime();
+	double ptsToMS(int64_t pts) const;
+	int64_t msToPts(double ms) const;
+	void setPresentationTime(PictureContainer* pPicCon, const SpinDec_Picture* pic);
 	AVFormatContext *m_avformatContext;
+	LatencyHistogram m_decodeTimeHistogram;
+	LatencyHistogram m_queueTimeHistogram;
+	LatencyHistogram m_readTimeHistogram;
+	StatCounter m_numDecodedFrames;
+	StatCounter m_bytesRead;
+	StatCounter m_numReopens;	// of SpinDecLib for a new discard or scrub mode
 };
 
 #endif
@@ -0,0 +1,29 @@
+#pragma once
+
+#ifndef __externalPictureMemory_H__
+#define __externalPictureMemory_H__
+
+#include <stddef.h>
+
+/*
+Memory for decoded pictures that is owned by a texture access (e.g. a persistently mapped upload buffer). The decoder
+places the external picture buffers it hands to SpinDecLib_DecodeAU into it, so the upload of such a picture needs no
+CPU copy. The GPU might still read a picture after the sequencer is done with it, so the decoder must not reuse a
+picture while isPictureInUse() returns true.
+All methods are called from the decoder thread and have to be thread safe.
+*/
+class ExternalPictureMemory
+{
+public:
+	virtual ~ExternalPictureMemory() {}
+
+	// asks for memory for numPictures pictures of pictureSize bytes. The memory is created later by the owner (e.g. on
+	// the render thread), until then allocatePicture() returns NULL.
+	virtual void reserve(unsigned int numPictures, size_t pictureSize) = 0;
+	// returns NULL if the memory is not created yet, exhausted or the picture is too big
+	virtual unsigned char* allocatePicture(size_t size) = 0;
+	virtual void releasePicture(const void* pictureData) = 0;
+	virtual bool isPictureInUse(const void* pictureData) = 0;
+};
+
+#endif
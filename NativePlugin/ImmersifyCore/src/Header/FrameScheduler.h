@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef __frameScheduler_H__
+#define __frameScheduler_H__
+
+#include "Decoder.h"
+#include "LatencyHistogram.h"
+#include "PlayerStats.h"
+#include "Cadence.h"
+
+const double DEFAULT_RENDER_INTERVAL_MS = 1000.0 / 60.0;
+const double MAX_RENDER_INTERVAL_MS = 100.0;	// longer gaps between two updates are hitches, not the display rate
+const double MAX_SCHEDULE_OFFSET_MS = 1000.0;	// a frame further away from its target time starts a new timeline
+
+enum SCHEDULE_DECISION {
+	SCHEDULE_WAIT,		// the next frame is not due yet (or not decoded yet)
+	SCHEDULE_PRESENT,	// take and present the next frame
+	SCHEDULE_SKIP		// the next frame is late and the one after it is due as well, take it without presenting
+};
+
+/*
+Decides per render frame which decoded frame is presented. The target present time of every frame is computed from
+the epoch (playback time and pts of the frame that started the timeline) and its own pts, so the lateness of single
+render calls does not add up. A frame is due if its target time is closer to the upcoming vsync than to the one after
+it; the vsync interval is estimated from the intervals of the update calls. Late frames whose successor is due as well
+are skipped, so the playback catches up in one render frame instead of running behind.
+If the refresh rate of the display is known and the video plays at its own frame rate, the target times follow the
+Cadence instead, i.e. they lie exactly on the vsyncs of the pulldown pattern, and frames that are shown for a different
+number of vsyncs are counted as cadence breaks.
+A seek, a loop or a pause starts a new timeline at the next frame. Only used by the render thread, the statistics can
+be read and reset from any thread.
+*/
+class FrameScheduler
+{
+public:
+	FrameScheduler();
+
+	void reset();									// the next frame starts a new timeline
+	void setRate(double rate, double nowMs);		// media ms per playback ms, 0 presents every frame as soon as possible
+	void setCadence(const Cadence& cadence);
+	bool usesCadence() const { return m_cadence.isActive() && m_rate == 1.0; }
+	double getRate() const { return m_rate; }
+	void beginUpdate(double nowMs);					// once per render frame, before decide()
+	SCHEDULE_DECISION decide(const PictureContainer* next, const PictureContainer* following);
+	// records the drift and judder of a presented frame, returns its drift
+	double framePresented(double ptsMS);
+
+	bool hasTimeline() const { return m_hasEpoch && m_rate > 0; }
+	double getTargetTime(double ptsMS) const;		// playback time the frame should become visible
+	double getMediaTime(double nowMs) const;		// pts that should be visible at nowMs
+	double getTimeUntilDue(double ptsMS, double nowMs) const;
+	bool isDue(double ptsMS) const;
+	double getRenderInterval() const { return m_renderIntervalMs; }
+	double getLastDrift() const { return m_lastDriftMs; }
+	int64_t getNumSkippedFrames() const { return m_skippedCounter.get(); }
+	int64_t getNumCadenceBreaks() const { return m_cadenceBreakCounter.get(); }
+	bool takeCadenceBreak();						// true if the cadence broke since the last call
+
+	void getStats(PlayerStats& stats) const;
+	void resetStats();
+
+private:
+	void startTimeline(double ptsMS);
+
+	double m_rate;
+	bool m_hasEpoch;
+	double m_epochTime;			// playback time when the epoch frame became visible
+	double m_epochPtsMS;
+	double m_lastUpdateTime;	// -1 before the first update
+	double m_renderIntervalMs;	// smoothed interval of the update calls
+	double m_presentTime;		// when a frame presented in the current update becomes visible
+	bool m_hasLastFrame;		// on the current timeline
+	double m_lastPtsMS;
+	double m_lastPresentTime;
+	double m_lastDriftMs;
+	Cadence m_cadence;
+	StatCounter m_cadenceBreakCounter;
+	bool m_cadenceBroken;
+	void addCadenceBreak();
+	StatCounter m_skippedCounter;
+	StatCounter m_resyncCounter;
+	LatencyHistogram m_driftHistogram;
+	LatencyHistogram m_judderHistogram;
+};
+
+#endif
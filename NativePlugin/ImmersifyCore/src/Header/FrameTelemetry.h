@@ -0,0 +1,101 @@
+#pragma once
+
+#ifndef __frameTelemetry_H__
+#define __frameTelemetry_H__
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include "LockFreeQueue.h"
+#include "SeqLock.h"
+#include <vector>
+
+const int FRAME_TELEMETRY_VERSION = 3;
+
+// one record per presented frame, written as is into the telemetry file
+struct FrameRecord
+{
+	int64_t frameNumber;
+	double presentTimeMS;		// playback time when the frame was applied
+	double frameIntervalMS;		// time since the previous frame
+	double decodeMS;			// time spent in SpinDecLib_DecodeAU for the frame
+	double decodingTimeMS;		// dDecodingTime of the decoder
+	double frameLatencyMS;		// dFrameLatency of the decoder
+	double uploadMS;			// render thread time of applyPictureData
+	int32_t queueSize;			// decoded frames waiting after this one
+	int32_t decodingSteps;
+	int32_t qp;
+	uint32_t codedSize;			// bytes
+	int32_t uploadFailed;
+	int32_t reserved;
+	double gpuUploadMS;			// GPU time of the latest measured texture upload (a few frames earlier), -1 if unknown
+	double ptsMS;				// presentation time stamp of the frame (version 3)
+};
+
+struct FrameTelemetryFileHeader
+{
+	char magic[4];				// "IFTR"
+	int32_t version;			// FRAME_TELEMETRY_VERSION
+	int32_t recordSize;			// sizeof(FrameRecord)
+	int32_t reserved;
+};
+
+enum TELEMETRY_FORMAT {
+	TELEMETRY_FORMAT_CSV = 0,
+	TELEMETRY_FORMAT_JSON = 1
+};
+
+/*
+Per frame timing records of one sequencer. record() only copies the fixed size record into a preallocated lock-free
+ring, a background thread writes the records in batches into a binary file, so the measurement does not disturb the
+render thread it measures. If the writer falls behind, records are dropped and counted instead of blocking.
+exportRecords() converts a binary file into CSV or JSON.
+*/
+class FrameTelemetry
+{
+public:
+	FrameTelemetry();
+	~FrameTelemetry(); // writes the remaining records and closes the file
+
+	bool open(const std::string& path);
+	void record(const FrameRecord& frameRecord);
+	int64_t getNumLostRecords() const { return m_numLostRecords; }
+
+	static bool exportRecords(const char* binaryPath, const char* outputPath, TELEMETRY_FORMAT format);
+	// one CSV line or JSON object, first is false for all records but the first of a JSON array
+	static void writeRecord(FILE* out, const FrameRecord& r, TELEMETRY_FORMAT format, bool first);
+
+private:
+	static DWORD WINAPI run(void* param);
+	void drain();
+
+	FILE* m_file;
+	HANDLE m_thread;
+	std::atomic<bool> m_run;
+	std::atomic<int64_t> m_numLostRecords;
+	LockFreeQueue<FrameRecord, 4096> m_queue;
+};
+
+const int FRAME_HISTORY_SIZE = 1024; // 17 s at 60 fps
+
+/*
+The latest frame records of one sequencer in memory, independent of the telemetry file, so that the watchdog can dump
+what happened right before a stall. Written by the render thread only, every entry is a seqlock, so any thread can
+read a consistent copy.
+*/
+class FrameHistory
+{
+public:
+	FrameHistory() : m_numRecords(0) {}
+	void record(const FrameRecord& frameRecord);
+	// the records of the last durationMs of presentation time before the latest record, oldest first
+	void getRecords(double durationMs, std::vector<FrameRecord>& records) const;
+
+private:
+	SeqLock<FrameRecord> m_records[FRAME_HISTORY_SIZE];
+	std::atomic<int64_t> m_numRecords;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef __glPictureMemory_H__
+#define __glPictureMemory_H__
+
+#include <gl/glew.h>
+#include <vector>
+#include <mutex>
+#include "ExternalPictureMemory.h"
+
+/*
+Decoded pictures inside one persistently mapped pixel unpack buffer. The buffer is split into equally sized slots, one
+per picture. The decoder writes its BC4 output directly into a slot and the texture upload reads it from there, so
+there is no CPU copy between decoder and GPU. After the upload a fence is placed behind it and the slot stays in use
+until the fence is signaled.
+The buffer has to be created and deleted on the render thread, so reserve() only records the request and update()
+creates the buffer with the next frame.
+*/
+class GlPictureMemory : public ExternalPictureMemory
+{
+public:
+	GlPictureMemory();
+	~GlPictureMemory() override;
+
+	// ExternalPictureMemory, called by the decoder thread
+	void reserve(unsigned int numPictures, size_t pictureSize) override;
+	unsigned char* allocatePicture(size_t size) override;
+	void releasePicture(const void* pictureData) override;
+	bool isPictureInUse(const void* pictureData) override;
+
+	// called by the render thread only
+	void update(); // creates the requested buffer and frees the slots the GPU is done with
+	void release(); // the decoder must not use any picture of this memory anymore
+	void disable(); // no buffer is created, the decoder keeps its own memory
+	bool contains(const void* pictureData);
+	GLuint getBuffer() const { return m_buffer; }
+	GLintptr getOffset(const void* data) const { return (const GLubyte*)data - m_base; }
+	void markInUse(const void* pictureData);
+
+private:
+	int getSlot(const void* pictureData) const;
+	bool create(unsigned int numSlots, size_t slotSize);
+
+	std::mutex m_mutex;
+	GLuint m_buffer;
+	GLubyte* m_base;
+	size_t m_slotSize;
+	unsigned int m_numSlots;
+	unsigned int m_requestedSlots;
+	size_t m_requestedSlotSize;
+	bool m_createFailed;
+	std::vector<bool> m_allocated;	// handed to the decoder
+	std::vector<bool> m_inUse;		// the GPU might still read from the slot
+	std::vector<GLsync> m_fences;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+
+#ifndef __glUploadPlan_H__
+#define __glUploadPlan_H__
+
+#include <gl/glew.h>
+#include <spindec.h>
+#include <vector>
+#include "BaseTextureAccess.h"
+#include "UploadWorkerPool.h"
+
+const int MAX_UPLOAD_PLANES = 4;
+
+// number of planes and subsampling of the chroma planes per chroma format
+template<CHROMA_SUBSAMPLING Chroma> struct ChromaLayout;
+template<> struct ChromaLayout<_400> { static const int NumPlanes = 1; static const unsigned int DivX = 1; static const unsigned int DivY = 1; };
+template<> struct ChromaLayout<_420> { static const int NumPlanes = 3; static const unsigned int DivX = 2; static const unsigned int DivY = 2; };
+template<> struct ChromaLayout<_422> { static const int NumPlanes = 3; static const unsigned int DivX = 2; static const unsigned int DivY = 1; };
+template<> struct ChromaLayout<_444> { static const int NumPlanes = 3; static const unsigned int DivX = 1; static const unsigned int DivY = 1; };
+template<> struct ChromaLayout<_4444> { static const int NumPlanes = 4; static const unsigned int DivX = 1; static const unsigned int DivY = 1; };
+
+// everything needed to copy and upload one plane
+struct PlaneUpload
+{
+	GLsizei width;			// texture size in pixels
+	GLsizei height;
+	unsigned int rows;		// rows of BC4 blocks
+	unsigned int rowBytes;	// one BC4 block (4x4 pixels) has 8 bytes
+	GLsizei imageSize;
+	GLintptr offset;		// of the plane inside a packed frame
+	unsigned int dstStride;	// distance of the rows inside the frame, bigger than rowBytes in the packed texture
+	unsigned int x;			// position inside the packed texture in pixels
+	unsigned int y;
+};
+
+// a part of a plane that is copied by one upload worker
+struct SliceUpload
+{
+	int plane;
+	unsigned int firstRow;
+	unsigned int rows;
+};
+
+/*
+Position of the planes inside the single packed texture, as needed by the shader. The luma plane is at the top, the
+chroma planes are placed below it side by side if they fit, otherwise below each other. The alpha plane is last.
+*/
+struct PackedTextureLayout
+{
+	int textureWidth;
+	int textureHeight;
+	int numPlanes;
+	int planeRects[MAX_UPLOAD_PLANES][4]; // x, y, width, height in pixels
+};
+
+/*
+The layout of a video in the upload buffers (plane sizes, offsets, worker slices and the parameters of
+glCompressedTexSubImage2D) only depends on the size and the chroma format, so it is computed once per video. The per
+frame work is done by GlUploadPlanT, which is instantiated per chroma format, stride mode and texture layout, so that
+none of them is checked again for every frame.
+*/
+class GlUploadPlan
+{
+public:
+	static GlUploadPlan* create(CHROMA_SUBSAMPLING chroma, bool strided, bool packed, unsigned int width, unsigned int height, const UploadWorkerPool* pool);
+	static void getPackedLayout(CHROMA_SUBSAMPLING chroma, unsigned int width, unsigned int height, PackedTextureLayout& layout);
+	virtual ~GlUploadPlan() {}
+
+	// adds the copies of all planes of pic into the frame at dst
+	virtual void addCopies(UploadJob& job, const Spin_Picture* pic, unsigned char* dst) const = 0;
+	// updates the textures from the bound pixel unpack buffer (one offset per plane, not used for the packed texture)
+	virtual void uploadTextures(const GLuint textures[], const GLintptr planeOffsets[]) const = 0;
+	// same for a frame at frameOffset
+	void uploadFrame(const GLuint textures[], GLintptr frameOffset) const;
+
+	int getNumPlanes() const { return m_numPlanes; }
+	const PlaneUpload& getPlane(int plane) const { return m_planes[plane]; }
+	size_t getFrameSize() const { return m_frameSize; }
+	const PlaneUpload& getPackedTexture() const { return m_packedTexture; }
+
+protected:
+	GlUploadPlan(int numPlanes, unsigned int chromaDivX, unsigned int chromaDivY, bool packed, unsigned int width, unsigned int height, const UploadWorkerPool* pool);
+
+	int m_numPlanes;
+	PlaneUpload m_planes[MAX_UPLOAD_PLANES];
+	std::vector<SliceUpload> m_slices;
+	size_t m_frameSize;
+	PlaneUpload m_packedTexture; // the whole packed texture as one plane
+};
+
+/***********************************************************************************************/
+template<CHROMA_SUBSAMPLING Chroma, bool Strided, bool Packed>
+class GlUploadPlanT : public GlUploadPlan
+{
+public:
+	static const int NumPlanes = ChromaLayout<Chroma>::NumPlanes;
+
+	GlUploadPlanT(unsigned int width, unsigned int height, const UploadWorkerPool* pool)
+		: GlUploadPlan(NumPlanes, ChromaLayout<Chroma>::DivX, ChromaLayout<Chroma>::DivY, Packed, width, height, pool)
+	{
+	}
+
+	void addCopies(UploadJob& job, const Spin_Picture* pic, unsigned char* dst) const override
+	{
+		unsigned int srcStrides[NumPlanes];
+		for (int i = 0; i < NumPlanes; i++)
+		{
+			srcStrides[i] = Strided ? pic->asPlanes[i].iStride * 8 : m_planes[i].rowBytes;
+		}
+		for (size_t i = 0; i < m_slices.size(); i++)
+		{
+			const SliceUpload& slice = m_slices[i];
+			const PlaneUpload& plane = m_planes[slice.plane];
+			const unsigned char* src = (const unsigned char*)pic->asPlanes[slice.plane].pPlane + (size_t)slice.firstRow * srcStrides[slice.plane];
+			job.addSlice(dst + plane.offset + (size_t)slice.firstRow * plane.dstStride, src, slice.rows, plane.rowBytes, srcStrides[slice.plane], Packed ? plane.dstStride : plane.rowBytes);
+		}
+	}
+
+	void uploadTextures(const GLuint textures[], const GLintptr planeOffsets[]) const override
+	{
+		if (Packed)
+		{
+			glBindTexture(GL_TEXTURE_2D, textures[0]);
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_packedTexture.width, m_packedTexture.height, GL_COMPRESSED_RED_RGTC1, m_packedTexture.imageSize, (GLvoid*)(planeOffsets[0] - m_planes[0].offset));
+		}
+		else
+		{
+			for (int i = 0; i < NumPlanes; i++)
+			{
+				glBindTexture(GL_TEXTURE_2D, textures[i]);
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_planes[i].width, m_planes[i].height, GL_COMPRESSED_RED_RGTC1, m_planes[i].imageSize, (GLvoid*)planeOffsets[i]);
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+};
+
+#endif
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifndef __glVideoAtlas_H__
+#define __glVideoAtlas_H__
+
+#include <gl/glew.h>
+#include <vector>
+#include "AtlasSpans.h"
+#include "GlUploadPlan.h"
+#include "UploadWorkerPool.h"
+
+const int NUMBER_ATLAS_SLOTS = 3;
+class AtlasTextureAccess;
+
+// a sub rectangle of the atlas texture that holds the packed planes of one video
+struct AtlasRegion
+{
+	AtlasTextureAccess* owner;	// NULL if the region is free
+	unsigned int x;				// position in the atlas in pixels
+	unsigned int y;
+	int shelf;
+	PackedTextureLayout layout;	// of the video itself, the planes start at (0, 0)
+	size_t slotOffset;			// of the frame inside an upload slot
+	size_t slotSize;			// of the frame, aligned to ATLAS_FRAME_ALIGNMENT
+	GlUploadPlan* plans[2];		// not strided and strided pictures
+	UploadJob job;
+	bool staged[NUMBER_ATLAS_SLOTS];
+};
+
+/*
+One BC4 texture that is shared by many small videos (e.g. for a video wall). Every video gets a sub rectangle of the
+atlas, which is allocated on shelves (rows of regions with the height of the highest region). The space of a removed
+video is reused by the next video that fits into it, so that a video wall can swap its clips without growing the
+upload ring. All videos share one upload ring: the sequencers only stage their new frames into the current slot (the
+copies are done by the upload worker pool) and commit() uploads all regions that got a new frame with a single texture
+and buffer bind.
+The upload is delayed by one commit, so that the render thread does not wait for the copies.
+All methods have to be called on the render thread.
+*/
+class GlVideoAtlas
+{
+public:
+	GlVideoAtlas(GLuint texture, unsigned int width, unsigned int height);
+	~GlVideoAtlas();
+
+	// returns -1 if there is no space left
+	int addRegion(AtlasTextureAccess* owner, CHROMA_SUBSAMPLING chroma, unsigned int videoWidth, unsigned int videoHeight);
+	void removeRegion(int region);
+	void getRegionLayout(int region, PackedTextureLayout& layout) const; // plane positions inside the atlas
+
+	bool stage(int region, const Spin_Picture* pic, bool picIsStrided);
+	void commit();
+	int getNumRegions() const;
+
+private:
+	struct Shelf
+	{
+		unsigned int y;
+		unsigned int height;
+		size_t usedWidth;		// the regions and free spans lie left of it
+		unsigned int numRegions;
+		std::vector<AtlasSpan> freeSpans;
+	};
+
+	bool openSlot();
+	void uploadSlot(int slot);
+	void waitForAllJobs();
+	bool createBuffers(size_t slotSize);
+	void releaseBuffers();
+
+	GLuint m_texture;
+	unsigned int m_width;
+	unsigned int m_height;
+	std::vector<Shelf> m_shelves;
+	std::vector<AtlasRegion*> m_regions;
+	UploadWorkerPool* m_uploadPool;
+	unsigned int m_maxWaitForGPUUploadMs;
+
+	bool m_persistentMapping;
+	GLuint m_buffers[NUMBER_ATLAS_SLOTS];
+	GLubyte* m_mapped[NUMBER_ATLAS_SLOTS];
+	GLsync m_fences[NUMBER_ATLAS_SLOTS];
+	size_t m_slotSize;		// size of the buffers
+	size_t m_slotUsed;		// end of the frames of all regions
+	std::vector<AtlasSpan> m_freeSlotSpans;	// frames of removed regions below m_slotUsed
+	int m_stagingSlot;		// slot the sequencers write into, -1 if not opened yet
+	int m_pendingSlot;		// slot that is uploaded with the next commit, -1 if none
+	int m_nextSlot;
+};
+
+#endif
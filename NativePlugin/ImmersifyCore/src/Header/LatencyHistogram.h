@@ -0,0 +1,52 @@
+#pragma once
+
+#ifndef __latencyHistogram_H__
+#define __latencyHistogram_H__
+
+#include <atomic>
+#include <stdint.h>
+#include "PlayerStats.h"
+
+// values below LINEAR_HISTOGRAM_BUCKETS us get one bucket each, above that every power of two is split into
+// SUB_HISTOGRAM_BUCKETS buckets, which keeps the relative error below 1/16 up to 2^37 us (38 hours)
+const int LINEAR_HISTOGRAM_BUCKETS = 32;
+const int SUB_HISTOGRAM_BUCKETS = 16;
+const int NUM_HISTOGRAM_BUCKETS = LINEAR_HISTOGRAM_BUCKETS + 32 * SUB_HISTOGRAM_BUCKETS;
+
+/*
+Latency distribution with a fixed set of log-linear buckets (like an HDR histogram), so recording is one increment
+without allocation. All members are atomics: any thread can record, read or reset without a lock. A reset while
+recording can lose the values recorded at the same time, which is acceptable for statistics.
+*/
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+	void record(double ms);
+	void reset();
+	void getStats(LatencyStats& stats) const;
+
+private:
+	static int getBucket(uint64_t us);
+	static double getBucketValue(int bucket); // middle of the bucket in us
+
+	std::atomic<uint64_t> m_buckets[NUM_HISTOGRAM_BUCKETS];
+	std::atomic<uint64_t> m_sumUs;
+	std::atomic<uint64_t> m_minUs;
+	std::atomic<uint64_t> m_maxUs;
+};
+
+// monotonic counter that can be read and reset from any thread
+class StatCounter
+{
+public:
+	StatCounter() : m_value(0) {}
+	void add(int64_t value = 1) { m_value.fetch_add(value, std::memory_order_relaxed); }
+	int64_t get() const { return m_value.load(std::memory_order_relaxed); }
+	void reset() { m_value.store(0, std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t> m_value;
+};
+
+#endif
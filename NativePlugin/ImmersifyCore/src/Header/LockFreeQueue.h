@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef __lockFreeQueue_H__
+#define __lockFreeQueue_H__
+
+#include <atomic>
+#include <cstddef>
+
+/*
+Bounded multi producer, multi consumer queue without locks (every cell carries a sequence number that tells whether it
+can be written or read in the current round). push() fails instead of blocking if the queue is full. Capacity has to
+be a power of two.
+*/
+template<typename T, size_t Capacity>
+class LockFreeQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "the capacity has to be a power of two");
+
+public:
+	LockFreeQueue() : m_head(0), m_tail(0)
+	{
+		for (size_t i = 0; i < Capacity; i++)
+		{
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	bool push(const T& value)
+	{
+		size_t pos = m_tail.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = m_cells[pos & (Capacity - 1)];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			std::ptrdiff_t diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)pos;
+			if (diff == 0)
+			{
+				if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.value = value;
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false; //full
+			}
+			else
+			{
+				pos = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool pop(T& value)
+	{
+		size_t pos = m_head.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = m_cells[pos & (Capacity - 1)];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			std::ptrdiff_t diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)(pos + 1);
+			if (diff == 0)
+			{
+				if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					value = cell.value;
+					cell.sequence.store(pos + Capacity, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false; //empty
+			}
+			else
+			{
+				pos = m_head.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	Cell m_cells[Capacity];
+	alignas(64) std::atomic<size_t> m_head;
+	alignas(64) std::atomic<size_t> m_tail;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#pragma once
+
+#ifndef __logger_H__
+#define __logger_H__
+
+#include <windows.h>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include "Console.h"
+#include "LockFreeQueue.h"
+
+enum LOG_LEVEL {
+	LOG_LEVEL_ERROR = 0,
+	LOG_LEVEL_WARNING = 1,
+	LOG_LEVEL_INFO = 2,
+	LOG_LEVEL_DEBUG = 3
+};
+
+enum LOG_SINK {
+	LOG_SINK_STDOUT = 1,
+	LOG_SINK_UNITY = 2,	// the callback registered with setUnityCallback
+	LOG_SINK_FILE = 4
+};
+
+const int LOG_MESSAGE_LENGTH = 240;
+
+struct LogEntry
+{
+	int level;
+	unsigned int suppressed; // messages of the same call site that were dropped by the rate limit before this one
+	double timeMS;
+	char message[LOG_MESSAGE_LENGTH];
+};
+
+// rate limit of one call site of the LOG_ macros
+struct LogSite
+{
+	std::atomic<double> windowStartMS;
+	std::atomic<unsigned int> count;		// messages in the current second
+	std::atomic<unsigned int> suppressed;
+	LogSite() : windowStartMS(-1e30), count(0), suppressed(0) {}
+};
+
+/*
+Leveled logger for the decoder and render threads. A message is formatted into a fixed size entry and pushed into a
+lock-free ring, a background thread writes the entries to the sinks, so that slow consoles or log files never block
+the calling thread. Every call site logs at most getMaxMessagesPerSecond() messages per second, the suppressed
+messages are counted and reported with the next message of the site.
+A disabled level costs only an atomic load, the message is not even formatted (see the LOG_ macros).
+*/
+class Logger
+{
+public:
+	static bool isEnabled(int level) { return level <= s_level.load(std::memory_order_relaxed); }
+	static void setLevel(int level) { s_level = level; } // -1 disables all messages
+	static void setSinks(int sinks) { s_sinks = sinks; }
+	static void setUnityCallback(FuncCallBack callback) { s_unityCallback = callback; }
+	static bool setLogFile(const char* path); // NULL closes the file
+	static void setMaxMessagesPerSecond(unsigned int maxMessages) { s_maxMessagesPerSecond = maxMessages; }
+	static unsigned int getMaxMessagesPerSecond() { return s_maxMessagesPerSecond; }
+	static int64_t getNumLostMessages() { return s_numLostMessages; }
+
+	static void write(int level, LogSite& site, const std::string& message);
+	// SD_ExtLogFunc, routes the messages of the SPIN libraries into the logger
+	static void spinLogFunc(void* handle, int verbosity, const char* message);
+	static void shutdown(); // writes the remaining messages and stops the background thread
+
+private:
+	static void start();
+	static DWORD WINAPI run(void* param);
+	static void drain();
+
+	static std::atomic<int> s_level;
+	static std::atomic<int> s_sinks;
+	static std::atomic<FuncCallBack> s_unityCallback;
+	static std::atomic<unsigned int> s_maxMessagesPerSecond;
+	static std::atomic<int64_t> s_numLostMessages;
+	static std::atomic<bool> s_started;
+	static std::atomic<bool> s_run;
+	static HANDLE s_thread;
+	static std::mutex s_fileMutex;
+	static std::ofstream s_file;
+	static LockFreeQueue<LogEntry, 1024> s_queue;
+};
+
+#define LOG_MESSAGE(level, message) \
+	do { \
+		if (Logger::isEnabled(level)) { \
+			static LogSite logSite; \
+			std::stringstream logStream; \
+			logStream << message; \
+			Logger::write(level, logSite, logStream.str()); \
+		} \
+	} while (0)
+
+#define LOG_ERROR(message) LOG_MESSAGE(LOG_LEVEL_ERROR, message)
+#define LOG_WARNING(message) LOG_MESSAGE(LOG_LEVEL_WARNING, message)
+#define LOG_INFO(message) LOG_MESSAGE(LOG_LEVEL_INFO, message)
+#define LOG_DEBUG(message) LOG_MESSAGE(LOG_LEVEL_DEBUG, message)
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#ifndef __playbackSnapshot_H__
+#define __playbackSnapshot_H__
+
+#include <stdint.h>
+
+const int PLAYBACK_SNAPSHOT_VERSION = 8;
+const int PLAYBACK_CADENCE_DESCRIPTION_SIZE = 128;
+
+/*
+Everything the managed side needs per frame about one player, filled with a single call. The layout only grows at the
+end, version and size tell the caller which fields are valid. Only fixed size types, so that it can be mirrored with
+a sequential struct in C#.
+*/
+struct PlaybackSnapshot
+{
+	int32_t version;			// PLAYBACK_SNAPSHOT_VERSION
+	int32_t size;				// sizeof(PlaybackSnapshot)
+	int32_t state;				// PLAYER_STATE
+	int32_t isReady;
+	int32_t isFinished;
+	int32_t errorCode;
+	int32_t currentFrame;		// number of the frame on the texture
+	int32_t queueSize;			// decoded frames waiting for the upload
+	int64_t ptsMS;				// presentation time of the current frame
+	int64_t numPresentedFrames;
+	int64_t numDroppedFrames;	// frames that could not be uploaded
+	int64_t numLateFrames;		// frames presented more than one frame duration after they were due
+	double playingTimeMS;
+	double targetFPS;
+	double lastUploadTimeMS;	// render thread time of the last upload
+	double lastDecodingTimeMS;	// of the current frame
+	double lastFrameIntervalMS;	// time between the last two presented frames
+	double lastGpuUploadTimeMS;	// GPU time of the latest measured texture upload, -1 if unknown (version 2)
+	double driftMS;				// the current frame became visible this much after its target time, negative if early (version 3)
+	double renderIntervalMS;	// estimated vsync interval of the render thread (version 3)
+	int64_t numSkippedFrames;	// late frames that were skipped to catch up (version 3)
+	double displayRefreshHz;	// set by the host, 0 if unknown (version 4)
+	int64_t numCadenceBreaks;	// frames shown for more or less vsyncs than the cadence asks for (version 4)
+	double playbackSpeed;		// (version 5)
+	int32_t discardMode;		// SE_FrameDiscardMode the decoder runs with, -1 if it decodes all frames (version 5)
+	int32_t reserved;
+	int32_t isScrubbing;		// (version 6)
+	int32_t reserved2;
+	int64_t numScrubCacheHits;	// scrub positions whose key frame was cached (version 6)
+	int64_t numScrubCacheMisses;	// scrub positions whose key frame had to be decoded (version 6)
+	int64_t numStridedFrames;	// frames that could not take the contiguous upload path (version 7)
+	char cadenceDescription[PLAYBACK_CADENCE_DESCRIPTION_SIZE];	// zero terminated, e.g. "3:2 (23.976 fps at 59.94 Hz)" (version 8)
+};
+
+#endif
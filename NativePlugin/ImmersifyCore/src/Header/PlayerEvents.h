@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef __playerEvents_H__
+#define __playerEvents_H__
+
+#include <stdint.h>
+#include <atomic>
+#include "LockFreeQueue.h"
+
+enum PLAYER_EVENT {
+	PLAYER_EVENT_FIRST_FRAME = 0,	// the first frame after Play is on the texture
+	PLAYER_EVENT_SEEK_COMPLETE = 1,	// the first frame after a seek is decoded, value is its frame number
+	PLAYER_EVENT_LOOP = 2,			// the decoder wrapped around to the start of the video
+	PLAYER_EVENT_UNDERRUN = 3,		// a frame was due but the decoder had none ready
+	PLAYER_EVENT_END_OF_STREAM = 4,	// the last frame was presented
+	PLAYER_EVENT_ERROR = 5,			// value is the error code, see GetCurrentErrorCode
+	PLAYER_EVENT_STALL = 6,			// the watchdog detected a stall, value is the WATCHDOG_STAGE
+	PLAYER_EVENT_CADENCE_BREAK = 7	// a frame was not shown for the vsyncs of the cadence, value is its frame number
+};
+
+struct PlayerEvent
+{
+	intptr_t sequencer;
+	int32_t type;	// PLAYER_EVENT
+	int32_t value;
+	double timeMS;	// SpinLib_GetRealTime when the event happened
+};
+
+typedef void(*PlayerEventCallback)(const PlayerEvent* event);
+
+/*
+Process wide queue of the events of all players. The events are posted by the render and decoder threads without
+locking and are drained by the managed side once per frame, either with poll() or with dispatch(), which calls the
+registered callback on the calling thread.
+*/
+class PlayerEvents
+{
+public:
+	static void post(const void* sequencer, PLAYER_EVENT type, int value = 0);
+	static int poll(PlayerEvent* events, int maxEvents);
+	static int dispatch();
+	static void registerCallback(PlayerEventCallback callback) { s_callback = callback; }
+	static int64_t getNumLostEvents() { return s_numLostEvents; }
+
+private:
+	static LockFreeQueue<PlayerEvent, 1024> s_queue;
+	static std::atomic<PlayerEventCallback> s_callback;
+	static std::atomic<int64_t> s_numLostEvents; // posted while the queue was full
+};
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+
+#ifndef __playerStats_H__
+#define __playerStats_H__
+
+#include <stdint.h>
+
+const int PLAYER_STATS_VERSION = 6;
+
+// summary of one LatencyHistogram, all zero if nothing was recorded
+struct LatencyStats
+{
+	int64_t count;
+	double minMS;
+	double meanMS;
+	double p50MS;
+	double p90MS;
+	double p99MS;
+	double p999MS;
+	double maxMS;
+};
+
+/*
+Counters and latency distributions of one player since it was created or since the last reset. Like the
+PlaybackSnapshot the layout only grows at the end and only has fixed size types.
+*/
+struct PlayerStats
+{
+	int32_t version;			// PLAYER_STATS_VERSION
+	int32_t size;				// sizeof(PlayerStats)
+	int64_t numDecodedFrames;
+	int64_t numPresentedFrames;
+	int64_t numDroppedFrames;	// frames that could not be uploaded
+	int64_t numLateFrames;		// frames presented more than one frame duration after they were due
+	int64_t numUnderruns;		// times the queue ran empty while playing
+	int64_t bytesRead;			// compressed bytes of the video stream
+	int64_t bytesCopied;		// decoded bytes handed to the texture upload
+	LatencyStats decodeTime;	// per access unit
+	LatencyStats timeInQueue;	// from the decoder output until the sequencer takes the picture
+	LatencyStats uploadTime;
+	LatencyStats presentInterval;
+	LatencyStats readTime;		// av_read_frame per packet (version 2)
+	int64_t numSkippedFrames;	// late frames that were skipped to catch up (version 3)
+	int64_t numResyncs;			// times a frame was too far off its target time and restarted the timeline (version 3)
+	LatencyStats drift;			// distance of the vsync a frame became visible at from its target time (version 3)
+	LatencyStats judder;		// deviation of the present interval from the pts interval of two frames (version 3)
+	int64_t numCadenceBreaks;	// frames shown for more or less vsyncs than the cadence asks for (version 4)
+	int64_t numStridedFrames;	// frames that could not take the contiguous upload path (version 5)
+	int64_t numDecoderReopens;	// times the decoder was closed and opened again for a new discard or scrub mode, each one a hitch (version 6)
+};
+
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+#ifndef __scrubCache_H__
+#define __scrubCache_H__
+
+#include <spindec.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <map>
+#include "LatencyHistogram.h"
+
+const int MAX_SCRUB_DOWNSCALE = 2;				// iLog2DownScale of SpinDecLib, 1/4 of the width and height
+const size_t SCRUB_CACHE_BYTES = 256 << 20;		// for the key frames of one player
+const int MIN_SCRUB_CACHE_PICTURES = 4;
+
+// a key frame decoded at the resolution of the scrub mode
+struct ScrubPicture {
+	SpinDec_Picture pic;
+	int64_t key;		// timestamp of the key frame in the index of the stream
+	int64_t pts;
+	double ptsMS;
+	int frameNumber;
+};
+
+/*
+LRU cache of the key frames decoded while scrubbing, keyed by their timestamp in the index of the stream, so that a
+position that was visited before is shown again without seeking and decoding. The pictures are the external pictures
+SpinDecLib decodes into, so a key frame is cached without a copy. The number of pictures follows from
+SCRUB_CACHE_BYTES, e.g. about 10 at full and 160 at a quarter of the resolution of an 8K 4:2:0 video.
+Only used by the decoder thread, the counters can be read from any thread.
+*/
+class ScrubCache
+{
+public:
+	ScrubCache();
+	~ScrubCache();
+	// the layout of the pictures (BC4 planes without margins), pictures of another layout are freed
+	void configure(const Spin_Picture& desc);
+	void clear();
+	// the cached key frame, which becomes the most recently used one. NULL if it is not cached.
+	ScrubPicture* find(int64_t key);
+	// a picture to decode into: an unused, a new or the least recently used one. NULL if all are held by the decoder.
+	SpinDec_Picture* acquire();
+	// the decoder returned a picture it got from acquire(), it is cached as the most recently used one
+	ScrubPicture* insert(const SpinDec_Picture* pic, int64_t key);
+	// the decoder dropped the pictures it held, e.g. after a seek
+	void releaseAcquired();
+	int getNumCached() const { return (int)m_cached.size(); }
+	int64_t getNumHits() const { return m_hits.get(); }
+	int64_t getNumMisses() const { return m_misses.get(); }
+
+private:
+	ScrubPicture* allocate();
+	void release(ScrubPicture* picture);
+
+	Spin_Picture m_desc;
+	bool m_configured;
+	int m_capacity;					// 0 until the size of a picture is known
+	int m_numPictures;
+	std::list<ScrubPicture*> m_cached;	// most recently used first
+	std::list<ScrubPicture*> m_unused;
+	std::map<const void*, ScrubPicture*> m_acquired;	// by the planes, held by the decoder
+	StatCounter m_hits;
+	StatCounter m_misses;
+};
+
+// scales a BC4 picture decoded with iLog2DownScale up to the size of dst, every block of dst is a part of a block of
+// src with the same endpoints and repeated indices (nearest neighbour), so no block is decoded or encoded again
+void upscaleBC4Picture(const Spin_Picture* src, int log2Scale, Spin_Picture* dst);
+
+#endif
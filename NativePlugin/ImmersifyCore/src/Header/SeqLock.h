@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef __seqLock_H__
+#define __seqLock_H__
+
+#include <atomic>
+#include <string.h>
+
+/*
+Single writer, many readers. The writer never waits, a reader retries while a write is in progress, so the reader
+always gets a consistent copy. T has to be a POD type.
+*/
+template<typename T>
+class SeqLock
+{
+public:
+	SeqLock() : m_sequence(0) { memset(&m_data, 0, sizeof(T)); }
+
+	void write(const T& data)
+	{
+		unsigned int sequence = m_sequence.load(std::memory_order_relaxed);
+		m_sequence.store(sequence + 1, std::memory_order_relaxed); //odd while writing
+		std::atomic_thread_fence(std::memory_order_release);
+		memcpy(&m_data, &data, sizeof(T));
+		m_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	void read(T& data) const
+	{
+		for (;;)
+		{
+			unsigned int before = m_sequence.load(std::memory_order_acquire);
+			if (before & 1)
+				continue;
+			memcpy(&data, &m_data, sizeof(T));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (m_sequence.load(std::memory_order_relaxed) == before)
+				return;
+		}
+	}
+
+private:
+	std::atomic<unsigned int> m_sequence;
+	T m_data;
+};
+
+#endif
@@ -11,6 +11,23 @@
 #include <Utils.h>
 #include "Timer.h"
 #include "BaseTextureAccess.h"
+#include "PlaybackSnapshot.h"
+#include "SeqLock.h"
+#include "FrameTelemetry.h"
+#include "BottleneckClassifier.h"
+#include "Watchdog.h"
+#include "FrameScheduler.h"
+
+const double MIN_PLAYBACK_SPEED = 0.1;
+const double MAX_PLAYBACK_SPEED = 8.0;
+// above these speeds the decoder discards frames before decoding them instead of decoding frames that are skipped
+const double DISCARD_NON_REF_SPEED = 1.5;	// non reference frames, about every second frame
+const double DISCARD_TEMPORAL_SPEED = 3.0;	// all frames above temporal layer 0, e.g. 7 of 8 with a GOP of 8
+// every change of the discard mode reopens the decoder, so a mode is only left below these speeds and only applied
+// after the speed stayed in its band for DISCARD_MODE_SETTLE_MS, e.g. while a speed slider is moved
+const double KEEP_NON_REF_SPEED = 1.3;
+const double KEEP_TEMPORAL_SPEED = 2.6;
+const double DISCARD_MODE_SETTLE_MS = 250.0;
 
 enum PLAYER_STATE {
 	PLAYING,
@@ -18,6 +35,15 @@ enum PLAYER_STATE {
 	STOPPED
 };
 
+// changes of the schedule requested by the exports on the main thread, applied by update() on the render thread
+enum SCHEDULE_REQUEST {
+	SCHEDULE_REQUEST_RESTART = 1,			// the next frame starts a new timeline
+	SCHEDULE_REQUEST_FRAME_DURATION = 2,	// to m_requestedFrameDuration
+	SCHEDULE_REQUEST_PLAYING_TIME = 4,		// towards m_requestedPlayingTimeOffset
+	SCHEDULE_REQUEST_CADENCE = 8,			// for the video and m_displayRefreshHz
+	SCHEDULE_REQUEST_SPEED = 16				// m_playbackSpeed
+};
+
 class  Sequencer
 {
 	
@@ -40,7 +66,7 @@ public:
 	double getTargetFPS();
 	bool getSeekingIsSupported();
 	bool isReady();
-	double getCurrentPlayingTime();
+	double getCurrentPlayingTime(); // presentation time of the frame on the texture in ms
 	int getMaxQueueSize() const;
 	VideoInformation loadMP4(const char* src_filename);
 	PLAYER_STATE getPlayerState() { return m_state; }
@@ -48,6 +74,30 @@ public:
 	const VideoInformation& getVideoInformation();
 	int getCurrentErrorCode();
 	void seekToMSec(int64_t seekForMSeconds);
+	int getNumStridedFrames() const { return (int)m_stridedCounter.get(); }
+	double getTimeUntilNextFrame(); // in ms, negative if the next frame is overdue
+	// consistent state of the player as of the last update(), can be called from any thread
+	void getSnapshot(PlaybackSnapshot& snapshot) const;
+	// counters and latency histograms of the sequencer and its decoder, both can be called from any thread
+	void getStats(PlayerStats& stats) const;
+	void resetStats();
+	// classification of the stage that limits the frame rate, updated every BOTTLENECK_WINDOW_MS while playing. Can
+	// be called from any thread.
+	void getBottleneck(BottleneckReport& report) const;
+	// called by the watchdog thread, returns true and requests the recovery if a stage stalls for longer than
+	// thresholdMs for the first time
+	bool checkStall(double nowMs, double thresholdMs, StallReport& report);
+	// refresh rate of the display the texture is shown on, enables the pulldown cadence. 0 if unknown.
+	void setDisplayRefreshRate(double refreshRateHz);
+	void getCadenceDescription(char* buffer, int bufferSize) const; // as of the last update(), from any thread
+	// MIN_PLAYBACK_SPEED to MAX_PLAYBACK_SPEED times the frame rate, on top of the target frame rate
+	void setPlaybackSpeed(double speed);
+	double getPlaybackSpeed() const { return m_playbackSpeed; }
+	// while scrubbing seekToMSec() shows the key frame at or before the position as soon as it is decoded, at
+	// 1 / 2^log2DownScale (0 to MAX_SCRUB_DOWNSCALE) of the resolution, also while paused. Stopping it shows the exact
+	// frame of the last position.
+	void setScrubMode(bool scrubbing, int log2DownScale);
+	bool isScrubbing() const { return m_scrubbing; }
 	
 private:
 	Decoder *m_decoder = nullptr;
@@ -56,7 +106,6 @@ private:
 	PLAYER_STATE m_state;
 	bool m_pauseAfterFirstFrame;
 	bool m_writeLogs;
-	bool m_logFileOpened;
 	float m_frameRate;
 	float m_targetPlayingTime;
 	bool m_isReady;
@@ -66,13 +115,63 @@ private:
 	double m_frameDuration;
 	double m_currentFrameDuration;
 	double m_elapsedPlayingTime;
+	int m_currentFrameNumber;
+	double m_currentPtsMS;			// presentation time of the frame on the texture
+	double m_currentPresentTime;	// playback time when it was applied
+	FrameScheduler m_scheduler;		// used by the render thread only
+	std::atomic<int> m_scheduleRequests;	// SCHEDULE_REQUEST flags, taken by update()
+	std::atomic<double> m_requestedFrameDuration;
+	std::atomic<double> m_requestedPlayingTimeOffset;	// target playing time minus the playback time it was set at
+	void applyScheduleRequests();
+	Cadence m_cadence;				// used by the render thread only
+	char m_cadenceDescription[PLAYBACK_CADENCE_DESCRIPTION_SIZE];	// of m_cadence, published through the snapshot
+	std::atomic<double> m_displayRefreshHz;
+	std::atomic<double> m_playbackSpeed;
+	bool m_inCadenceBreak;			// the last presented frame broke the cadence
+	std::atomic<bool> m_scrubbing;
+	std::atomic<bool> m_resolvingScrub;	// the scrubbing stopped, but the exact frame is not shown yet
+	double getPlaybackRate() const;
+	void updateCadence();
+	SE_FrameDiscardMode m_discardMode;			// requested from the decoder
+	SE_FrameDiscardMode m_pendingDiscardMode;	// for the current speed, applied when it settled
+	double m_pendingDiscardSince;				// -1 if the discard mode fits the speed
+	void updateDiscardMode();
+	int64_t m_numPresentedFrames;
+	int64_t m_numDroppedFrames;
+	int64_t m_numLateFrames;
+	double m_lastUploadTimeMs;
+	double m_lastDecodingTimeMs;
+	double m_lastFrameIntervalMs;
+	int m_lastErrorCode;
+	bool m_underrun;			// an underrun event was posted, reset with the next frame
+	bool m_endOfStreamPosted;
+	SeqLock<PlaybackSnapshot> m_snapshot; // written by the render thread only
 	VideoInformation m_videoInformation;
 	CHROMA_SUBSAMPLING m_chroma_subsampling;
-	std::ofstream ofs;
+	FrameTelemetry* m_telemetry; // per frame records if m_writeLogs is set
+	StatCounter m_presentedCounter;	// like the members above, but resettable from any thread
+	StatCounter m_droppedCounter;
+	StatCounter m_lateCounter;
+	StatCounter m_underrunCounter;
+	StatCounter m_bytesCopied;
+	StatCounter m_stridedCounter;	// frames that could not take the contiguous upload path
+	LatencyHistogram m_uploadTimeHistogram;
+	LatencyHistogram m_presentIntervalHistogram;
+	BottleneckClassifier m_classifier;
+	SeqLock<BottleneckReport> m_bottleneck;
+	void updateBottleneck(int queueSize);
+	PlayerHeartbeats m_heartbeats;
+	FrameHistory m_history;			// the latest frame records for the watchdog dumps
+	bool m_stallReported;			// used by the watchdog thread only
+	std::atomic<int> m_recoveryStage; // WATCHDOG_STAGE the render thread has to recover from, -1 if none
+	void recover(WATCHDOG_STAGE stage);
+	bool updateFrame();
+	bool updateScrubFrame();
+	const PictureContainer* selectFrame();
+	void publishSnapshot();
 	void safeDelete(BaseTextureAccess *textureAccess);	
 	void destroy();
-	void writeToLogFile(const string log);
-	void closeLogFile();
+	void recordFrame(const PictureContainer* out, double presentTime, double uploadTimeMs, bool success);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef __sequencerRegistry_H__
+#define __sequencerRegistry_H__
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include "PlaybackSnapshot.h"
+#include "BottleneckClassifier.h"
+
+class Sequencer;
+
+// the published state of one sequencer, see SequencerRegistry::getSnapshots
+struct SequencerSnapshot
+{
+	const Sequencer* sequencer;
+	PlaybackSnapshot playback;
+	BottleneckReport bottleneck;
+};
+
+/*
+All sequencers of the process, so that the render thread can update them with a single render event instead of one
+event per player. Sequencers add and remove themselves on construction and destruction.
+*/
+class SequencerRegistry
+{
+public:
+	static void add(Sequencer* sequencer);
+	static void remove(Sequencer* sequencer);
+	// updates all sequencers, returns the number of sequencers that got a new frame
+	static int updateAll();
+	// duration of the last and the longest updateAll(), do not lock
+	static double getLastUpdateAllTimeMs();
+	static double getMaxUpdateAllTimeMs();
+	// copies the snapshots of all sequencers, only reads their seqlocks. Does not wait for updateAll(), so it answers
+	// also while the render thread hangs.
+	static void getSnapshots(std::vector<SequencerSnapshot>& snapshots);
+	// calls function for every sequencer while holding the registry, false if the registry could not be locked within
+	// timeoutMs (e.g. because the render thread hangs in updateAll)
+	static bool forEach(const std::function<void(Sequencer*)>& function, unsigned int timeoutMs);
+	// how long the current updateAll() is running, -1 if none is running. Does not lock.
+	static double getUpdateAllBusyTime(double nowMs);
+
+private:
+	static std::timed_mutex s_mutex;		// held by updateAll() for the whole batch
+	static std::mutex s_readerMutex;		// held by getSnapshots(), never by the render thread
+	static std::vector<Sequencer*> s_sequencers;	// changed while holding both
+	static std::atomic<double> s_lastUpdateAllTimeMs;	// written at the end of updateAll()
+	static std::atomic<double> s_maxUpdateAllTimeMs;
+	static std::atomic<double> s_updateAllStartMs;
+};
+
+#endif
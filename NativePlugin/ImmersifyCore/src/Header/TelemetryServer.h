@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef __telemetryServer_H__
+#define __telemetryServer_H__
+
+#include <windows.h>
+#include <atomic>
+#include <string>
+
+const int DEFAULT_TELEMETRY_PORT = 9464;
+
+/*
+Optional HTTP endpoint on 127.0.0.1 for monitoring, e.g. through a forwarded port or a local Prometheus agent.
+GET /metrics returns the Prometheus text format, GET /stats the same values as JSON. The background thread only
+copies the published snapshots of the sequencers (see SequencerRegistry::getSnapshots) and formats them afterwards, so
+it never touches the decoder or the textures and holds the registry lock only for the copy.
+*/
+class TelemetryServer
+{
+public:
+	static bool start(int port = DEFAULT_TELEMETRY_PORT); // false if the port cannot be bound
+	static void stop();
+	static bool isRunning() { return s_running; }
+
+	static std::string getPrometheusText();
+	static std::string getJson();
+
+private:
+	static DWORD WINAPI run(void* param);
+	static void handleClient(uintptr_t client);
+
+	static std::atomic<bool> s_running;
+	static uintptr_t s_socket;	// SOCKET, kept opaque so that this header does not need winsock2.h
+	static HANDLE s_thread;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+
+#ifndef __tracer_H__
+#define __tracer_H__
+
+#include <windows.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+const int TRACE_EVENTS_PER_THREAD = 16384;
+
+struct TraceEvent
+{
+	const char* name;	// string literal
+	double startUs;
+	double durationUs;
+	int64_t id;			// e.g. frame number, -1 if not used
+};
+
+// the events of one thread. Only the owning thread writes, so no lock is needed.
+struct ThreadTraceBuffer
+{
+	std::atomic<bool> inUse;	// the thread is still running, otherwise the buffer is reused by the next new thread
+	DWORD threadId;
+	char threadName[32];
+	std::atomic<uint64_t> numWritten;
+	TraceEvent events[TRACE_EVENTS_PER_THREAD];
+};
+
+/*
+Timeline of the demux, decode, upload and present work of all threads and players. Every thread writes complete spans
+into its own ring (the last TRACE_EVENTS_PER_THREAD spans are kept) and dump() writes all of them as Chrome trace
+event JSON, which can be opened in chrome://tracing or Perfetto. While tracing is disabled a TRACE_SCOPE costs only an
+atomic load.
+*/
+class Tracer
+{
+public:
+	static void setEnabled(bool enabled) { s_enabled = enabled; }
+	static bool isEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+	static void setThreadName(const char* name);
+	static void addSpan(const char* name, double startUs, double endUs, int64_t id);
+	static bool dump(const char* path);
+	static double nowUs();
+
+private:
+	static ThreadTraceBuffer* getThreadBuffer();
+
+	static std::atomic<bool> s_enabled;
+	static std::mutex s_buffersMutex; // only taken when a thread writes its first span and by dump()
+	static std::vector<ThreadTraceBuffer*> s_buffers;
+};
+
+// records the lifetime of the scope as one span of the calling thread
+class TraceScope
+{
+public:
+	TraceScope(const char* name, int64_t id = -1) : m_name(name), m_id(id), m_startUs(Tracer::isEnabled() ? Tracer::nowUs() : -1) {}
+	~TraceScope()
+	{
+		if (m_startUs >= 0)
+		{
+			Tracer::addSpan(m_name, m_startUs, Tracer::nowUs(), m_id);
+		}
+	}
+
+private:
+	const char* m_name;
+	int64_t m_id;
+	double m_startUs;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_SCOPE_ID(name, id) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, (int64_t)(id))
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef __uploadWorkerPool_H__
+#define __uploadWorkerPool_H__
+
+#include <windows.h>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// a rectangular region of rows that has to be copied from the decoded picture into the upload buffer
+struct CopyRange
+{
+	unsigned char* dst;
+	const unsigned char* src;
+	unsigned int rows;
+	unsigned int rowBytes;
+	unsigned int srcStride; // in bytes, equal to rowBytes for non strided pictures
+	unsigned int dstStride; // in bytes, equal to rowBytes unless the plane is a part of a bigger (packed) texture
+};
+
+// all plane copies of a single frame. The pool splits the planes into row slices when the job is submitted.
+class UploadJob
+{
+public:
+	UploadJob() : m_nextSlice(0), m_remaining(0) {}
+	void clear() { m_planes.clear(); m_slices.clear(); }
+	void addPlane(unsigned char* dst, const unsigned char* src, unsigned int rows, unsigned int rowBytes, unsigned int srcStride);
+	// adds a range that is already split (see UploadWorkerPool::getRowsPerSlice), it is not split again
+	void addSlice(unsigned char* dst, const unsigned char* src, unsigned int rows, unsigned int rowBytes, unsigned int srcStride, unsigned int dstStride);
+	size_t getNumSlices() const { return m_slices.size(); }
+
+private:
+	friend class UploadWorkerPool;
+	std::vector<CopyRange> m_planes;
+	std::vector<CopyRange> m_slices;
+	size_t m_nextSlice;		// next slice to be picked up by a worker (guarded by the pool mutex)
+	size_t m_remaining;		// slices not copied yet (guarded by the pool mutex)
+};
+
+/*
+Process wide pool of upload workers that is shared by all texture access instances. The workers are parked on a
+condition variable while there is nothing to copy. The pool is reference counted: the first acquire() starts the
+workers and the last release() stops them again.
+*/
+class UploadWorkerPool
+{
+public:
+	static UploadWorkerPool* acquire();
+	static void release();
+
+	void submit(UploadJob* job);
+	bool wait(UploadJob* job, unsigned int timeoutMs = INFINITE);
+	bool isDone(UploadJob* job);
+	unsigned int getNumWorkers() const { return (unsigned int)m_threads.size(); }
+	// rows per slice for a plane of a frame with frameBytes bytes in total
+	unsigned int getRowsPerSlice(size_t frameBytes, unsigned int rows, unsigned int rowBytes) const;
+
+	// called by the worker threads only
+	bool runNextSlice();
+
+private:
+	UploadWorkerPool(unsigned int numWorkers);
+	~UploadWorkerPool();
+	void splitIntoSlices(UploadJob* job) const;
+
+	std::vector<HANDLE> m_threads;
+	std::deque<UploadJob*> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_workCv;
+	std::condition_variable m_doneCv;
+	bool m_run;
+};
+
+#endif
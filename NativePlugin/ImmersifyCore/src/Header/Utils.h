@@ -9,6 +9,7 @@
 
 #include <gl/glew.h>
 #include <Console.h>
+#include "Logger.h"
 
 
 using namespace std;
@@ -25,7 +26,7 @@ inline void printGlError()
 	GLenum err = glGetError();
 	if (GLEW_OK != err)
 	{
-		cout << "GL ERROR:" << err << " => " << gluErrorString(err) << endl;
+		LOG_ERROR("GL ERROR:" << err << " => " << gluErrorString(err));
 	}
 }
 
@@ -0,0 +1,120 @@
+#pragma once
+
+#ifndef __watchdog_H__
+#define __watchdog_H__
+
+#include <windows.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "PlaybackSnapshot.h"
+#include "FrameTelemetry.h"
+
+class Sequencer;
+
+// the stages of a player in pipeline order, a stall is reported for the first stalled stage
+enum WATCHDOG_STAGE {
+	WATCHDOG_STAGE_DEMUX = 0,	// av_read_frame
+	WATCHDOG_STAGE_DECODE = 1,	// SpinDecLib_DecodeAU
+	WATCHDOG_STAGE_UPLOAD = 2,	// the copies of a staged frame are not done
+	WATCHDOG_STAGE_PRESENT = 3,	// no frame was presented while playing
+	NUM_WATCHDOG_STAGES = 4
+};
+
+// what the render thread does with a stalled player after the dump
+enum WATCHDOG_RECOVERY {
+	WATCHDOG_RECOVERY_NONE = 0,
+	WATCHDOG_RECOVERY_FLUSH = 1,	// drop the staged frames of the texture access
+	WATCHDOG_RECOVERY_RESEEK = 2,	// seek to the current position
+	WATCHDOG_RECOVERY_REOPEN = 3	// replace the decoder with a new one at the current position
+};
+
+const unsigned int DEFAULT_WATCHDOG_THRESHOLD_MS = 3000;
+const double DEFAULT_WATCHDOG_HISTORY_MS = 10000; // of frame records in the dump
+
+/*
+When each stage of one player became busy, written by the decoder, upload and render threads with a single atomic
+store and read by the watchdog thread. A stage is stalled if it is busy for longer than the threshold.
+*/
+class PlayerHeartbeats
+{
+public:
+	PlayerHeartbeats();
+	void enter(WATCHDOG_STAGE stage);
+	void leave(WATCHDOG_STAGE stage);
+	void setUpdateTime(double nowMs) { m_lastUpdateMs.store(nowMs, std::memory_order_relaxed); }
+	double getBusyTime(WATCHDOG_STAGE stage, double nowMs) const; // -1 if the stage is idle
+	int64_t getNumBeats(WATCHDOG_STAGE stage) const { return m_beats[stage].load(std::memory_order_relaxed); }
+	double getTimeSinceUpdate(double nowMs) const;
+
+private:
+	std::atomic<double> m_busySinceMs[NUM_WATCHDOG_STAGES]; // -1 while idle
+	std::atomic<int64_t> m_beats[NUM_WATCHDOG_STAGES];
+	std::atomic<double> m_lastUpdateMs;
+};
+
+// marks a stage busy for the lifetime of the scope, nothing happens if heartbeats is NULL
+class HeartbeatScope
+{
+public:
+	HeartbeatScope(PlayerHeartbeats* heartbeats, WATCHDOG_STAGE stage) : m_heartbeats(heartbeats), m_stage(stage)
+	{
+		if (m_heartbeats)
+			m_heartbeats->enter(m_stage);
+	}
+	~HeartbeatScope()
+	{
+		if (m_heartbeats)
+			m_heartbeats->leave(m_stage);
+	}
+
+private:
+	PlayerHeartbeats* m_heartbeats;
+	WATCHDOG_STAGE m_stage;
+};
+
+// everything the watchdog writes about one stalled player, collected by Sequencer::checkStall
+struct StallReport
+{
+	const Sequencer* sequencer;
+	WATCHDOG_STAGE stage;
+	double stalledMs;
+	double busyMs[NUM_WATCHDOG_STAGES];		// -1 for idle stages
+	int64_t numBeats[NUM_WATCHDOG_STAGES];	// how often each stage was entered
+	double timeSinceUpdateMs;
+	PlaybackSnapshot snapshot;
+	std::vector<FrameRecord> frames;
+};
+
+/*
+One background thread for all players. Every few hundred milliseconds it checks the heartbeats of all sequencers.
+For a new stall it writes a JSON dump with the state of all stages, the playback snapshot and the frame records of the
+last seconds (and the Chrome trace if tracing is enabled), posts PLAYER_EVENT_STALL and asks the render thread to
+recover the player. A player is reported again only after all its stages were healthy in between.
+*/
+class Watchdog
+{
+public:
+	// dumpDirectory NULL or empty for the working directory
+	static void start(unsigned int thresholdMs, WATCHDOG_RECOVERY recovery, const char* dumpDirectory);
+	static void stop();
+	static bool isRunning() { return s_run; }
+	static WATCHDOG_RECOVERY getRecovery() { return (WATCHDOG_RECOVERY)s_recovery.load(); }
+	static const char* getStageName(WATCHDOG_STAGE stage);
+	static const char* getRecoveryName(WATCHDOG_RECOVERY recovery);
+
+private:
+	static DWORD WINAPI run(void* param);
+	static void check();
+	static void writeDump(const StallReport& report);
+	static std::string getDumpPath(const char* name);
+
+	static std::atomic<bool> s_run;
+	static std::atomic<unsigned int> s_thresholdMs;
+	static std::atomic<int> s_recovery;
+	static std::string s_dumpDirectory;	// only changed while the thread is stopped
+	static HANDLE s_thread;
+};
+
+#endif
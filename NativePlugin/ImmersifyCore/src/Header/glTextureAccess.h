@@ -8,13 +8,13 @@
 #include <Utils.h>
 #include <windows.h>
 #include "BaseTextureAccess.h"
+#include "UploadWorkerPool.h"
+#include "GlPictureMemory.h"
+#include "GlUploadPlan.h"
 
 const int NUMBER_PBO = 2;
-struct YPARAMETERS
-{
-	const Spin_Picture* pic;
-	GLubyte* ptr;
-};
+const int NUMBER_PERSISTENT_PBO_SLOTS = 3; //ring depth when using a persistently mapped PBO
+const int NUMBER_GPU_TIMER_QUERIES = 4; //uploads that can be measured at the same time
 
 class GlTextureAccess : public BaseTextureAccess
 {
@@ -22,33 +22,70 @@ public:
 	GlTextureAccess(uintptr_t texturePtr[], unsigned int width, unsigned int height, CHROMA_SUBSAMPLING chroma_subsampling);
 	~GlTextureAccess() override;
 
-	void clearBuffer();
+	virtual void clearBuffer() override;
+	virtual void flush() override;
 
 	virtual bool applyPictureData(const Spin_Picture* pic) override;
 	bool getPictureIsStrided() { return m_picIsStrided; }
-	void setMaxWaitForGPUUpload(int ms) { m_maxWaitForGPUUploadSteps = (float)(ms) / 0.1; }
-
-	YPARAMETERS params;
-	HANDLE thandle_1;
-	DWORD threadid_1;
-
-	HANDLE thandle_2;
-	DWORD threadid_2;
-
-	bool m_run = true;
-	bool m_shouldWaitForGpuUpload_1 = false;
-	bool m_shouldWaitForGpuUpload_2 = false;
+	void setMaxWaitForGPUUpload(int ms) { m_maxWaitForGPUUploadMs = ms; }
+	// use one persistently mapped PBO (glBufferStorage) with a fenced ring of slots instead of orphaning and mapping a
+	// PBO every frame. Off by default. Falls back to the orphan-and-map path if the context does not support it. Has to
+	// be set before the first frame is uploaded.
+	void setUsePersistentMapping(bool usePersistentMapping) { m_usePersistentMapping = usePersistentMapping; }
+	bool getUsesPersistentMapping() const { return m_persistentMapping; }
+	// let the decoder write its pictures directly into mapped upload memory, turns on the persistent mapping as well.
+	// Has to be set before the playback starts. Returns false for the packed texture, which cannot be used with zero copy.
+	bool setUseZeroCopy(bool useZeroCopy);
+	virtual ExternalPictureMemory* getExternalPictureMemory() override;
+	// upload all planes into one texture (the first texture pointer) with a single call, see PackedTextureLayout.
+	// Has to be set before the first frame. The packed texture cannot be used with zero copy, returns false then.
+	bool setUsePackedTexture(bool packed);
+	bool getUsesPackedTexture() const { return m_packed; }
+	void getPackedLayout(PackedTextureLayout& layout) const;
+	virtual double getGpuUploadTime() const override { return m_gpuUploadTimeMs; }
 
 private:
 	void apply();
+	bool applyZeroCopy(const Spin_Picture* pic);
+	bool m_framePending; // a frame waits in the current PBO (slot) for apply()
+	bool finishPendingUpload(unsigned int timeoutMs);
 	bool m_pboReady;
+	bool m_uploadPending; // the PBO at m_curPBOIndex is still mapped and the upload workers are copying into it
 	unsigned int m_size;
 	unsigned int m_curPBOIndex;
-	unsigned int m_maxWaitForGPUUploadSteps;
+	unsigned int m_maxWaitForGPUUploadMs;
 	void upladeDataToPBO(const Spin_Picture* pic, GLubyte* ptr);
-	GLuint m_glName[3];
+	GLuint m_glName[MAX_UPLOAD_PLANES];
+	GlUploadPlan* m_uploadPlans[2]; // not strided and strided pictures
+	bool m_packed;
 	GLuint m_pboIds[NUMBER_PBO];
+	bool m_usePersistentMapping;	// requested by the user
+	bool m_persistentMapping;		// actually in use
+	GLuint m_persistentPBO;
+	GLubyte* m_persistentPtr;
+	GLsizeiptr m_slotSize;
+	GLsync m_slotFences[NUMBER_PERSISTENT_PBO_SLOTS];
+	bool enablePersistentPBO();
+	void releasePersistentPBO();
+	bool waitForSlot(unsigned int slot);
+	bool m_useZeroCopy;
+	GlPictureMemory m_pictureMemory;
+	UploadWorkerPool* m_uploadPool;
+	UploadJob m_uploadJob;
 	void enablePBO();
+	/*
+	The GPU time of the texture uploads is measured with a pair of GL_TIMESTAMP queries around them (GL_TIME_ELAPSED
+	queries cannot be nested, so they would collide with queries of the engine). The results are read without waiting
+	once they are available, an upload is not measured if all queries are still in flight.
+	*/
+	bool m_useTimerQueries;
+	GLuint m_timerQueries[NUMBER_GPU_TIMER_QUERIES][2];
+	bool m_timerQueryPending[NUMBER_GPU_TIMER_QUERIES];
+	unsigned int m_nextTimerQuery;
+	double m_gpuUploadTimeMs;
+	bool beginTimerQuery();
+	void endTimerQuery();
+	void readTimerQueries();
 };
 
 #endif
\ No newline at end of file
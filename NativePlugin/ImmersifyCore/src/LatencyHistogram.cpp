@@ -0,0 +1,108 @@
+#include "LatencyHistogram.h"
+#include <cstring>
+
+/***********************************************************************************************/
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+/***********************************************************************************************/
+int LatencyHistogram::getBucket(uint64_t us)
+{
+	if (us < LINEAR_HISTOGRAM_BUCKETS)
+	{
+		return (int)us;
+	}
+	int exponent = 0;
+	while ((us >> exponent) >= 2 * SUB_HISTOGRAM_BUCKETS)
+	{
+		exponent++;
+	}
+	int bucket = LINEAR_HISTOGRAM_BUCKETS + (exponent - 1) * SUB_HISTOGRAM_BUCKETS + (int)((us >> exponent) - SUB_HISTOGRAM_BUCKETS);
+	return bucket < NUM_HISTOGRAM_BUCKETS ? bucket : NUM_HISTOGRAM_BUCKETS - 1;
+}
+
+/***********************************************************************************************/
+double LatencyHistogram::getBucketValue(int bucket)
+{
+	if (bucket < LINEAR_HISTOGRAM_BUCKETS)
+	{
+		return bucket;
+	}
+	int exponent = (bucket - LINEAR_HISTOGRAM_BUCKETS) / SUB_HISTOGRAM_BUCKETS + 1;
+	uint64_t first = (uint64_t)(SUB_HISTOGRAM_BUCKETS + (bucket - LINEAR_HISTOGRAM_BUCKETS) % SUB_HISTOGRAM_BUCKETS) << exponent;
+	return first + ((uint64_t)1 << exponent) / 2.0;
+}
+
+/***********************************************************************************************/
+void LatencyHistogram::record(double ms)
+{
+	uint64_t us = ms > 0 ? (uint64_t)(ms * 1000.0 + 0.5) : 0;
+	m_buckets[getBucket(us)].fetch_add(1, std::memory_order_relaxed);
+	m_sumUs.fetch_add(us, std::memory_order_relaxed);
+
+	uint64_t current = m_minUs.load(std::memory_order_relaxed);
+	while (us < current && !m_minUs.compare_exchange_weak(current, us, std::memory_order_relaxed))
+	{
+	}
+	current = m_maxUs.load(std::memory_order_relaxed);
+	while (us > current && !m_maxUs.compare_exchange_weak(current, us, std::memory_order_relaxed))
+	{
+	}
+}
+
+/***********************************************************************************************/
+void LatencyHistogram::reset()
+{
+	for (int i = 0; i < NUM_HISTOGRAM_BUCKETS; i++)
+	{
+		m_buckets[i].store(0, std::memory_order_relaxed);
+	}
+	m_sumUs.store(0, std::memory_order_relaxed);
+	m_minUs.store(UINT64_MAX, std::memory_order_relaxed);
+	m_maxUs.store(0, std::memory_order_relaxed);
+}
+
+/***********************************************************************************************/
+void LatencyHistogram::getStats(LatencyStats& stats) const
+{
+	memset(&stats, 0, sizeof(LatencyStats));
+	uint64_t counts[NUM_HISTOGRAM_BUCKETS];
+	uint64_t count = 0;
+	for (int i = 0; i < NUM_HISTOGRAM_BUCKETS; i++)
+	{
+		counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+		count += counts[i];
+	}
+	if (count == 0)
+	{
+		return;
+	}
+
+	double minUs = (double)m_minUs.load(std::memory_order_relaxed);
+	double maxUs = (double)m_maxUs.load(std::memory_order_relaxed);
+	if (minUs > maxUs) //reset in between
+	{
+		minUs = maxUs;
+	}
+	const double quantiles[4] = { 0.5, 0.9, 0.99, 0.999 };
+	double* values[4] = { &stats.p50MS, &stats.p90MS, &stats.p99MS, &stats.p999MS };
+	uint64_t seen = 0;
+	int quantile = 0;
+	for (int i = 0; i < NUM_HISTOGRAM_BUCKETS && quantile < 4; i++)
+	{
+		seen += counts[i];
+		while (quantile < 4 && seen > 0 && seen >= (uint64_t)(quantiles[quantile] * count + 0.5))
+		{
+			double value = getBucketValue(i);
+			value = value < minUs ? minUs : (value > maxUs ? maxUs : value);
+			*values[quantile++] = value / 1000.0;
+		}
+	}
+
+	stats.count = (int64_t)count;
+	stats.minMS = minUs / 1000.0;
+	stats.maxMS = maxUs / 1000.0;
+	stats.meanMS = (double)m_sumUs.load(std::memory_order_relaxed) / count / 1000.0;
+}
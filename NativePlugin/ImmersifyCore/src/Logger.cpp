@@ -0,0 +1,152 @@
+#include "Logger.h"
+#include <spincommon.h>
+#include <iostream>
+#include <string.h>
+
+static const char* LEVEL_NAMES[] = { "ERROR", "WARNING", "INFO", "DEBUG" };
+const DWORD LOGGER_DRAIN_INTERVAL_MS = 10;
+
+std::atomic<int> Logger::s_level(LOG_LEVEL_INFO);
+std::atomic<int> Logger::s_sinks(LOG_SINK_STDOUT);
+std::atomic<FuncCallBack> Logger::s_unityCallback(nullptr);
+std::atomic<unsigned int> Logger::s_maxMessagesPerSecond(10);
+std::atomic<int64_t> Logger::s_numLostMessages(0);
+std::atomic<bool> Logger::s_started(false);
+std::atomic<bool> Logger::s_run(false);
+HANDLE Logger::s_thread = NULL;
+std::mutex Logger::s_fileMutex;
+std::ofstream Logger::s_file;
+LockFreeQueue<LogEntry, 1024> Logger::s_queue;
+
+/***********************************************************************************************/
+void Logger::write(int level, LogSite& site, const std::string& message)
+{
+	double now = SpinLib_GetRealTime() * 1000.0;
+	double windowStart = site.windowStartMS.load(std::memory_order_relaxed);
+	if (now - windowStart >= 1000.0 && site.windowStartMS.compare_exchange_strong(windowStart, now))
+	{
+		site.count = 0;
+	}
+	if (++site.count > s_maxMessagesPerSecond)
+	{
+		site.suppressed++;
+		return;
+	}
+
+	LogEntry entry;
+	entry.level = level;
+	entry.suppressed = site.suppressed.exchange(0);
+	entry.timeMS = now;
+	size_t length = message.size() < LOG_MESSAGE_LENGTH - 1 ? message.size() : LOG_MESSAGE_LENGTH - 1;
+	memcpy(entry.message, message.c_str(), length);
+	entry.message[length] = 0;
+	if (!s_queue.push(entry))
+	{
+		s_numLostMessages++;
+		return;
+	}
+	if (!s_started)
+	{
+		start();
+	}
+}
+
+/***********************************************************************************************/
+void Logger::spinLogFunc(void* handle, int verbosity, const char* message)
+{
+	static LogSite spinSite;
+	int level = verbosity < LOG_LEVEL_ERROR ? LOG_LEVEL_ERROR : verbosity < LOG_LEVEL_DEBUG ? verbosity : LOG_LEVEL_DEBUG;
+	if (isEnabled(level))
+	{
+		write(level, spinSite, message);
+	}
+}
+
+/***********************************************************************************************/
+void Logger::start()
+{
+	bool started = false;
+	if (!s_started.compare_exchange_strong(started, true))
+		return;
+	s_run = true;
+	s_thread = CreateThread(NULL, 0, run, NULL, 0, NULL);
+}
+
+/***********************************************************************************************/
+DWORD WINAPI Logger::run(void* param)
+{
+	while (s_run)
+	{
+		drain();
+		Sleep(LOGGER_DRAIN_INTERVAL_MS);
+	}
+	drain();
+	return 0;
+}
+
+/***********************************************************************************************/
+void Logger::drain()
+{
+	LogEntry entry;
+	while (s_queue.pop(entry))
+	{
+		std::stringstream ss;
+		ss << "[" << LEVEL_NAMES[entry.level] << "] " << entry.message;
+		if (entry.suppressed > 0)
+		{
+			ss << " (" << entry.suppressed << " similar messages suppressed)";
+		}
+		const std::string line = ss.str();
+
+		int sinks = s_sinks;
+		if (sinks & LOG_SINK_STDOUT)
+		{
+			std::cout << line << '\n';
+		}
+		FuncCallBack callback = s_unityCallback;
+		if ((sinks & LOG_SINK_UNITY) && callback)
+		{
+			callback(line.c_str(), (int)line.size());
+		}
+		if (sinks & LOG_SINK_FILE)
+		{
+			std::lock_guard<std::mutex> lock(s_fileMutex);
+			if (s_file.is_open())
+			{
+				s_file << (int64_t)entry.timeMS << "\t" << line << '\n';
+			}
+		}
+	}
+	std::cout.flush();
+	std::lock_guard<std::mutex> lock(s_fileMutex);
+	if (s_file.is_open())
+	{
+		s_file.flush();
+	}
+}
+
+/***********************************************************************************************/
+bool Logger::setLogFile(const char* path)
+{
+	std::lock_guard<std::mutex> lock(s_fileMutex);
+	if (s_file.is_open())
+	{
+		s_file.close();
+	}
+	if (!path)
+		return true;
+	s_file.open(path, std::ios_base::out | std::ios_base::app);
+	return s_file.is_open();
+}
+
+/***********************************************************************************************/
+void Logger::shutdown()
+{
+	bool started = true;
+	if (!s_started.compare_exchange_strong(started, false))
+		return;
+	s_run = false;
+	WaitForSingleObject(s_thread, INFINITE);
+	CloseHandle(s_thread);
+	s_thread = NULL;
+}
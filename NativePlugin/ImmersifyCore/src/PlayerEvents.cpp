@@ -0,0 +1,48 @@
+#include "PlayerEvents.h"
+#include <spincommon.h>
+
+LockFreeQueue<PlayerEvent, 1024> PlayerEvents::s_queue;
+std::atomic<PlayerEventCallback> PlayerEvents::s_callback(nullptr);
+std::atomic<int64_t> PlayerEvents::s_numLostEvents(0);
+
+/***********************************************************************************************/
+void PlayerEvents::post(const void* sequencer, PLAYER_EVENT type, int value)
+{
+	PlayerEvent event;
+	event.sequencer = (intptr_t)sequencer;
+	event.type = type;
+	event.value = value;
+	event.timeMS = SpinLib_GetRealTime() * 1000.0;
+	if (!s_queue.push(event))
+	{
+		s_numLostEvents++;
+	}
+}
+
+/***********************************************************************************************/
+int PlayerEvents::poll(PlayerEvent* events, int maxEvents)
+{
+	int numEvents = 0;
+	while (numEvents < maxEvents && s_queue.pop(events[numEvents]))
+	{
+		numEvents++;
+	}
+	return numEvents;
+}
+
+/***********************************************************************************************/
+int PlayerEvents::dispatch()
+{
+	PlayerEventCallback callback = s_callback;
+	int numEvents = 0;
+	PlayerEvent event;
+	while (s_queue.pop(event))
+	{
+		if (callback)
+		{
+			callback(&event);
+		}
+		numEvents++;
+	}
+	return numEvents;
+}
@@ -0,0 +1,41 @@
+#include "Watchdog.h"
+#include <spincommon.h>
+#include <algorithm>
+
+/***********************************************************************************************/
+PlayerHeartbeats::PlayerHeartbeats()
+{
+	for (int i = 0; i < NUM_WATCHDOG_STAGES; i++)
+	{
+		m_busySinceMs[i] = -1;
+		m_beats[i] = 0;
+	}
+	m_lastUpdateMs = -1;
+}
+
+/***********************************************************************************************/
+void PlayerHeartbeats::enter(WATCHDOG_STAGE stage)
+{
+	m_busySinceMs[stage].store(SpinLib_GetRealTime() * 1000.0, std::memory_order_relaxed);
+	m_beats[stage].fetch_add(1, std::memory_order_relaxed);
+}
+
+/***********************************************************************************************/
+void PlayerHeartbeats::leave(WATCHDOG_STAGE stage)
+{
+	m_busySinceMs[stage].store(-1, std::memory_order_relaxed);
+}
+
+/***********************************************************************************************/
+double PlayerHeartbeats::getBusyTime(WATCHDOG_STAGE stage, double nowMs) const
+{
+	double busySince = m_busySinceMs[stage].load(std::memory_order_relaxed);
+	return busySince < 0 ? -1 : (std::max)(nowMs - busySince, 0.0);
+}
+
+/***********************************************************************************************/
+double PlayerHeartbeats::getTimeSinceUpdate(double nowMs) const
+{
+	double lastUpdate = m_lastUpdateMs.load(std::memory_order_relaxed);
+	return lastUpdate < 0 ? -1 : nowMs - lastUpdate;
+}
@@ -0,0 +1,158 @@
+#include "ScrubCache.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+
+/***********************************************************************************************/
+ScrubCache::ScrubCache()
+{
+	memset(&m_desc, 0, sizeof(Spin_Picture));
+	m_configured = false;
+	m_capacity = 0;
+	m_numPictures = 0;
+}
+
+/***********************************************************************************************/
+ScrubCache::~ScrubCache()
+{
+	clear();
+}
+
+/***********************************************************************************************/
+void ScrubCache::configure(const Spin_Picture& desc)
+{
+	bool sameLayout = m_configured && desc.ePixFormat == m_desc.ePixFormat;
+	for (int i = 0; i < 4 && sameLayout; i++)
+	{
+		sameLayout = desc.asPlanes[i].iWidth == m_desc.asPlanes[i].iWidth && desc.asPlanes[i].iHeight == m_desc.asPlanes[i].iHeight;
+	}
+	if (sameLayout)
+		return;
+	clear();
+	m_desc = desc;
+	m_configured = true;
+}
+
+/***********************************************************************************************/
+void ScrubCache::clear()
+{
+	std::list<ScrubPicture*> pictures;
+	pictures.splice(pictures.end(), m_cached);
+	pictures.splice(pictures.end(), m_unused);
+	for (std::map<const void*, ScrubPicture*>::iterator it = m_acquired.begin(); it != m_acquired.end(); it++)
+	{
+		pictures.push_back(it->second);
+	}
+	m_acquired.clear();
+	for (std::list<ScrubPicture*>::iterator it = pictures.begin(); it != pictures.end(); it++)
+	{
+		SpinLib_FreeFrame(&(*it)->pic.sPic);
+		delete *it;
+	}
+	m_numPictures = 0;
+	m_capacity = 0;
+	m_configured = false;
+}
+
+/***********************************************************************************************/
+ScrubPicture* ScrubCache::find(int64_t key)
+{
+	for (std::list<ScrubPicture*>::iterator it = m_cached.begin(); it != m_cached.end(); it++)
+	{
+		if ((*it)->key == key)
+		{
+			m_cached.splice(m_cached.begin(), m_cached, it);
+			m_hits.add();
+			return m_cached.front();
+		}
+	}
+	m_misses.add();
+	return NULL;
+}
+
+/***********************************************************************************************/
+ScrubPicture* ScrubCache::allocate()
+{
+	ScrubPicture* picture = new ScrubPicture();
+	memset(picture, 0, sizeof(ScrubPicture));
+	picture->pic.sPic = m_desc;
+	if (SpinLib_AllocFrame(&picture->pic.sPic))
+	{
+		LOG_ERROR("could not allocate a picture for scrubbing");
+		delete picture;
+		return NULL;
+	}
+	if (m_capacity == 0)
+	{
+		size_t capacity = SCRUB_CACHE_BYTES / (std::max)(picture->pic.sPic.iAllocSize, 1);
+		m_capacity = (int)(std::max)(capacity, (size_t)MIN_SCRUB_CACHE_PICTURES);
+		LOG_INFO("the scrub cache holds " << m_capacity << " key frames of " << picture->pic.sPic.iAllocSize / 1024 << " KB");
+	}
+	m_numPictures++;
+	return picture;
+}
+
+/***********************************************************************************************/
+SpinDec_Picture* ScrubCache::acquire()
+{
+	if (!m_configured)
+		return NULL;
+	ScrubPicture* picture = NULL;
+	if (!m_unused.empty())
+	{
+		picture = m_unused.front();
+		m_unused.pop_front();
+	}
+	else if (m_capacity == 0 || m_numPictures < m_capacity)
+	{
+		picture = allocate();
+	}
+	else if (!m_cached.empty())
+	{
+		picture = m_cached.back(); //least recently used
+		m_cached.pop_back();
+	}
+	if (!picture)
+		return NULL;
+	picture->key = -1;
+	m_acquired[picture->pic.sPic.pPlanesData] = picture;
+	return &picture->pic;
+}
+
+/***********************************************************************************************/
+ScrubPicture* ScrubCache::insert(const SpinDec_Picture* pic, int64_t key)
+{
+	std::map<const void*, ScrubPicture*>::iterator it = m_acquired.find(pic->sPic.pPlanesData);
+	if (it == m_acquired.end())
+		return NULL;
+	ScrubPicture* picture = it->second;
+	m_acquired.erase(it);
+	for (std::list<ScrubPicture*>::iterator cached = m_cached.begin(); cached != m_cached.end(); cached++)
+	{
+		if ((*cached)->key == key)
+		{
+			release(picture); //decoded twice
+			return *cached;
+		}
+	}
+	picture->key = key;
+	m_cached.push_front(picture);
+	return picture;
+}
+
+/***********************************************************************************************/
+void ScrubCache::releaseAcquired()
+{
+	for (std::map<const void*, ScrubPicture*>::iterator it = m_acquired.begin(); it != m_acquired.end(); it++)
+	{
+		release(it->second);
+	}
+	m_acquired.clear();
+}
+
+/***********************************************************************************************/
+void ScrubCache::release(ScrubPicture* picture)
+{
+	picture->key = -1;
+	m_unused.push_back(picture);
+}
@@ -1,4 +1,10 @@
 #include "Sequencer.h"
+#include "SequencerRegistry.h"
+#include "PlayerEvents.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include <float.h>
+#include <cmath>
 
 /***********************************************************************************************/
 Sequencer::Sequencer()
@@ -9,16 +15,49 @@ Sequencer::Sequencer()
 	m_decoderNumThreads = -1;
 	m_numOfPictureBuffer = -1;
 	m_maxQueueSize = -1;
-	m_logFileOpened = false;
+	m_frameDuration = 0;
+	m_currentFrameDuration = 0;
+	m_elapsedPlayingTime = 0;
+	m_currentFrameNumber = 0;
+	m_currentPtsMS = 0;
+	m_currentPresentTime = 0;
+	m_scheduleRequests = 0;
+	m_requestedFrameDuration = 0;
+	m_requestedPlayingTimeOffset = 0;
+	m_displayRefreshHz = 0;
+	m_cadence.describe(m_cadenceDescription, sizeof(m_cadenceDescription));
+	m_playbackSpeed = 1.0;
+	m_discardMode = SE_FDM_None;
+	m_pendingDiscardMode = SE_FDM_None;
+	m_pendingDiscardSince = -1;
+	m_inCadenceBreak = false;
+	m_scrubbing = false;
+	m_resolvingScrub = false;
+	m_numPresentedFrames = 0;
+	m_numDroppedFrames = 0;
+	m_numLateFrames = 0;
+	m_lastUploadTimeMs = 0;
+	m_lastDecodingTimeMs = 0;
+	m_lastFrameIntervalMs = 0;
+	m_lastErrorCode = 0;
+	m_underrun = false;
+	m_endOfStreamPosted = false;
+	m_telemetry = nullptr;
+	m_stallReported = false;
+	m_recoveryStage = -1;
 	m_decoder = new Decoder();
+	m_decoder->setEventOwner(this);
+	m_decoder->setHeartbeats(&m_heartbeats);
 	m_decoder->createDecoder(m_numOfPictureBuffer, m_decoderNumThreads, m_maxQueueSize, m_writeLogs);
+	SequencerRegistry::add(this);
 }
 
 /***********************************************************************************************/
 Sequencer::~Sequencer()
 {
+	SequencerRegistry::remove(this);
 	destroy();
-	closeLogFile();
+	delete m_telemetry; //writes the remaining records
 }
 
 /***********************************************************************************************/
@@ -34,6 +73,10 @@ void Sequencer::safeDelete(BaseTextureAccess *textureAccess)
 void Sequencer::setTextureAccess(BaseTextureAccess* textureAccess)
 {
 	m_textureAccess = textureAccess;
+	if (m_textureAccess)
+	{
+		m_textureAccess->setHeartbeats(&m_heartbeats);
+	}
 }
 
 /***********************************************************************************************/
@@ -46,6 +89,7 @@ BaseTextureAccess * Sequencer::getTextureAccess()
 VideoInformation Sequencer::loadMP4(const char* src_filename)
 {
 	m_videoInformation = m_decoder->loadMP4(src_filename);
+	m_scheduleRequests |= SCHEDULE_REQUEST_CADENCE;
 	return m_videoInformation;
 }
 
@@ -55,24 +99,34 @@ void Sequencer::play(float frameRate, bool shouldLoop)
 {
 	if (!m_decoder)
 	{
-		cout << " the file cannot be played since a decoder is not initialized!" << endl;
+		LOG_ERROR("the file cannot be played since a decoder is not initialized!");
 		return;
 	}
 
 	if (!m_decoder->isVideoFileLoaded())
 	{
-		cout << "No video file is loaded in the deocder. Please call loadMP4 before this method" << endl;
+		LOG_WARNING("No video file is loaded in the decoder. Please call loadMP4 before this method");
 	}
 
+	if (m_textureAccess)
+	{
+		m_decoder->setExternalPictureMemory(m_textureAccess->getExternalPictureMemory());
+	}
 	m_decoder->run(shouldLoop);
 	m_timer.stop();
 	m_timer.start();
 	m_frameRate = frameRate;
 	m_frameDuration = 1000.0 / frameRate;
-	m_currentFrameDuration = m_frameDuration;
+	m_requestedFrameDuration = m_frameDuration;
 	m_elapsedPlayingTime = 0;
+	m_currentPtsMS = 0;
+	m_currentPresentTime = 0;
+	m_scheduleRequests |= SCHEDULE_REQUEST_RESTART | SCHEDULE_REQUEST_FRAME_DURATION;
 	m_state = PLAYING;
 	m_isReady = false;
+	m_underrun = false;
+	m_endOfStreamPosted = false;
+	m_heartbeats.enter(WATCHDOG_STAGE_PRESENT); //a frame is expected from now on
 	//stringstream ss;
 	//ss << "Play() was called for video " << m_videoInformation.videoPath;
 	//writeToLogFile(ss.str());
@@ -83,18 +137,115 @@ void Sequencer::overrideTargetFPS(float fps)
 {
 	if (fps == 0)
 	{
-		m_currentFrameDuration = 0;
+		m_requestedFrameDuration = 0;
 	}
 	else {
-		m_currentFrameDuration = 1000.0 / fps;
+		m_requestedFrameDuration = 1000.0 / fps;
+	}
+	m_scheduleRequests |= SCHEDULE_REQUEST_FRAME_DURATION;
+}
+
+/***********************************************************************************************/
+double Sequencer::getPlaybackRate() const
+{
+	/*
+	Media time per playback time. The target frame rate is passed as float, so a rate within its precision of the
+	frame rate of the stream is taken as exactly 1, which keeps the cadence.
+	*/
+	if (m_currentFrameDuration <= 0)
+		return 0;
+	double streamFrameDuration = m_videoInformation.fps > 0 ? 1000.0 / m_videoInformation.fps : m_frameDuration;
+	double rate = streamFrameDuration / m_currentFrameDuration;
+	rate = std::fabs(rate - 1.0) < 1e-4 ? 1.0 : rate;
+	return rate * m_playbackSpeed;
+}
+
+/***********************************************************************************************/
+void Sequencer::setPlaybackSpeed(double speed)
+{
+	m_playbackSpeed = (std::min)((std::max)(speed, MIN_PLAYBACK_SPEED), MAX_PLAYBACK_SPEED);
+	m_scheduleRequests |= SCHEDULE_REQUEST_SPEED;
+}
+
+/***********************************************************************************************/
+static SE_FrameDiscardMode getDiscardModeForSpeed(double speed, SE_FrameDiscardMode current)
+{
+	double temporalSpeed = current == SE_FDM_Temporal ? KEEP_TEMPORAL_SPEED : DISCARD_TEMPORAL_SPEED;
+	double nonRefSpeed = current != SE_FDM_None ? KEEP_NON_REF_SPEED : DISCARD_NON_REF_SPEED;
+	if (speed > temporalSpeed)
+	{
+		return SE_FDM_Temporal;
+	}
+	if (speed > nonRefSpeed)
+	{
+		return SE_FDM_NonRef;
+	}
+	return SE_FDM_None;
+}
+
+/***********************************************************************************************/
+void Sequencer::updateDiscardMode()
+{
+	/*
+	The timeline follows the speed right away. The decoder only decodes the frames that can be shown: the decoding
+	of a skipped frame costs as much as that of a shown one, so at 8x it would need 8 times the decoding power. The
+	decoder has to be reopened for another discard mode, which stalls it for a few frames, so the mode only changes
+	once the speed settled in the band of the new one.
+	*/
+	double speed = m_playbackSpeed;
+	SE_FrameDiscardMode discardMode = getDiscardModeForSpeed(speed, m_discardMode);
+	if (discardMode == m_discardMode || !m_decoder)
+	{
+		m_pendingDiscardSince = -1;
+		return;
+	}
+	double now = SpinLib_GetRealTime() * 1000.0;
+	if (m_pendingDiscardSince < 0 || discardMode != m_pendingDiscardMode)
+	{
+		m_pendingDiscardMode = discardMode;
+		m_pendingDiscardSince = now;
 	}
+	if (now - m_pendingDiscardSince < DISCARD_MODE_SETTLE_MS)
+		return;
+	LOG_INFO("[" << m_videoInformation.videoPath << "] playback speed " << speed << "x, discarding " << Decoder::getDiscardModeName(discardMode) << " frames");
+	m_decoder->setDiscardMode(discardMode);
+	m_discardMode = discardMode;
+	m_pendingDiscardSince = -1;
+}
+
+/***********************************************************************************************/
+void Sequencer::setDisplayRefreshRate(double refreshRateHz)
+{
+	m_displayRefreshHz = refreshRateHz;
+	m_scheduleRequests |= SCHEDULE_REQUEST_CADENCE; //the render thread rebuilds the cadence it uses
+}
+
+/***********************************************************************************************/
+void Sequencer::updateCadence()
+{
+	m_cadence.set(m_videoInformation.frameRateNum, m_videoInformation.frameRateDen, m_displayRefreshHz);
+	m_scheduler.setCadence(m_cadence);
+	m_cadence.describe(m_cadenceDescription, sizeof(m_cadenceDescription));
+	if (m_cadence.isActive())
+	{
+		LOG_INFO("[" << m_videoInformation.videoPath << "] cadence " << m_cadenceDescription);
+	}
+}
+
+/***********************************************************************************************/
+void Sequencer::getCadenceDescription(char* buffer, int bufferSize) const
+{
+	if (!buffer || bufferSize <= 0)
+		return;
+	PlaybackSnapshot snapshot;
+	m_snapshot.read(snapshot);
+	snprintf(buffer, bufferSize, "%s", snapshot.cadenceDescription);
 }
 
 /***********************************************************************************************/
 double Sequencer::getCurrentPlayingTime()
 { 
-	//cout << "time from decoder" << m_decoder->getMediaTime() << endl;
-	return m_frameDuration * m_decoder->getCurrentFrameNumber();
+	return m_currentPtsMS;
 }
 
 /***********************************************************************************************/
@@ -110,37 +261,129 @@ void Sequencer::setTargetPlayingTime(float targetPlaybackTime)
 	{
 		return;
 	}
-	float delta = targetPlaybackTime - ((float)m_frameDuration * m_decoder->getCurrentFrameNumber()); //(m_decoder->getMediaTime() * 1000.0);
-	m_currentFrameDuration = m_frameDuration / ((delta + 1000.0f) / 1000.0f); //adjust the frame duration based on current playback time. Using a smoothing function for better playback experience.
+	m_requestedPlayingTimeOffset = targetPlaybackTime - m_timer.getElapsedTimeInMilliSec(); //the target moves on until update() takes it
+	m_scheduleRequests |= SCHEDULE_REQUEST_PLAYING_TIME;
+}
+
+/***********************************************************************************************/
+void Sequencer::applyScheduleRequests()
+{
+	/*
+	The exports that change the schedule run on the main thread while updateFrame() uses the scheduler, so they only
+	leave their values and a SCHEDULE_REQUEST flag here. A playing time requested in the same render frame as a target
+	frame rate overrides it.
+	*/
+	int requests = m_scheduleRequests.exchange(0);
+	if (requests == 0)
+		return;
+	double now = m_timer.getElapsedTimeInMilliSec();
+	if (requests & SCHEDULE_REQUEST_RESTART)
+	{
+		m_scheduler.reset();
+	}
+	if (requests & SCHEDULE_REQUEST_CADENCE)
+	{
+		updateCadence();
+	}
+	if (requests & SCHEDULE_REQUEST_FRAME_DURATION)
+	{
+		m_currentFrameDuration = m_requestedFrameDuration;
+	}
+	if (requests & SCHEDULE_REQUEST_PLAYING_TIME)
+	{
+		double playingTime = m_scheduler.hasTimeline() ? m_scheduler.getMediaTime(now) : m_currentPtsMS;
+		float delta = (std::max)((float)(m_requestedPlayingTimeOffset + now - playingTime), -900.0f);
+		m_currentFrameDuration = m_frameDuration / ((delta + 1000.0f) / 1000.0f); //adjust the frame duration based on current playback time. Using a smoothing function for better playback experience.
+	}
+	m_scheduler.setRate(getPlaybackRate(), now);
 }
 
 /***********************************************************************************************/
 bool Sequencer::update()
 {
+	TRACE_SCOPE("update");
+	m_heartbeats.setUpdateTime(SpinLib_GetRealTime() * 1000.0);
+	int recoveryStage = m_recoveryStage.exchange(-1);
+	if (recoveryStage >= 0)
+	{
+		recover((WATCHDOG_STAGE)recoveryStage);
+	}
+	applyScheduleRequests();
+	updateDiscardMode();
+	bool success = updateFrame();
+	publishSnapshot();
+	return success;
+}
+
+/***********************************************************************************************/
+bool Sequencer::updateFrame()
+{
+	if (m_textureAccess)
+	{
+		m_textureAccess->flush(); //a frame staged before must become visible even while paused
+	}
+	int errorCode = m_decoder ? m_decoder->getCurrentErrorCode() : 0;
+	if (errorCode != m_lastErrorCode)
+	{
+		if (errorCode < 0)
+		{
+			PlayerEvents::post(this, PLAYER_EVENT_ERROR, errorCode);
+		}
+		m_lastErrorCode = errorCode;
+	}
+	if ((m_scrubbing || m_resolvingScrub) && m_state != STOPPED && m_decoder)
+	{
+		return updateScrubFrame();
+	}
 	if (m_state == PAUSED || m_state == STOPPED)
 	{
+		m_heartbeats.leave(WATCHDOG_STAGE_PRESENT);
 		return false;
 	}
 
 	double currentTime = m_timer.getElapsedTimeInMilliSec();
-	if (currentTime - m_elapsedPlayingTime < m_currentFrameDuration)
+	m_scheduler.beginUpdate(currentTime);
+	const PictureContainer* out = selectFrame();
+	bool success = false;
+	if (!out && m_scheduler.isDue(m_currentPtsMS + m_frameDuration)) //the next frame is due, but not decoded yet
 	{
-		return false;
+		if (m_decoder->isFinished())
+		{
+			if (!m_endOfStreamPosted && m_isReady)
+			{
+				PlayerEvents::post(this, PLAYER_EVENT_END_OF_STREAM, m_currentFrameNumber);
+				m_endOfStreamPosted = true;
+				m_heartbeats.leave(WATCHDOG_STAGE_PRESENT);
+			}
+		}
+		else if (!m_underrun && m_isReady)
+		{
+			PlayerEvents::post(this, PLAYER_EVENT_UNDERRUN, m_currentFrameNumber); //once per underrun
+			m_underrun = true;
+			m_underrunCounter.add();
+		}
 	}
-	
-	const PictureContainer* out = m_decoder->getPic();
-	bool success = false;
 	if (out)
 	{
+		m_underrun = false;
+		bool picIsStrided = pictureIsStrided(&out->pHEVCPic->sPic);
+		m_textureAccess->setPicIsStrided(picIsStrided);
+		if (picIsStrided)
+		{
+			m_stridedCounter.add();
+		}
 		if (m_textureAccess->isReady())
 		{
+			if (!m_isReady)
+			{
+				PlayerEvents::post(this, PLAYER_EVENT_FIRST_FRAME);
+			}
 			m_isReady = true;
-			m_textureAccess->setPicIsStrided(m_decoder->getPicIsStrided());
 			if (m_pauseAfterFirstFrame)
 			{
-				if (m_decoder->getPicIsStrided())
+				if (picIsStrided)
 				{
-					cout << "picture is strided!! this can influence the performance of the playback.\n";
+					LOG_WARNING("picture is strided!! this can influence the performance of the playback.");
 				}
 				success = getAndApplyPictureData(out);
 				if (success)
@@ -161,31 +404,326 @@ bool Sequencer::update()
 	return success;
 }
 
+/***********************************************************************************************/
+bool Sequencer::updateScrubFrame()
+{
+	/*
+	While scrubbing the latest key frame is shown as soon as it is decoded and the ones before it are dropped. After
+	the scrubbing the exact frame is shown the same way, then the playback continues (or stays paused) from there.
+	*/
+	const PictureContainer* out = NULL;
+	while (m_decoder->peekPic(0))
+	{
+		out = m_decoder->getPic();
+		if (!m_scrubbing && !out->scrubbed)
+		{
+			m_resolvingScrub = false;
+			break;
+		}
+	}
+	if (!m_scrubbing && !m_decoder->isActive)
+	{
+		m_resolvingScrub = false; //nothing is decoded anymore
+	}
+	if (!out || (out->scrubbed && !m_scrubbing))
+	{
+		return false;
+	}
+
+	m_scheduler.reset(); //the frame after it starts a new timeline
+	m_textureAccess->setPicIsStrided(pictureIsStrided(&out->pHEVCPic->sPic));
+	bool success = getAndApplyPictureData(out);
+	m_elapsedPlayingTime = m_timer.getElapsedTimeInMilliSec();
+	if (m_scrubbing || m_state != PLAYING)
+	{
+		m_heartbeats.leave(WATCHDOG_STAGE_PRESENT); //no frame is expected until the next scrub position
+	}
+	return success;
+}
+
+/***********************************************************************************************/
+const PictureContainer* Sequencer::selectFrame()
+{
+	for (;;)
+	{
+		SCHEDULE_DECISION decision = m_scheduler.decide(m_decoder->peekPic(0), m_decoder->peekPic(1));
+		if (decision == SCHEDULE_SKIP)
+		{
+			TRACE_SCOPE("skip");
+			m_decoder->getPic(); //late, the frame after it is due already
+			continue;
+		}
+		if (decision == SCHEDULE_PRESENT)
+		{
+			return m_decoder->getPic();
+		}
+		if (!m_decoder->isActive && m_decoder->getQueueSize() == 1)
+		{
+			m_decoder->getPic(); //releases the last frame, which is on the texture already, so that isFinished() gets true
+		}
+		return NULL;
+	}
+}
+
+/***********************************************************************************************/
+double Sequencer::getTimeUntilNextFrame()
+{
+	if (m_state != PLAYING || !m_decoder)
+	{
+		return DBL_MAX;
+	}
+	const PictureContainer* next = m_decoder->peekPic(0);
+	return m_scheduler.getTimeUntilDue(next ? next->ptsMS : m_currentPtsMS + m_frameDuration, m_timer.getElapsedTimeInMilliSec());
+}
+
 /***********************************************************************************************/
 bool Sequencer::getAndApplyPictureData(const PictureContainer* out)
 {
+	TRACE_SCOPE_ID("present", out->frameNumber);
 	const Spin_Picture *pic = &out->pHEVCPic->sPic;
 	
-	double currentTime = 0;
-	double start = 0;
+	double currentTime = m_timer.getElapsedTimeInMilliSec();
+	double start = SpinLib_GetRealTime();
 
-	if (m_writeLogs)
+	bool success = m_textureAccess->applyPictureData(pic);
+	float uploadTime = (float)(SpinLib_GetRealTime() - start);
+
+	m_lastUploadTimeMs = uploadTime * 1000.0;
+	m_lastDecodingTimeMs = out->pHEVCPic->dDecodingTime * 1000.0;
+	m_uploadTimeHistogram.record(m_lastUploadTimeMs);
+	if (success)
 	{
-		currentTime = m_timer.getElapsedTimeInMilliSec();
-		start = SpinLib_GetRealTime();
+		double interval = currentTime - m_elapsedPlayingTime;
+		if (m_numPresentedFrames > 0)
+		{
+			m_presentIntervalHistogram.record(interval);
+		}
+		double drift = m_scheduler.framePresented(out->ptsMS);
+		if (drift > m_currentFrameDuration)
+		{
+			m_numLateFrames++;
+			m_lateCounter.add();
+		}
+		bool cadenceBreak = m_scheduler.takeCadenceBreak();
+		if (cadenceBreak && !m_inCadenceBreak)
+		{
+			PlayerEvents::post(this, PLAYER_EVENT_CADENCE_BREAK, out->frameNumber); //once until the cadence holds again
+		}
+		m_inCadenceBreak = cadenceBreak;
+		m_lastFrameIntervalMs = interval;
+		m_currentFrameNumber = out->frameNumber;
+		m_currentPtsMS = out->ptsMS;
+		m_currentPresentTime = currentTime;
+		m_numPresentedFrames++;
+		m_presentedCounter.add();
+		m_heartbeats.enter(WATCHDOG_STAGE_PRESENT); //the next frame is expected from now on
+		m_bytesCopied.add(getPictureSize(pic));
 	}
-
-	bool success = m_textureAccess->applyPictureData(pic);
-	if (m_writeLogs)
+	else
 	{
-		float uploadTime = (float)(SpinLib_GetRealTime() - start);
-		stringstream ss;
-		ss << uploadTime * 1000.0 << "\t" << out->decodingTime << "\t" << out->pHEVCPic->dDecodingTime*1000.0 << "\t" << out->pHEVCPic->dFrameLatency*1000.0 << "\t" << currentTime - m_elapsedPlayingTime << "\t" << out->decodingSteps;
-		writeToLogFile(ss.str());
+		m_numDroppedFrames++;
+		m_droppedCounter.add();
 	}
+
+	recordFrame(out, currentTime, uploadTime * 1000.0, success);
 	return success;
 }
 
+/***********************************************************************************************/
+void Sequencer::publishSnapshot()
+{
+	PlaybackSnapshot snapshot;
+	memset(&snapshot, 0, sizeof(PlaybackSnapshot));
+	snapshot.version = PLAYBACK_SNAPSHOT_VERSION;
+	snapshot.size = sizeof(PlaybackSnapshot);
+	snapshot.state = m_state;
+	snapshot.isReady = m_isReady;
+	snapshot.isFinished = m_decoder && m_decoder->isFinished();
+	snapshot.errorCode = m_decoder ? m_decoder->getCurrentErrorCode() : 0;
+	snapshot.currentFrame = m_currentFrameNumber;
+	snapshot.queueSize = m_decoder ? m_decoder->getQueueSize() : 0;
+	snapshot.ptsMS = (int64_t)llround(m_currentPtsMS);
+	snapshot.numPresentedFrames = m_numPresentedFrames;
+	snapshot.numDroppedFrames = m_numDroppedFrames;
+	snapshot.numLateFrames = m_numLateFrames;
+	snapshot.playingTimeMS = m_decoder ? getCurrentPlayingTime() : 0;
+	snapshot.targetFPS = m_currentFrameDuration > 0 ? 1000.0 / m_currentFrameDuration : 0;
+	snapshot.lastUploadTimeMS = m_lastUploadTimeMs;
+	snapshot.lastDecodingTimeMS = m_lastDecodingTimeMs;
+	snapshot.lastFrameIntervalMS = m_lastFrameIntervalMs;
+	snapshot.lastGpuUploadTimeMS = m_textureAccess ? m_textureAccess->getGpuUploadTime() : -1;
+	snapshot.driftMS = m_scheduler.getLastDrift();
+	snapshot.renderIntervalMS = m_scheduler.getRenderInterval();
+	snapshot.numSkippedFrames = m_scheduler.getNumSkippedFrames();
+	snapshot.displayRefreshHz = m_displayRefreshHz;
+	snapshot.numCadenceBreaks = m_scheduler.getNumCadenceBreaks();
+	snapshot.playbackSpeed = m_playbackSpeed;
+	snapshot.discardMode = m_decoder ? m_decoder->getDiscardMode() : SE_FDM_None;
+	snapshot.isScrubbing = m_scrubbing;
+	snapshot.numScrubCacheHits = m_decoder ? m_decoder->getNumScrubCacheHits() : 0;
+	snapshot.numScrubCacheMisses = m_decoder ? m_decoder->getNumScrubCacheMisses() : 0;
+	snapshot.numStridedFrames = m_stridedCounter.get();
+	memcpy(snapshot.cadenceDescription, m_cadenceDescription, sizeof(snapshot.cadenceDescription));
+	m_snapshot.write(snapshot);
+	updateBottleneck(snapshot.queueSize);
+}
+
+/***********************************************************************************************/
+void Sequencer::updateBottleneck(int queueSize)
+{
+	if (m_state != PLAYING || !m_decoder)
+	{
+		m_classifier.restart(); //a pause is not a bottleneck
+		return;
+	}
+	double now = SpinLib_GetRealTime() * 1000.0;
+	if (!m_classifier.addSample(now, queueSize))
+		return;
+
+	PlayerStats stats;
+	getStats(stats);
+	BottleneckReport report;
+	double targetFPS = m_currentFrameDuration > 0 ? 1000.0 / m_currentFrameDuration * m_playbackSpeed : 0; //frames per playback second
+	bool changed = m_classifier.classify(now, stats, targetFPS, m_decoder->getMaxQueueSize(), m_textureAccess ? m_textureAccess->getGpuUploadTime() : -1, report);
+	report.width = m_videoInformation.width;
+	report.height = m_videoInformation.height;
+	report.chroma = m_videoInformation.chroma_subsampling;
+	m_bottleneck.write(report);
+	if (changed)
+	{
+		char description[512];
+		BottleneckClassifier::describe(report, description, sizeof(description));
+		LOG_INFO("[" << m_videoInformation.videoPath << "] " << description);
+	}
+}
+
+/***********************************************************************************************/
+bool Sequencer::checkStall(double nowMs, double thresholdMs, StallReport& report)
+{
+	double timeSinceUpdate = m_heartbeats.getTimeSinceUpdate(nowMs);
+	int stalledStage = -1;
+	for (int i = 0; i < NUM_WATCHDOG_STAGES && stalledStage < 0; i++)
+	{
+		WATCHDOG_STAGE stage = (WATCHDOG_STAGE)i;
+		if (stage == WATCHDOG_STAGE_UPLOAD && timeSinceUpdate > thresholdMs)
+			continue; //only update() can see the copies done, so this is a present stall
+		if (m_heartbeats.getBusyTime(stage, nowMs) > thresholdMs)
+		{
+			stalledStage = i;
+		}
+	}
+	if (stalledStage < 0)
+	{
+		m_stallReported = false;
+		return false;
+	}
+	if (m_stallReported)
+		return false;
+	m_stallReported = true;
+
+	report.sequencer = this;
+	report.stage = (WATCHDOG_STAGE)stalledStage;
+	report.stalledMs = m_heartbeats.getBusyTime(report.stage, nowMs);
+	for (int i = 0; i < NUM_WATCHDOG_STAGES; i++)
+	{
+		report.busyMs[i] = m_heartbeats.getBusyTime((WATCHDOG_STAGE)i, nowMs);
+		report.numBeats[i] = m_heartbeats.getNumBeats((WATCHDOG_STAGE)i);
+	}
+	report.timeSinceUpdateMs = timeSinceUpdate;
+	getSnapshot(report.snapshot);
+	m_history.getRecords(DEFAULT_WATCHDOG_HISTORY_MS, report.frames);
+	if (Watchdog::getRecovery() != WATCHDOG_RECOVERY_NONE)
+	{
+		m_recoveryStage = stalledStage;
+	}
+	return true;
+}
+
+/***********************************************************************************************/
+void Sequencer::recover(WATCHDOG_STAGE stage)
+{
+	WATCHDOG_RECOVERY recovery = Watchdog::getRecovery();
+	LOG_WARNING("[" << m_videoInformation.videoPath << "] recovering from a " << Watchdog::getStageName(stage) << " stall: " << Watchdog::getRecoveryName(recovery));
+	switch (recovery)
+	{
+	case WATCHDOG_RECOVERY_FLUSH:
+		if (m_textureAccess)
+		{
+			m_textureAccess->clearBuffer();
+		}
+		break;
+	case WATCHDOG_RECOVERY_RESEEK:
+		if (m_decoder)
+		{
+			seekToMSec((int64_t)getCurrentPlayingTime());
+		}
+		break;
+	case WATCHDOG_RECOVERY_REOPEN:
+		if (m_decoder)
+		{
+			m_decoder->requestReopen(); //a hanging SpinDecLib_DecodeAU cannot be interrupted, the reopen waits for it
+		}
+		break;
+	default:
+		break;
+	}
+	if (m_state == PLAYING)
+	{
+		m_heartbeats.enter(WATCHDOG_STAGE_PRESENT); //give the recovery a full threshold
+	}
+}
+
+/***********************************************************************************************/
+void Sequencer::getBottleneck(BottleneckReport& report) const
+{
+	m_bottleneck.read(report);
+}
+
+/***********************************************************************************************/
+void Sequencer::getSnapshot(PlaybackSnapshot& snapshot) const
+{
+	m_snapshot.read(snapshot);
+}
+
+/***********************************************************************************************/
+void Sequencer::getStats(PlayerStats& stats) const
+{
+	memset(&stats, 0, sizeof(PlayerStats));
+	stats.version = PLAYER_STATS_VERSION;
+	stats.size = sizeof(PlayerStats);
+	if (m_decoder)
+	{
+		m_decoder->getStats(stats);
+	}
+	stats.numPresentedFrames = m_presentedCounter.get();
+	stats.numDroppedFrames = m_droppedCounter.get();
+	stats.numLateFrames = m_lateCounter.get();
+	stats.numUnderruns = m_underrunCounter.get();
+	stats.bytesCopied = m_bytesCopied.get();
+	stats.numStridedFrames = m_stridedCounter.get();
+	m_uploadTimeHistogram.getStats(stats.uploadTime);
+	m_presentIntervalHistogram.getStats(stats.presentInterval);
+	m_scheduler.getStats(stats);
+}
+
+/***********************************************************************************************/
+void Sequencer::resetStats()
+{
+	if (m_decoder)
+	{
+		m_decoder->resetStats();
+	}
+	m_presentedCounter.reset();
+	m_droppedCounter.reset();
+	m_lateCounter.reset();
+	m_underrunCounter.reset();
+	m_bytesCopied.reset();
+	m_stridedCounter.reset();
+	m_uploadTimeHistogram.reset();
+	m_presentIntervalHistogram.reset();
+	m_scheduler.resetStats();
+}
+
 /***********************************************************************************************/
 void Sequencer::destroy()
 {
@@ -212,6 +750,11 @@ void Sequencer::setPause(bool pause)
 			m_state = PAUSED;
 		}
 		else {
+			if (m_state != PLAYING)
+			{
+				m_heartbeats.enter(WATCHDOG_STAGE_PRESENT);
+				m_scheduleRequests |= SCHEDULE_REQUEST_RESTART; //the clock stood still while paused
+			}
 			m_state = PLAYING;
 		}
 	}
@@ -264,32 +807,44 @@ static string getCurrentDateTime(string s) {
 
 
 /***********************************************************************************************/
-void Sequencer::writeToLogFile(const string log)
+void Sequencer::recordFrame(const PictureContainer* out, double presentTime, double uploadTimeMs, bool success)
 {
-	if (!m_logFileOpened)
+	if (m_writeLogs && !m_telemetry)
 	{
-		string filePath = getCurrentDateTime("now") + ".txt";
-		ofs.open(filePath.c_str(), std::ios_base::out | std::ios_base::app);
-		m_logFileOpened = true;
-		cout << filePath;
+		static std::atomic<int> telemetryIndex(0);
+		stringstream filePath;
+		filePath << getCurrentDateTime("now") << "_" << telemetryIndex++ << ".bin";
+		m_telemetry = new FrameTelemetry();
+		if (m_telemetry->open(filePath.str()))
+		{
+			LOG_INFO("frame telemetry is written to " << filePath.str());
+		}
+		else
+		{
+			LOG_ERROR("could not open the telemetry file " << filePath.str());
+		}
 	}
 
-	//string now = getCurrentDateTime("now");
-	ofs << log << '\n';
-	ofs.flush();
-}
-
-/***********************************************************************************************/
-void Sequencer::closeLogFile()
-{
-	if (!m_logFileOpened)
+	FrameRecord frameRecord;
+	frameRecord.frameNumber = out->frameNumber;
+	frameRecord.ptsMS = out->ptsMS;
+	frameRecord.presentTimeMS = presentTime;
+	frameRecord.frameIntervalMS = presentTime - m_elapsedPlayingTime;
+	frameRecord.decodeMS = out->decodingTime;
+	frameRecord.decodingTimeMS = out->pHEVCPic->dDecodingTime * 1000.0;
+	frameRecord.frameLatencyMS = out->pHEVCPic->dFrameLatency * 1000.0;
+	frameRecord.uploadMS = uploadTimeMs;
+	frameRecord.queueSize = m_decoder->getQueueSize();
+	frameRecord.decodingSteps = out->decodingSteps;
+	frameRecord.qp = out->pHEVCPic->iQp;
+	frameRecord.codedSize = out->pHEVCPic->uiCodedPicSize;
+	frameRecord.uploadFailed = !success;
+	frameRecord.reserved = 0;
+	frameRecord.gpuUploadMS = m_textureAccess->getGpuUploadTime();
+	m_history.record(frameRecord);
+	if (m_writeLogs)
 	{
-		ofs << "Logfile got closed correctly." << '\n';
-
-		ofs.flush();
-		ofs.close();
-
-		m_logFileOpened = false;
+		m_telemetry->record(frameRecord);
 	}
 }
 
@@ -315,14 +870,35 @@ const VideoInformation& Sequencer::getVideoInformation()
 
 /***********************************************************************************************/
 void Sequencer::seekToMSec(int64_t seekToMSeconds) {
-	if (m_decoder->getSeekingIsSupported())
+	if (m_decoder->getSeekingIsSupported() && m_scrubbing)
 	{
-		cout << m_frameRate << " " << seekToMSeconds << endl;
+		m_decoder->scrubToMSecond(seekToMSeconds);
+	}
+	else if (m_decoder->getSeekingIsSupported())
+	{
+		LOG_DEBUG("seek to " << seekToMSeconds << " ms at " << m_frameRate << " fps");
 		m_decoder->seekToMSecond(seekToMSeconds);
 	}
 	else {
-		cout << "seeking is not supported for this video." << endl;
+		LOG_WARNING("seeking is not supported for this video.");
+	}
+}
+
+/***********************************************************************************************/
+void Sequencer::setScrubMode(bool scrubbing, int log2DownScale)
+{
+	if (!m_decoder || !m_decoder->getSeekingIsSupported())
+	{
+		LOG_WARNING("scrubbing is not supported for this video.");
+		return;
+	}
+	LOG_INFO("[" << m_videoInformation.videoPath << "] " << (scrubbing ? "scrubbing started" : "scrubbing stopped"));
+	m_decoder->setScrubMode(scrubbing, log2DownScale);
+	if (m_scrubbing && !scrubbing)
+	{
+		m_resolvingScrub = true;
 	}
+	m_scrubbing = scrubbing;
 }
 
 /***********************************************************************************************/
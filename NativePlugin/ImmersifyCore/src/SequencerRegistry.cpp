@@ -0,0 +1,120 @@
+#include "SequencerRegistry.h"
+#include "Sequencer.h"
+#include "Tracer.h"
+#include <algorithm>
+
+std::timed_mutex SequencerRegistry::s_mutex;
+std::mutex SequencerRegistry::s_readerMutex;
+std::vector<Sequencer*> SequencerRegistry::s_sequencers;
+std::atomic<double> SequencerRegistry::s_lastUpdateAllTimeMs(0);
+std::atomic<double> SequencerRegistry::s_maxUpdateAllTimeMs(0);
+std::atomic<double> SequencerRegistry::s_updateAllStartMs(-1);
+
+/***********************************************************************************************/
+void SequencerRegistry::add(Sequencer* sequencer)
+{
+	std::lock_guard<std::timed_mutex> lock(s_mutex);
+	std::lock_guard<std::mutex> readerLock(s_readerMutex);
+	s_sequencers.push_back(sequencer);
+}
+
+/***********************************************************************************************/
+void SequencerRegistry::remove(Sequencer* sequencer)
+{
+	std::lock_guard<std::timed_mutex> lock(s_mutex);
+	std::lock_guard<std::mutex> readerLock(s_readerMutex); //no snapshot of the sequencer is read anymore afterwards
+	s_sequencers.erase(std::remove(s_sequencers.begin(), s_sequencers.end(), sequencer), s_sequencers.end());
+}
+
+/***********************************************************************************************/
+int SequencerRegistry::updateAll()
+{
+	TRACE_SCOPE("update all");
+	double start = SpinLib_GetRealTime();
+	std::lock_guard<std::timed_mutex> lock(s_mutex);
+	s_updateAllStartMs = start * 1000.0;
+
+	//the frames staged with the previous event are uploaded first, so the GPU transfers overlap with the CPU copies of
+	//the new frames below
+	for (size_t i = 0; i < s_sequencers.size(); i++)
+	{
+		BaseTextureAccess* textureAccess = s_sequencers[i]->getTextureAccess();
+		if (textureAccess)
+		{
+			textureAccess->flush();
+		}
+	}
+
+	//the most overdue sequencer stages its frame first, the upload workers pick up its copies first
+	std::vector<std::pair<double, Sequencer*>> order;
+	order.reserve(s_sequencers.size());
+	for (size_t i = 0; i < s_sequencers.size(); i++)
+	{
+		order.push_back(std::make_pair(s_sequencers[i]->getTimeUntilNextFrame(), s_sequencers[i]));
+	}
+	std::stable_sort(order.begin(), order.end(), [](const std::pair<double, Sequencer*>& a, const std::pair<double, Sequencer*>& b) { return a.first < b.first; });
+
+	int numUpdated = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		if (order[i].second->getTextureAccess() && order[i].second->update())
+		{
+			numUpdated++;
+		}
+	}
+
+	double updateAllTimeMs = (SpinLib_GetRealTime() - start) * 1000.0;
+	s_lastUpdateAllTimeMs.store(updateAllTimeMs, std::memory_order_relaxed);
+	if (updateAllTimeMs > s_maxUpdateAllTimeMs.load(std::memory_order_relaxed))
+	{
+		s_maxUpdateAllTimeMs.store(updateAllTimeMs, std::memory_order_relaxed); //only written by the render thread
+	}
+	s_updateAllStartMs = -1;
+	return numUpdated;
+}
+
+/***********************************************************************************************/
+void SequencerRegistry::getSnapshots(std::vector<SequencerSnapshot>& snapshots)
+{
+	// does not wait for updateAll(), the snapshots are published through seqlocks
+	std::lock_guard<std::mutex> readerLock(s_readerMutex);
+	snapshots.resize(s_sequencers.size());
+	for (size_t i = 0; i < s_sequencers.size(); i++)
+	{
+		snapshots[i].sequencer = s_sequencers[i];
+		s_sequencers[i]->getSnapshot(snapshots[i].playback);
+		s_sequencers[i]->getBottleneck(snapshots[i].bottleneck);
+	}
+}
+
+/***********************************************************************************************/
+bool SequencerRegistry::forEach(const std::function<void(Sequencer*)>& function, unsigned int timeoutMs)
+{
+	if (!s_mutex.try_lock_for(std::chrono::milliseconds(timeoutMs)))
+		return false;
+	std::lock_guard<std::timed_mutex> lock(s_mutex, std::adopt_lock);
+	for (size_t i = 0; i < s_sequencers.size(); i++)
+	{
+		function(s_sequencers[i]);
+	}
+	return true;
+}
+
+/***********************************************************************************************/
+double SequencerRegistry::getUpdateAllBusyTime(double nowMs)
+{
+	double start = s_updateAllStartMs.load(std::memory_order_relaxed);
+	return start < 0 ? -1 : nowMs - start;
+}
+
+/***********************************************************************************************/
+double SequencerRegistry::getLastUpdateAllTimeMs()
+{
+	return s_lastUpdateAllTimeMs.load(std::memory_order_relaxed);
+}
+
+/***********************************************************************************************/
+double SequencerRegistry::getMaxUpdateAllTimeMs()
+{
+	return s_maxUpdateAllTimeMs.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,280 @@
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "TelemetryServer.h"
+#include "SequencerRegistry.h"
+#include "PlayerEvents.h"
+#include "Logger.h"
+#include <psapi.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <algorithm>
+#include <vector>
+
+const DWORD TELEMETRY_ACCEPT_TIMEOUT_MS = 200; // how fast stop() is noticed
+const DWORD TELEMETRY_RECEIVE_TIMEOUT_MS = 1000;
+
+std::atomic<bool> TelemetryServer::s_running(false);
+uintptr_t TelemetryServer::s_socket = (uintptr_t)INVALID_SOCKET;
+HANDLE TelemetryServer::s_thread = NULL;
+
+// one value per player
+struct PlayerMetric
+{
+	const char* name;
+	const char* type;	// Prometheus metric type
+	const char* help;
+	double(*get)(const SequencerSnapshot& snapshot);
+};
+
+static const PlayerMetric PLAYER_METRICS[] = {
+	{ "state", "gauge", "0 playing, 1 paused, 2 stopped", [](const SequencerSnapshot& s) { return (double)s.playback.state; } },
+	{ "ready", "gauge", "1 if the first frame is on the texture", [](const SequencerSnapshot& s) { return (double)s.playback.isReady; } },
+	{ "error_code", "gauge", "error code of the decoder", [](const SequencerSnapshot& s) { return (double)s.playback.errorCode; } },
+	{ "current_frame", "gauge", "number of the frame on the texture", [](const SequencerSnapshot& s) { return (double)s.playback.currentFrame; } },
+	{ "queue_depth", "gauge", "decoded frames waiting for the upload", [](const SequencerSnapshot& s) { return (double)s.playback.queueSize; } },
+	{ "frames_presented_total", "counter", "presented frames", [](const SequencerSnapshot& s) { return (double)s.playback.numPresentedFrames; } },
+	{ "frames_dropped_total", "counter", "frames that could not be uploaded", [](const SequencerSnapshot& s) { return (double)s.playback.numDroppedFrames; } },
+	{ "frames_late_total", "counter", "frames presented more than one frame late", [](const SequencerSnapshot& s) { return (double)s.playback.numLateFrames; } },
+	{ "frames_skipped_total", "counter", "late frames that were skipped to catch up", [](const SequencerSnapshot& s) { return (double)s.playback.numSkippedFrames; } },
+	{ "drift_ms", "gauge", "the current frame became visible this much after its target time", [](const SequencerSnapshot& s) { return s.playback.driftMS; } },
+	{ "cadence_breaks_total", "counter", "frames shown for more or less vsyncs than the pulldown cadence asks for", [](const SequencerSnapshot& s) { return (double)s.playback.numCadenceBreaks; } },
+	{ "playback_speed", "gauge", "playback speed on top of the target frame rate", [](const SequencerSnapshot& s) { return s.playback.playbackSpeed; } },
+	{ "scrub_cache_hits_total", "counter", "scrub positions whose key frame was cached", [](const SequencerSnapshot& s) { return (double)s.playback.numScrubCacheHits; } },
+	{ "scrub_cache_misses_total", "counter", "scrub positions whose key frame had to be decoded", [](const SequencerSnapshot& s) { return (double)s.playback.numScrubCacheMisses; } },
+	{ "frames_strided_total", "counter", "frames that could not take the contiguous upload path", [](const SequencerSnapshot& s) { return (double)s.playback.numStridedFrames; } },
+	{ "target_fps", "gauge", "target frame rate", [](const SequencerSnapshot& s) { return s.playback.targetFPS; } },
+	{ "fps", "gauge", "presented frames per second during the last bottleneck window", [](const SequencerSnapshot& s) { return s.bottleneck.presentedFPS; } },
+	{ "decoded_fps", "gauge", "decoded frames per second during the last bottleneck window", [](const SequencerSnapshot& s) { return s.bottleneck.decodedFPS; } },
+	{ "read_ms", "gauge", "av_read_frame time per frame during the last bottleneck window", [](const SequencerSnapshot& s) { return s.bottleneck.readMSPerFrame; } },
+	{ "decode_ms", "gauge", "SpinDecLib_DecodeAU time per frame during the last bottleneck window", [](const SequencerSnapshot& s) { return s.bottleneck.decodeMSPerFrame; } },
+	{ "upload_ms", "gauge", "render thread time of the last upload", [](const SequencerSnapshot& s) { return s.playback.lastUploadTimeMS; } },
+	{ "gpu_upload_ms", "gauge", "GPU time of the latest measured upload, -1 if unknown", [](const SequencerSnapshot& s) { return s.playback.lastGpuUploadTimeMS; } },
+	{ "frame_interval_ms", "gauge", "time between the last two presented frames", [](const SequencerSnapshot& s) { return s.playback.lastFrameIntervalMS; } },
+	{ "bottleneck", "gauge", "BOTTLENECK of the last window, 0 unknown, 1 none, 2 I/O, 3 decode, 4 upload, 5 render cadence", [](const SequencerSnapshot& s) { return (double)s.bottleneck.bottleneck; } },
+};
+static const int NUM_PLAYER_METRICS = sizeof(PLAYER_METRICS) / sizeof(PLAYER_METRICS[0]);
+
+// values of the whole process
+struct ProcessMetrics
+{
+	double numPlayers;
+	double workingSetBytes;
+	double privateBytes;
+	double lastUpdateAllMs;
+	double maxUpdateAllMs;
+	double numLostEvents;
+	double numLostLogMessages;
+};
+
+/***********************************************************************************************/
+static void getProcessMetrics(size_t numPlayers, ProcessMetrics& metrics)
+{
+	memset(&metrics, 0, sizeof(ProcessMetrics));
+	metrics.numPlayers = (double)numPlayers;
+	PROCESS_MEMORY_COUNTERS_EX memory;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&memory, sizeof(memory)))
+	{
+		metrics.workingSetBytes = (double)memory.WorkingSetSize;
+		metrics.privateBytes = (double)memory.PrivateUsage;
+	}
+	metrics.lastUpdateAllMs = SequencerRegistry::getLastUpdateAllTimeMs();
+	metrics.maxUpdateAllMs = SequencerRegistry::getMaxUpdateAllTimeMs();
+	metrics.numLostEvents = (double)PlayerEvents::getNumLostEvents();
+	metrics.numLostLogMessages = (double)Logger::getNumLostMessages();
+}
+
+/***********************************************************************************************/
+static void append(std::string& text, const char* format, ...)
+{
+	char line[512];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	if (length > 0)
+	{
+		text.append(line, (std::min)((size_t)length, sizeof(line) - 1));
+	}
+}
+
+/***********************************************************************************************/
+std::string TelemetryServer::getPrometheusText()
+{
+	std::vector<SequencerSnapshot> snapshots;
+	SequencerRegistry::getSnapshots(snapshots);
+	ProcessMetrics process;
+	getProcessMetrics(snapshots.size(), process);
+
+	std::string text;
+	const struct { const char* name; const char* type; double value; } processValues[] = {
+		{ "players", "gauge", process.numPlayers },
+		{ "process_working_set_bytes", "gauge", process.workingSetBytes },
+		{ "process_private_bytes", "gauge", process.privateBytes },
+		{ "update_all_ms", "gauge", process.lastUpdateAllMs },
+		{ "update_all_max_ms", "gauge", process.maxUpdateAllMs },
+		{ "player_events_lost_total", "counter", process.numLostEvents },
+		{ "log_messages_lost_total", "counter", process.numLostLogMessages },
+	};
+	for (size_t i = 0; i < sizeof(processValues) / sizeof(processValues[0]); i++)
+	{
+		append(text, "# TYPE immersify_%s %s\nimmersify_%s %.10g\n", processValues[i].name, processValues[i].type, processValues[i].name, processValues[i].value);
+	}
+	for (int m = 0; m < NUM_PLAYER_METRICS; m++)
+	{
+		const PlayerMetric& metric = PLAYER_METRICS[m];
+		append(text, "# HELP immersify_%s %s\n# TYPE immersify_%s %s\n", metric.name, metric.help, metric.name, metric.type);
+		for (size_t i = 0; i < snapshots.size(); i++)
+		{
+			append(text, "immersify_%s{player=\"0x%llx\"} %.10g\n", metric.name, (unsigned long long)(uintptr_t)snapshots[i].sequencer, metric.get(snapshots[i]));
+		}
+	}
+	return text;
+}
+
+/***********************************************************************************************/
+std::string TelemetryServer::getJson()
+{
+	std::vector<SequencerSnapshot> snapshots;
+	SequencerRegistry::getSnapshots(snapshots);
+	ProcessMetrics process;
+	getProcessMetrics(snapshots.size(), process);
+
+	std::string json;
+	append(json, "{\"players\": %.0f, \"processWorkingSetBytes\": %.0f, \"processPrivateBytes\": %.0f, \"updateAllMS\": %.3f, \"updateAllMaxMS\": %.3f, \"playerEventsLost\": %.0f, \"logMessagesLost\": %.0f,\n \"sequencers\": [",
+		process.numPlayers, process.workingSetBytes, process.privateBytes, process.lastUpdateAllMs, process.maxUpdateAllMs, process.numLostEvents, process.numLostLogMessages);
+	for (size_t i = 0; i < snapshots.size(); i++)
+	{
+		append(json, "%s\n  {\"player\": \"0x%llx\"", i == 0 ? "" : ",", (unsigned long long)(uintptr_t)snapshots[i].sequencer);
+		for (int m = 0; m < NUM_PLAYER_METRICS; m++)
+		{
+			append(json, ", \"%s\": %.10g", PLAYER_METRICS[m].name, PLAYER_METRICS[m].get(snapshots[i]));
+		}
+		char description[512];
+		BottleneckClassifier::describe(snapshots[i].bottleneck, description, sizeof(description));
+		append(json, ", \"bottleneckDescription\": \"%s\"}", description); //contains no quotes or backslashes
+	}
+	json += "\n ]\n}\n";
+	return json;
+}
+
+/***********************************************************************************************/
+bool TelemetryServer::start(int port)
+{
+	if (s_running)
+		return true;
+
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		LOG_ERROR("could not initialize Winsock for the telemetry server");
+		return false;
+	}
+	SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons((u_short)port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK); //never reachable from the network directly
+	if (listenSocket == INVALID_SOCKET || bind(listenSocket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR || listen(listenSocket, SOMAXCONN) == SOCKET_ERROR)
+	{
+		LOG_ERROR("the telemetry server could not listen on port " << port << ", error " << WSAGetLastError());
+		if (listenSocket != INVALID_SOCKET)
+		{
+			closesocket(listenSocket);
+		}
+		WSACleanup();
+		return false;
+	}
+
+	s_socket = (uintptr_t)listenSocket;
+	s_running = true;
+	s_thread = CreateThread(NULL, 0, run, NULL, 0, NULL);
+	LOG_INFO("telemetry server listens on 127.0.0.1:" << port);
+	return true;
+}
+
+/***********************************************************************************************/
+void TelemetryServer::stop()
+{
+	if (!s_running)
+		return;
+	s_running = false;
+	WaitForSingleObject(s_thread, INFINITE);
+	CloseHandle(s_thread);
+	s_thread = NULL;
+	closesocket((SOCKET)s_socket);
+	s_socket = (uintptr_t)INVALID_SOCKET;
+	WSACleanup();
+}
+
+/***********************************************************************************************/
+DWORD WINAPI TelemetryServer::run(void* param)
+{
+	SOCKET listenSocket = (SOCKET)s_socket;
+	while (s_running)
+	{
+		fd_set sockets;
+		FD_ZERO(&sockets);
+		FD_SET(listenSocket, &sockets);
+		timeval timeout = { 0, (long)TELEMETRY_ACCEPT_TIMEOUT_MS * 1000 };
+		if (select(0, &sockets, NULL, NULL, &timeout) <= 0)
+			continue;
+		SOCKET client = accept(listenSocket, NULL, NULL);
+		if (client == INVALID_SOCKET)
+			continue;
+		handleClient((uintptr_t)client);
+		closesocket(client);
+	}
+	return 0;
+}
+
+/***********************************************************************************************/
+static void sendAll(SOCKET client, const std::string& data)
+{
+	size_t sent = 0;
+	while (sent < data.size())
+	{
+		int result = send(client, data.c_str() + sent, (int)(data.size() - sent), 0);
+		if (result <= 0)
+			return;
+		sent += result;
+	}
+}
+
+/***********************************************************************************************/
+void TelemetryServer::handleClient(uintptr_t clientSocket)
+{
+	SOCKET client = (SOCKET)clientSocket;
+	DWORD receiveTimeout = TELEMETRY_RECEIVE_TIMEOUT_MS;
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&receiveTimeout, sizeof(receiveTimeout));
+	char request[1024];
+	int length = recv(client, request, sizeof(request) - 1, 0);
+	if (length <= 0)
+		return;
+	request[length] = 0;
+
+	// only the request line matters, e.g. "GET /metrics HTTP/1.1"
+	std::string body;
+	const char* contentType = "text/plain; charset=utf-8";
+	const char* status = "200 OK";
+	if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0)
+	{
+		body = getPrometheusText();
+		contentType = "text/plain; version=0.0.4; charset=utf-8";
+	}
+	else if (strncmp(request, "GET /stats ", 11) == 0 || strncmp(request, "GET /stats.json ", 16) == 0)
+	{
+		body = getJson();
+		contentType = "application/json";
+	}
+	else
+	{
+		status = "404 Not Found";
+		body = "use /metrics (Prometheus) or /stats (JSON)\n";
+	}
+
+	std::string response;
+	append(response, "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %u\r\nConnection: close\r\n\r\n", status, contentType, (unsigned int)body.size());
+	response += body;
+	sendAll(client, response);
+}
@@ -0,0 +1,117 @@
+#include "Tracer.h"
+#include <spincommon.h>
+#include <stdio.h>
+#include <string.h>
+
+std::atomic<bool> Tracer::s_enabled(false);
+std::mutex Tracer::s_buffersMutex;
+std::vector<ThreadTraceBuffer*> Tracer::s_buffers;
+
+// releases the buffer of a thread when the thread exits
+struct ThreadTraceBufferOwner
+{
+	ThreadTraceBuffer* buffer = nullptr;
+	~ThreadTraceBufferOwner()
+	{
+		if (buffer)
+		{
+			buffer->inUse = false;
+		}
+	}
+};
+static thread_local ThreadTraceBufferOwner t_bufferOwner;
+
+/***********************************************************************************************/
+double Tracer::nowUs()
+{
+	return SpinLib_GetRealTime() * 1000000.0;
+}
+
+/***********************************************************************************************/
+ThreadTraceBuffer* Tracer::getThreadBuffer()
+{
+	if (t_bufferOwner.buffer)
+		return t_bufferOwner.buffer;
+
+	std::lock_guard<std::mutex> lock(s_buffersMutex);
+	ThreadTraceBuffer* buffer = nullptr;
+	for (size_t i = 0; i < s_buffers.size() && !buffer; i++)
+	{
+		if (!s_buffers[i]->inUse)
+		{
+			buffer = s_buffers[i]; //the spans of the finished thread are overwritten
+		}
+	}
+	if (!buffer)
+	{
+		buffer = new ThreadTraceBuffer();
+		s_buffers.push_back(buffer);
+	}
+	buffer->inUse = true;
+	buffer->threadId = GetCurrentThreadId();
+	buffer->threadName[0] = 0;
+	buffer->numWritten = 0;
+	t_bufferOwner.buffer = buffer;
+	return buffer;
+}
+
+/***********************************************************************************************/
+void Tracer::setThreadName(const char* name)
+{
+	ThreadTraceBuffer* buffer = getThreadBuffer();
+	strncpy(buffer->threadName, name, sizeof(buffer->threadName) - 1);
+	buffer->threadName[sizeof(buffer->threadName) - 1] = 0;
+}
+
+/***********************************************************************************************/
+void Tracer::addSpan(const char* name, double startUs, double endUs, int64_t id)
+{
+	ThreadTraceBuffer* buffer = getThreadBuffer();
+	uint64_t index = buffer->numWritten.load(std::memory_order_relaxed);
+	TraceEvent& event = buffer->events[index % TRACE_EVENTS_PER_THREAD];
+	event.name = name;
+	event.startUs = startUs;
+	event.durationUs = endUs - startUs;
+	event.id = id;
+	buffer->numWritten.store(index + 1, std::memory_order_release);
+}
+
+/***********************************************************************************************/
+bool Tracer::dump(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+		return false;
+
+	std::lock_guard<std::mutex> lock(s_buffersMutex);
+	fprintf(file, "{\"traceEvents\": [\n");
+	bool first = true;
+	for (size_t i = 0; i < s_buffers.size(); i++)
+	{
+		ThreadTraceBuffer* buffer = s_buffers[i];
+		if (buffer->threadName[0])
+		{
+			fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %lu, \"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", (unsigned long)buffer->threadId, buffer->threadName);
+			first = false;
+		}
+
+		//the owning thread keeps writing, the oldest spans of the ring might be overwritten meanwhile, so they are skipped
+		uint64_t numWritten = buffer->numWritten.load(std::memory_order_acquire);
+		const uint64_t margin = TRACE_EVENTS_PER_THREAD / 16;
+		uint64_t begin = numWritten > TRACE_EVENTS_PER_THREAD - margin ? numWritten - (TRACE_EVENTS_PER_THREAD - margin) : 0;
+		for (uint64_t j = begin; j < numWritten; j++)
+		{
+			const TraceEvent& event = buffer->events[j % TRACE_EVENTS_PER_THREAD];
+			fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %lu, \"ts\": %.3f, \"dur\": %.3f", first ? "" : ",\n", event.name, (unsigned long)buffer->threadId, event.startUs, event.durationUs);
+			if (event.id >= 0)
+			{
+				fprintf(file, ", \"args\": {\"id\": %lld}", (long long)event.id);
+			}
+			fprintf(file, "}");
+			first = false;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
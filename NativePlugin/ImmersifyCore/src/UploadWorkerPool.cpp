@@ -0,0 +1,218 @@
+#include "UploadWorkerPool.h"
+#include "CopyKernels.h"
+#include "Tracer.h"
+#include <algorithm> // std::min/max are parenthesized, windows.h defines min/max macros in this target
+#include <thread>
+#include <chrono>
+
+const unsigned int MIN_UPLOAD_WORKERS = 2;
+const unsigned int MAX_UPLOAD_WORKERS = 8;
+const unsigned int SLICES_PER_WORKER = 2; //a bit more slices than workers, so that a late worker does not stall the whole frame
+const size_t MIN_SLICE_BYTES = 256 * 1024; //smaller slices cost more in synchronization than they gain in parallelism
+
+static std::mutex s_poolMutex;
+static UploadWorkerPool* s_pool = nullptr;
+static unsigned int s_poolRefCount = 0;
+
+/***********************************************************************************************/
+DWORD WINAPI UploadWorkerThread(void* Param)
+{
+	UploadWorkerPool* pool = (UploadWorkerPool*)Param;
+	Tracer::setThreadName("upload worker");
+	while (pool->runNextSlice())
+	{
+	}
+	return 0;
+}
+
+/***********************************************************************************************/
+void UploadJob::addPlane(unsigned char* dst, const unsigned char* src, unsigned int rows, unsigned int rowBytes, unsigned int srcStride)
+{
+	if (rows == 0 || rowBytes == 0)
+		return;
+	CopyRange range;
+	range.dst = dst;
+	range.src = src;
+	range.rows = rows;
+	range.rowBytes = rowBytes;
+	range.srcStride = srcStride;
+	range.dstStride = rowBytes;
+	m_planes.push_back(range);
+}
+
+/***********************************************************************************************/
+void UploadJob::addSlice(unsigned char* dst, const unsigned char* src, unsigned int rows, unsigned int rowBytes, unsigned int srcStride, unsigned int dstStride)
+{
+	if (rows == 0 || rowBytes == 0)
+		return;
+	CopyRange range;
+	range.dst = dst;
+	range.src = src;
+	range.rows = rows;
+	range.rowBytes = rowBytes;
+	range.srcStride = srcStride;
+	range.dstStride = dstStride;
+	m_slices.push_back(range);
+}
+
+/***********************************************************************************************/
+UploadWorkerPool* UploadWorkerPool::acquire()
+{
+	std::lock_guard<std::mutex> lock(s_poolMutex);
+	if (s_poolRefCount == 0)
+	{
+		unsigned int numWorkers = std::thread::hardware_concurrency() / 2; //leave the other half of the cores to the decoder
+		numWorkers = (std::max)(MIN_UPLOAD_WORKERS, (std::min)(MAX_UPLOAD_WORKERS, numWorkers));
+		s_pool = new UploadWorkerPool(numWorkers);
+	}
+	s_poolRefCount++;
+	return s_pool;
+}
+
+/***********************************************************************************************/
+void UploadWorkerPool::release()
+{
+	std::lock_guard<std::mutex> lock(s_poolMutex);
+	if (s_poolRefCount == 0)
+		return;
+	s_poolRefCount--;
+	if (s_poolRefCount == 0)
+	{
+		delete s_pool;
+		s_pool = nullptr;
+	}
+}
+
+/***********************************************************************************************/
+UploadWorkerPool::UploadWorkerPool(unsigned int numWorkers)
+{
+	m_run = true;
+	for (unsigned int i = 0; i < numWorkers; i++)
+	{
+		DWORD threadId;
+		m_threads.push_back(CreateThread(NULL, 0, UploadWorkerThread, (void*)this, 0, &threadId));
+	}
+}
+
+/***********************************************************************************************/
+UploadWorkerPool::~UploadWorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_run = false;
+		m_workCv.notify_all();
+	}
+	for (size_t i = 0; i < m_threads.size(); i++)
+	{
+		WaitForSingleObject(m_threads[i], INFINITE);
+		CloseHandle(m_threads[i]);
+	}
+	m_threads.clear();
+}
+
+/***********************************************************************************************/
+unsigned int UploadWorkerPool::getRowsPerSlice(size_t frameBytes, unsigned int rows, unsigned int rowBytes) const
+{
+	/*
+	Every plane is split into row slices of roughly the same byte size. The slice size depends on the size of the
+	whole frame and on the number of workers, so a small video ends up with a single slice per plane and an 8K 4:4:4
+	frame is spread over all workers.
+	*/
+	if (rows == 0)
+		return 0;
+	size_t sliceBytes = (std::max)(MIN_SLICE_BYTES, frameBytes / (m_threads.size() * SLICES_PER_WORKER));
+	size_t planeBytes = (size_t)rows * rowBytes;
+	unsigned int numSlices = (unsigned int)(std::min<size_t>)(rows, (std::max<size_t>)(1, (planeBytes + sliceBytes - 1) / sliceBytes));
+	return (rows + numSlices - 1) / numSlices;
+}
+
+/***********************************************************************************************/
+void UploadWorkerPool::splitIntoSlices(UploadJob* job) const
+{
+	size_t totalBytes = 0;
+	for (size_t i = 0; i < job->m_planes.size(); i++)
+	{
+		totalBytes += (size_t)job->m_planes[i].rows * job->m_planes[i].rowBytes;
+	}
+
+	for (size_t i = 0; i < job->m_planes.size(); i++)
+	{
+		const CopyRange& plane = job->m_planes[i];
+		unsigned int rowsPerSlice = getRowsPerSlice(totalBytes, plane.rows, plane.rowBytes);
+		for (unsigned int row = 0; row < plane.rows; row += rowsPerSlice)
+		{
+			CopyRange slice = plane;
+			slice.rows = (std::min)(rowsPerSlice, plane.rows - row);
+			slice.dst = plane.dst + (size_t)row * plane.dstStride;
+			slice.src = plane.src + (size_t)row * plane.srcStride;
+			job->m_slices.push_back(slice);
+		}
+	}
+	job->m_planes.clear(); //the planes are split now, a second submit must not add their slices again
+}
+
+/***********************************************************************************************/
+void UploadWorkerPool::submit(UploadJob* job)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	splitIntoSlices(job);
+	job->m_nextSlice = 0;
+	job->m_remaining = job->m_slices.size();
+	if (job->m_remaining > 0)
+	{
+		m_jobs.push_back(job);
+		m_workCv.notify_all();
+	}
+}
+
+/***********************************************************************************************/
+bool UploadWorkerPool::wait(UploadJob* job, unsigned int timeoutMs)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (timeoutMs == INFINITE)
+	{
+		m_doneCv.wait(lock, [job] { return job->m_remaining == 0; });
+		return true;
+	}
+	return m_doneCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [job] { return job->m_remaining == 0; });
+}
+
+/***********************************************************************************************/
+bool UploadWorkerPool::isDone(UploadJob* job)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return job->m_remaining == 0;
+}
+
+/***********************************************************************************************/
+bool UploadWorkerPool::runNextSlice()
+{
+	UploadJob* job;
+	CopyRange slice;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_workCv.wait(lock, [this] { return !m_run || !m_jobs.empty(); });
+		if (!m_run)
+			return false;
+		// the job is only touched while holding the mutex, its owner might destroy it as soon as m_remaining is 0
+		job = m_jobs.front();
+		slice = job->m_slices[job->m_nextSlice++];
+		if (job->m_nextSlice == job->m_slices.size())
+		{
+			m_jobs.pop_front();
+		}
+	}
+
+	{
+		TRACE_SCOPE("copy slice");
+		streamCopyRows(slice.dst, slice.dstStride, slice.src, slice.srcStride, slice.rows, slice.rowBytes);
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	job->m_remaining--;
+	if (job->m_remaining == 0)
+	{
+		m_doneCv.notify_all();
+	}
+	return true;
+}
@@ -0,0 +1,170 @@
+#include "Watchdog.h"
+#include "Sequencer.h"
+#include "SequencerRegistry.h"
+#include "PlayerEvents.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include <stdio.h>
+#include <time.h>
+
+const DWORD WATCHDOG_CHECK_INTERVAL_MS = 250;
+
+std::atomic<bool> Watchdog::s_run(false);
+std::atomic<unsigned int> Watchdog::s_thresholdMs(DEFAULT_WATCHDOG_THRESHOLD_MS);
+std::atomic<int> Watchdog::s_recovery(WATCHDOG_RECOVERY_NONE);
+std::string Watchdog::s_dumpDirectory;
+HANDLE Watchdog::s_thread = NULL;
+
+/***********************************************************************************************/
+void Watchdog::start(unsigned int thresholdMs, WATCHDOG_RECOVERY recovery, const char* dumpDirectory)
+{
+	stop();
+	s_thresholdMs = thresholdMs > 0 ? thresholdMs : DEFAULT_WATCHDOG_THRESHOLD_MS;
+	s_recovery = recovery;
+	s_dumpDirectory = dumpDirectory ? dumpDirectory : "";
+	if (!s_dumpDirectory.empty() && s_dumpDirectory.back() != '\\' && s_dumpDirectory.back() != '/')
+	{
+		s_dumpDirectory += "\\";
+	}
+	s_run = true;
+	s_thread = CreateThread(NULL, 0, run, NULL, 0, NULL);
+}
+
+/***********************************************************************************************/
+void Watchdog::stop()
+{
+	if (!s_run)
+		return;
+	s_run = false;
+	WaitForSingleObject(s_thread, INFINITE);
+	CloseHandle(s_thread);
+	s_thread = NULL;
+}
+
+/***********************************************************************************************/
+DWORD WINAPI Watchdog::run(void* param)
+{
+	Tracer::setThreadName("watchdog");
+	while (s_run)
+	{
+		Sleep(WATCHDOG_CHECK_INTERVAL_MS);
+		check();
+	}
+	return 0;
+}
+
+/***********************************************************************************************/
+void Watchdog::check()
+{
+	double now = SpinLib_GetRealTime() * 1000.0;
+	double threshold = s_thresholdMs;
+
+	// a render thread that hangs inside the batched update holds the registry, so it is checked without it
+	static bool renderStallReported = false;
+	double updateAllBusy = SequencerRegistry::getUpdateAllBusyTime(now);
+	if (updateAllBusy > threshold)
+	{
+		if (!renderStallReported)
+		{
+			renderStallReported = true;
+			LOG_ERROR("watchdog: the render thread is blocked in the update of all players for " << (int)updateAllBusy << " ms");
+			if (Tracer::isEnabled())
+			{
+				Tracer::dump(getDumpPath("render_trace.json").c_str());
+			}
+		}
+		return;
+	}
+	renderStallReported = false;
+
+	std::vector<StallReport> reports;
+	SequencerRegistry::forEach([&](Sequencer* sequencer) {
+		StallReport report;
+		if (sequencer->checkStall(now, threshold, report))
+		{
+			reports.push_back(report);
+		}
+	}, WATCHDOG_CHECK_INTERVAL_MS); //checked again with the next interval if the registry is busy
+
+	// the files are written after the registry is released again
+	for (size_t i = 0; i < reports.size(); i++)
+	{
+		const StallReport& report = reports[i];
+		LOG_ERROR("watchdog: " << getStageName(report.stage) << " stalled for " << (int)report.stalledMs << " ms (player " << report.sequencer << "), recovery: " << getRecoveryName(getRecovery()));
+		writeDump(report);
+		PlayerEvents::post(report.sequencer, PLAYER_EVENT_STALL, report.stage);
+	}
+}
+
+/***********************************************************************************************/
+std::string Watchdog::getDumpPath(const char* name)
+{
+	time_t now = time(0);
+	struct tm tstruct = *localtime(&now);
+	char dateTime[32];
+	strftime(dateTime, sizeof(dateTime), "%Y-%m-%d_%H%M%S", &tstruct);
+	return s_dumpDirectory + "stall_" + dateTime + "_" + name;
+}
+
+/***********************************************************************************************/
+void Watchdog::writeDump(const StallReport& report)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%llx", (unsigned long long)(uintptr_t)report.sequencer);
+	std::string path = getDumpPath(name);
+	FILE* out = fopen((path + ".json").c_str(), "w");
+	if (!out)
+	{
+		LOG_ERROR("watchdog: could not write " << path << ".json");
+		return;
+	}
+
+	const PlaybackSnapshot& s = report.snapshot;
+	fprintf(out, "{\"player\": \"0x%s\", \"stage\": \"%s\", \"stalledMS\": %.1f, \"thresholdMS\": %u, \"recovery\": \"%s\", \"timeSinceUpdateMS\": %.1f,\n",
+		name, getStageName(report.stage), report.stalledMs, s_thresholdMs.load(), getRecoveryName(getRecovery()), report.timeSinceUpdateMs);
+	fprintf(out, " \"stages\": [");
+	for (int i = 0; i < NUM_WATCHDOG_STAGES; i++)
+	{
+		fprintf(out, "%s{\"name\": \"%s\", \"busyMS\": %.1f, \"beats\": %lld}", i == 0 ? "" : ", ", getStageName((WATCHDOG_STAGE)i), report.busyMs[i], (long long)report.numBeats[i]);
+	}
+	fprintf(out, "],\n \"snapshot\": {\"state\": %d, \"isReady\": %d, \"isFinished\": %d, \"errorCode\": %d, \"currentFrame\": %d, \"queueSize\": %d, \"numPresentedFrames\": %lld, \"numDroppedFrames\": %lld, \"numLateFrames\": %lld, \"playingTimeMS\": %.3f, \"targetFPS\": %.3f, \"lastUploadTimeMS\": %.3f, \"lastDecodingTimeMS\": %.3f, \"lastFrameIntervalMS\": %.3f},\n",
+		s.state, s.isReady, s.isFinished, s.errorCode, s.currentFrame, s.queueSize, (long long)s.numPresentedFrames, (long long)s.numDroppedFrames, (long long)s.numLateFrames, s.playingTimeMS, s.targetFPS, s.lastUploadTimeMS, s.lastDecodingTimeMS, s.lastFrameIntervalMS);
+	fprintf(out, " \"frames\": [\n");
+	for (size_t i = 0; i < report.frames.size(); i++)
+	{
+		FrameTelemetry::writeRecord(out, report.frames[i], TELEMETRY_FORMAT_JSON, i == 0);
+	}
+	fprintf(out, "\n ]\n}\n");
+	fclose(out);
+
+	if (Tracer::isEnabled())
+	{
+		Tracer::dump((path + "_trace.json").c_str()); //what all threads did right before
+	}
+	LOG_INFO("watchdog: stall dump written to " << path << ".json");
+}
+
+/***********************************************************************************************/
+const char* Watchdog::getStageName(WATCHDOG_STAGE stage)
+{
+	switch (stage)
+	{
+	case WATCHDOG_STAGE_DEMUX: return "demux";
+	case WATCHDOG_STAGE_DECODE: return "decode";
+	case WATCHDOG_STAGE_UPLOAD: return "upload";
+	case WATCHDOG_STAGE_PRESENT: return "present";
+	default: return "unknown";
+	}
+}
+
+/***********************************************************************************************/
+const char* Watchdog::getRecoveryName(WATCHDOG_RECOVERY recovery)
+{
+	switch (recovery)
+	{
+	case WATCHDOG_RECOVERY_FLUSH: return "flush";
+	case WATCHDOG_RECOVERY_RESEEK: return "reseek";
+	case WATCHDOG_RECOVERY_REOPEN: return "reopen";
+	default: return "none";
+	}
+}
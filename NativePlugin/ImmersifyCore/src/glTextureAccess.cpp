@@ -1,103 +1,9 @@
 #include "glTextureAccess.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include "Watchdog.h"
 //The PBO implementation part of this class is based on http://www.songho.ca/opengl/gl_pbo.html. More information about implementing and using PBOs: http://www.songho.ca/opengl/gl_pbo.html
 
-///***********************************************************************************************/
-DWORD WINAPI UploadThread_1(void* Param)
-{
-	GlTextureAccess* _THIS = (GlTextureAccess*)Param;
-	while (_THIS->m_run)
-	{
-		if (_THIS->m_shouldWaitForGpuUpload_1)
-		{
-			const Spin_Plane* planeY = &_THIS->params.pic->asPlanes[0];
-			const unsigned char *dataY = reinterpret_cast<unsigned char*>(planeY->pPlane);
-			int ySize = planeY->iHeight * planeY->iWidth * 8;
-			unsigned int offsetDiv = 1; //for 4:4:4 and 4:2:0 we upload the entire Ydata to the pbo
-			
-			if (_THIS->getChromaSubSampling() == _420) //chroma subsampling is not 422 or 444
-			{
-				offsetDiv = 2;
-			}
-			
-			if (!_THIS->getPictureIsStrided())
-			{
-				std::memcpy(_THIS->params.ptr, dataY, ySize / offsetDiv);
-			}
-			else
-			{
-				GLubyte* ptrTmp = _THIS->params.ptr;
-				for (unsigned int i = 0; i < planeY->iHeight / offsetDiv; i++)
-				{
-					std::memcpy(ptrTmp, dataY + i * planeY->iStride * 8, planeY->iWidth * 8);
-					ptrTmp += planeY->iWidth * 8;
-				}
-			}
-			_THIS->m_shouldWaitForGpuUpload_1 = false;
-		}
-	}
-	return 0;
-}
-
-//
-///***********************************************************************************************/
-DWORD WINAPI UploadThread_2(void* Param)
-{
-	GlTextureAccess* _THIS = (GlTextureAccess*)Param;
-	while (_THIS->m_run)
-	{
-		if (_THIS->m_shouldWaitForGpuUpload_2)
-		{
-			//this thread is only used for 4:2:0 and 4:4:4. For 4:2:2 we do not use this thread. Read more about it in the comments above.
-
-			const Spin_Plane* planeY = &_THIS->params.pic->asPlanes[0];
-			int ySize = planeY->iHeight * planeY->iWidth * 8;
-			if (!_THIS->getPictureIsStrided())
-			{
-				if (_THIS->getChromaSubSampling() == _420)
-				{
-					const unsigned char *dataY = reinterpret_cast<unsigned char*>(planeY->pPlane);
-					std::memcpy(_THIS->params.ptr + ySize / 2, dataY + ySize / 2, ySize / 2);
-				}
-				else if (_THIS->getChromaSubSampling() == _444) //if chroma subsampling is not 422, use this thread for the third componend (cb) of the frame
-				{
-					const Spin_Plane* planeCb = &_THIS->params.pic->asPlanes[1];
-					const unsigned char *dataCb = reinterpret_cast<unsigned char*>(planeCb->pPlane);
-					int cbSize = planeCb->iHeight * planeCb->iWidth * 8;
-					std::memcpy(_THIS->params.ptr + ySize, dataCb, cbSize);
-				}
-			}
-			else
-			{
-				if (_THIS->getChromaSubSampling() == _420)
-				{
-					const unsigned char *dataY = reinterpret_cast<unsigned char*>(planeY->pPlane);
-					GLubyte* ptrTmp = _THIS->params.ptr + ySize / 2;
-					for (int i = planeY->iHeight / 2; i < planeY->iHeight; i++)
-					{
-						std::memcpy(ptrTmp, dataY + i * planeY->iStride * 8, planeY->iWidth * 8);
-						ptrTmp += planeY->iWidth * 8;
-					}
-				}
-				else if (_THIS->getChromaSubSampling() == _444) //chroma subsampling is not 422 or 444
-				{
-					const Spin_Plane* planeCb = &_THIS->params.pic->asPlanes[1];
-					const unsigned char *dataCb = reinterpret_cast<unsigned char*>(planeCb->pPlane);
-					int cbSize = planeCb->iHeight * planeCb->iWidth * 8;
-					GLubyte* ptrTmp = _THIS->params.ptr + ySize;
-					for (int i = 0; i < planeCb->iHeight; i++)
-					{
-						std::memcpy(ptrTmp, dataCb + i * planeCb->iStride * 8, planeCb->iWidth * 8);
-						ptrTmp += planeCb->iWidth * 8;
-					}
-				}
-			}
-			_THIS->m_shouldWaitForGpuUpload_2 = false;
-		}
-	}
-	return 0;
-}
-
-
 /***********************************************************************************************/
 GlTextureAccess::GlTextureAccess(uintptr_t texturePtr[], unsigned int width, unsigned int height, CHROMA_SUBSAMPLING chroma_subsampling) : BaseTextureAccess()
 {
@@ -106,53 +12,110 @@ GlTextureAccess::GlTextureAccess(uintptr_t texturePtr[], unsigned int width, uns
 	m_chroma_subsampling = chroma_subsampling;
 	m_ready = false;
 	m_picIsStrided = true;
-	m_shouldWaitForGpuUpload_1 = false;
-	m_shouldWaitForGpuUpload_2 = false;
-	m_glName[0] = (GLuint)texturePtr[0];
-	m_glName[1] = (GLuint)texturePtr[1];
-	m_glName[2] = (GLuint)texturePtr[2];
-	m_size = (m_width * m_height) / 2; 
-    if (m_chroma_subsampling == _420){
-		m_size += (m_width / 2) * (m_height / 2);
-	}
-	else if (m_chroma_subsampling == _422)
+	m_pboReady = false;
+	m_uploadPending = false;
+	m_uploadPool = UploadWorkerPool::acquire();
+	//the layout of the planes is fixed for the whole video, the stride mode is decided per frame
+	m_packed = false;
+	m_uploadPlans[0] = GlUploadPlan::create(chroma_subsampling, false, m_packed, width, height, m_uploadPool);
+	m_uploadPlans[1] = GlUploadPlan::create(chroma_subsampling, true, m_packed, width, height, m_uploadPool);
+	for (int i = 0; i < MAX_UPLOAD_PLANES; i++)
 	{
-		m_size += m_width / 2 * m_height;
+		m_glName[i] = i < m_uploadPlans[0]->getNumPlanes() ? (GLuint)texturePtr[i] : 0;
 	}
-	else if (m_chroma_subsampling == _444)
+	m_pboIds[0] = m_pboIds[1] = 0;
+	m_usePersistentMapping = false;
+	m_persistentMapping = false;
+	m_persistentPBO = 0;
+	m_persistentPtr = nullptr;
+	m_slotSize = 0;
+	m_framePending = false;
+	m_useZeroCopy = false;
+	for (int i = 0; i < NUMBER_PERSISTENT_PBO_SLOTS; i++)
 	{
-		m_size += m_width * m_height;
+		m_slotFences[i] = 0;
 	}
+	m_size = (unsigned int)m_uploadPlans[0]->getFrameSize();
 	m_curPBOIndex = 0;
-	thandle_1 = CreateThread(NULL, 0, UploadThread_1, (void*)this, 0, &threadid_1);
-	if (m_chroma_subsampling == _420 || getChromaSubSampling() == _444)
+	m_useTimerQueries = false;
+	for (int i = 0; i < NUMBER_GPU_TIMER_QUERIES; i++)
 	{
-		thandle_2 = CreateThread(NULL, 0, UploadThread_2, (void*)this, 0, &threadid_2);
+		m_timerQueries[i][0] = m_timerQueries[i][1] = 0;
+		m_timerQueryPending[i] = false;
 	}
+	m_nextTimerQuery = 0;
+	m_gpuUploadTimeMs = -1;
 
 	//max wait before dropping the frame 5 sec, for avoiding dead loops? 
 	setMaxWaitForGPUUpload(100);
 }
 
+/***********************************************************************************************/
+bool GlTextureAccess::setUsePackedTexture(bool packed)
+{
+	if (m_pboReady)
+	{
+		LOG_ERROR("the texture layout cannot be changed after the first frame.");
+		return false;
+	}
+	if (packed && m_useZeroCopy)
+	{
+		LOG_ERROR("the packed texture cannot be used with zero copy.");
+		return false;
+	}
+	m_packed = packed;
+	delete m_uploadPlans[0];
+	delete m_uploadPlans[1];
+	m_uploadPlans[0] = GlUploadPlan::create(m_chroma_subsampling, false, m_packed, m_width, m_height, m_uploadPool);
+	m_uploadPlans[1] = GlUploadPlan::create(m_chroma_subsampling, true, m_packed, m_width, m_height, m_uploadPool);
+	m_size = (unsigned int)m_uploadPlans[0]->getFrameSize();
+	return true;
+}
+
+/***********************************************************************************************/
+bool GlTextureAccess::setUseZeroCopy(bool useZeroCopy)
+{
+	if (useZeroCopy && m_packed)
+	{
+		LOG_ERROR("zero copy cannot be used with the packed texture.");
+		return false;
+	}
+	m_useZeroCopy = useZeroCopy;
+	if (useZeroCopy)
+	{
+		m_usePersistentMapping = true; //the picture memory is mapped the same way
+	}
+	return true;
+}
+
+/***********************************************************************************************/
+void GlTextureAccess::getPackedLayout(PackedTextureLayout& layout) const
+{
+	GlUploadPlan::getPackedLayout(m_chroma_subsampling, m_width, m_height, layout);
+}
+
 /***********************************************************************************************/
 GlTextureAccess::~GlTextureAccess()
 {
+	//the workers must not write into the mapped buffer anymore when it gets deleted
+	m_uploadPool->wait(&m_uploadJob);
+	UploadWorkerPool::release();
+	delete m_uploadPlans[0];
+	delete m_uploadPlans[1];
+
+	releasePersistentPBO();
+	m_pictureMemory.release();
+	if (m_useTimerQueries)
+	{
+		glDeleteQueries(NUMBER_GPU_TIMER_QUERIES * 2, &m_timerQueries[0][0]);
+	}
 	glDeleteBuffers(NUMBER_PBO, m_pboIds);
 	for (int i = 0; i < NUMBER_PBO; i++)
 	{
 		m_pboIds[i] = NULL;
 	}
-
 	m_pboReady = false;
-	m_run = false;
-	WaitForSingleObject(thandle_1, INFINITE);
-	CloseHandle(thandle_1);
-
-	if (getChromaSubSampling() == _420 || getChromaSubSampling() == _444)
-	{
-		WaitForSingleObject(thandle_2, INFINITE);
-		CloseHandle(thandle_2);
-	}
+	m_uploadPending = false;
 }
 
 /***********************************************************************************************/
@@ -161,170 +124,303 @@ void GlTextureAccess::enablePBO()
 	if (m_pboReady)
 		return;
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-	glGenBuffers(NUMBER_PBO, m_pboIds);
+	m_persistentMapping = m_usePersistentMapping && enablePersistentPBO();
+	if (!m_persistentMapping)
+	{
+		glGenBuffers(NUMBER_PBO, m_pboIds);
+		m_pictureMemory.disable(); //the decoder keeps its own memory, the zero copy pictures could not be copied
+	}
+	m_curPBOIndex = 0;
+	m_useTimerQueries = GLEW_ARB_timer_query != 0;
+	if (m_useTimerQueries)
+	{
+		glGenQueries(NUMBER_GPU_TIMER_QUERIES * 2, &m_timerQueries[0][0]);
+	}
 	m_pboReady = true;
 }
 
 /***********************************************************************************************/
-void GlTextureAccess::upladeDataToPBO(const Spin_Picture* pic, GLubyte* ptr)
+bool GlTextureAccess::beginTimerQuery()
+{
+	if (!m_useTimerQueries)
+		return false;
+	readTimerQueries();
+	if (m_timerQueryPending[m_nextTimerQuery])
+		return false; //the GPU is behind, this upload is not measured
+	glQueryCounter(m_timerQueries[m_nextTimerQuery][0], GL_TIMESTAMP);
+	return true;
+}
+
+/***********************************************************************************************/
+void GlTextureAccess::endTimerQuery()
+{
+	glQueryCounter(m_timerQueries[m_nextTimerQuery][1], GL_TIMESTAMP);
+	m_timerQueryPending[m_nextTimerQuery] = true;
+	m_nextTimerQuery = (m_nextTimerQuery + 1) % NUMBER_GPU_TIMER_QUERIES;
+}
+
+/***********************************************************************************************/
+void GlTextureAccess::readTimerQueries()
+{
+	// the queries finish in the order they were issued, so the oldest pending one is checked first
+	for (int i = 0; i < NUMBER_GPU_TIMER_QUERIES; i++)
+	{
+		unsigned int query = (m_nextTimerQuery + i) % NUMBER_GPU_TIMER_QUERIES;
+		if (!m_timerQueryPending[query])
+			continue;
+		GLint available = 0;
+		glGetQueryObjectiv(m_timerQueries[query][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			return;
+		GLuint64 start = 0;
+		GLuint64 end = 0;
+		glGetQueryObjectui64v(m_timerQueries[query][0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(m_timerQueries[query][1], GL_QUERY_RESULT, &end);
+		m_gpuUploadTimeMs = end > start ? (end - start) / 1000000.0 : 0;
+		m_timerQueryPending[query] = false;
+	}
+}
+
+/***********************************************************************************************/
+bool GlTextureAccess::enablePersistentPBO()
 {
 	/*
-	upload pixeldata to the GPU. The idea is to devide the data into equal parts (for 4:2:0 and 4:4:4 we use three parts, and for 4:2:2 two parts) and use three or two threads for those parts
-	for 4:2:0 
-	Ydata first half (thread 1)
-	Ydata second half (thread 2)
-	Cb +  Cr (main thread)
-
-	for 4:2:2
-	entire Ydata (thread 1)
-	Cb + Cr (main thread)
-
-	for 4:4:4
-	ydata (thread 1)
-	cbData (thread 2)
-	crData (main thread)
+	One buffer holds NUMBER_PERSISTENT_PBO_SLOTS frames and is mapped once for its whole lifetime. The upload workers
+	write directly into a slot, the render thread only issues the texture upload from it and puts a fence behind it.
+	A slot is written again only after its fence is signaled, i.e. after the GPU has consumed the previous frame in it.
 	*/
-	const Spin_Plane *planeY = &pic->asPlanes[0];
-	const Spin_Plane *planeCb = &pic->asPlanes[1];
-	const Spin_Plane *planeCr = &pic->asPlanes[2];
-	const unsigned char *dataCb = reinterpret_cast<unsigned char*>(planeCb->pPlane);
-	const unsigned char *dataCr = reinterpret_cast<unsigned char*>(planeCr->pPlane);
-	//cout << planeY->iWidth << " " << planeCb->iWidth << " " << planeCr->iWidth << " " << planeY->iHeight << " " << planeCb->iHeight << " " << planeCr->iHeight << endl;
+	if (!GLEW_ARB_buffer_storage && !GLEW_VERSION_4_4)
+	{
+		LOG_WARNING("persistent mapped PBOs are not supported by this context, using glMapBuffer instead.");
+		return false;
+	}
+
+	const GLsizeiptr slotAlignment = 256;
+	m_slotSize = ((GLsizeiptr)m_size + slotAlignment - 1) / slotAlignment * slotAlignment;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
 
-	int ySize = planeY->iHeight * planeY->iWidth * 8;
+	glGenBuffers(1, &m_persistentPBO);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_persistentPBO);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, m_slotSize * NUMBER_PERSISTENT_PBO_SLOTS, 0, flags);
+	m_persistentPtr = (GLubyte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_slotSize * NUMBER_PERSISTENT_PBO_SLOTS, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-	if (m_shouldWaitForGpuUpload_1 || m_shouldWaitForGpuUpload_2)
+	if (!m_persistentPtr)
 	{
-		cout << "frame dropped.\n";
-		//frame dropping
-		return;
+		LOG_WARNING("could not map the persistent PBO, using glMapBuffer instead.");
+		printGlError();
+		glDeleteBuffers(1, &m_persistentPBO);
+		m_persistentPBO = 0;
+		return false;
 	}
-	params.pic = pic;
-	params.ptr = ptr;
-	m_shouldWaitForGpuUpload_1 = true;
-	m_shouldWaitForGpuUpload_2 = getChromaSubSampling() == _420 || getChromaSubSampling() == _444;// || for 4:2:0 we use three threads. No need for waiting for this threat
-	if (!m_picIsStrided)
+	return true;
+}
+
+/***********************************************************************************************/
+void GlTextureAccess::releasePersistentPBO()
+{
+	for (int i = 0; i < NUMBER_PERSISTENT_PBO_SLOTS; i++)
 	{
-		if (m_chroma_subsampling == _420)
+		if (m_slotFences[i])
 		{
-			//_THIS->params.ptr, dataY, ySize/2 in thread 1
-			int cbSize = planeCb->iHeight * planeCb->iWidth * 8;
-			std::memcpy(ptr + ySize, dataCb, cbSize);
-			std::memcpy(ptr + ySize + cbSize, dataCr, cbSize);
-		}
-		else if (m_chroma_subsampling == _422) {
-			std::memcpy(ptr + ySize, dataCb, (ySize / 2));
-			std::memcpy(ptr + ySize + ySize / 2, dataCr, ySize / 2);
-		}
-		else if (m_chroma_subsampling == _444) {
-			int cbSize = planeCb->iHeight * planeCb->iWidth * 8;
-			int crSize = planeCr->iHeight * planeCr->iWidth * 8;
-			std::memcpy(ptr + ySize + cbSize, dataCr, crSize);
-			
+			glDeleteSync(m_slotFences[i]);
+			m_slotFences[i] = 0;
 		}
 	}
- 	else
+	if (m_persistentPBO)
 	{
-		if (m_chroma_subsampling == _420)
-		{
-			GLubyte* ptrTmp = ptr + planeY->iWidth * 8 * planeY->iHeight;
-			for (int i = 0; i < planeCb->iHeight; i++)
-			{
-				std::memcpy(ptrTmp, dataCb + i * planeCb->iStride * 8, planeCb->iWidth * 8);
-				ptrTmp += planeCb->iWidth * 8;
-			}
-
-			for (int i = 0; i < planeCr->iHeight; i++)
-			{
-				std::memcpy(ptrTmp, dataCr + i * planeCr->iStride * 8, planeCr->iWidth * 8);
-				ptrTmp += planeCr->iWidth * 8;
-			}
-		}
-		else if (m_chroma_subsampling == _422)
-		{
-			GLubyte* ptrTmp = ptr + planeY->iWidth * 8 * planeY->iHeight;
-			for (int i = 0; i < planeCb->iHeight; i++)
-			{
-				std::memcpy(ptrTmp, dataCb + i * planeCb->iStride * 8, planeCb->iWidth * 8);
-				ptrTmp += planeCb->iWidth * 8;
-			}
-
-			for (int i = 0; i < planeCr->iHeight; i++)
-			{
-				std::memcpy(ptrTmp, dataCr + i * planeCr->iStride * 8, planeCr->iWidth * 8);
-				ptrTmp += planeCr->iWidth * 8;
-			}
-		}
-		else {
-
-			GLubyte* ptrTmp = ptr + planeY->iWidth * 8 * planeY->iHeight + planeCb->iWidth * 8 * planeCb->iHeight;
-			for (int i = 0; i < planeCr->iHeight; i++)
-			{
-				std::memcpy(ptrTmp, dataCr + i * planeCr->iStride * 8, planeCr->iWidth * 8);
-				ptrTmp += planeCr->iWidth * 8;
-			}
-		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_persistentPBO);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &m_persistentPBO);
+		m_persistentPBO = 0;
+	}
+	m_persistentPtr = nullptr;
+	m_persistentMapping = false;
+}
+
+/***********************************************************************************************/
+bool GlTextureAccess::waitForSlot(unsigned int slot)
+{
+	if (!m_slotFences[slot])
+		return true;
+
+	GLuint64 timeoutNs = (GLuint64)m_maxWaitForGPUUploadMs * 1000000;
+	GLenum result = glClientWaitSync(m_slotFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNs);
+	if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+	{
+		return false;
 	}
+	glDeleteSync(m_slotFences[slot]);
+	m_slotFences[slot] = 0;
+	return true;
 }
 
+/***********************************************************************************************/
+void GlTextureAccess::upladeDataToPBO(const Spin_Picture* pic, GLubyte* ptr)
+{
+	/*
+	upload pixeldata to the GPU. The planes are stored one after another in the PBO (Y, Cb, Cr, A) and are copied by
+	the shared upload worker pool in the row slices of the upload plan. For strided pictures every row is copied
+	separately, the PBO itself is always tightly packed.
+	*/
+	m_uploadJob.clear();
+	m_uploadPlans[m_picIsStrided ? 1 : 0]->addCopies(m_uploadJob, pic, ptr);
+	m_uploadPool->submit(&m_uploadJob);
+	if (m_heartbeats)
+	{
+		m_heartbeats->enter(WATCHDOG_STAGE_UPLOAD); //until finishPendingUpload() saw the copies done
+	}
+}
 
 /***********************************************************************************************/
 void GlTextureAccess::apply()
 {
+	TRACE_SCOPE("apply");
+	m_framePending = false;
 	if (!m_glName[0])
 		return;
-	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pboIds[m_curPBOIndex]);
-	glBindTexture(GL_TEXTURE_2D, m_glName[0]);
-	glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_COMPRESSED_RED_RGTC1, (m_width * m_height) / 2, (GLvoid*)0);
 
-	if (m_chroma_subsampling == _420)
+	//the planes of the frame in the current PBO (slot) are packed without any gaps
+	bool measured = beginTimerQuery();
+	if (m_persistentMapping)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_persistentPBO);
+		m_uploadPlans[0]->uploadFrame(m_glName, m_curPBOIndex * m_slotSize);
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pboIds[m_curPBOIndex]);
+		m_uploadPlans[0]->uploadFrame(m_glName, 0);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (measured)
 	{
-		glBindTexture(GL_TEXTURE_2D, m_glName[1]);
-		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width / 2, m_height / 2, GL_COMPRESSED_RED_RGTC1, ((m_width / 2) * (m_height / 2)) / 2, (GLvoid*)((m_width * m_height) / 2));
+		endTimerQuery();
+	}
 
-		glBindTexture(GL_TEXTURE_2D, m_glName[2]);
-		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width / 2, m_height / 2, GL_COMPRESSED_RED_RGTC1, ((m_width / 2) * (m_height / 2)) / 2, (GLvoid*)((m_width / 2) * (m_height / 2) / 2 + (m_width * m_height) / 2));
+	if (m_persistentMapping)
+	{
+		// the slot can be written again as soon as the GPU is done with these uploads
+		if (m_slotFences[m_curPBOIndex])
+		{
+			glDeleteSync(m_slotFences[m_curPBOIndex]);
+		}
+		m_slotFences[m_curPBOIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 	}
-	else if (m_chroma_subsampling == _422)
+}
+
+/***********************************************************************************************/
+bool GlTextureAccess::applyZeroCopy(const Spin_Picture* pic)
+{
+	/*
+	The picture was decoded directly into the mapped picture memory, so the textures are updated straight from it. The
+	decoder must not reuse the picture before the GPU is done with it, the fence behind the upload guards it.
+	*/
+	if (m_picIsStrided || m_packed)
 	{
-		glBindTexture(GL_TEXTURE_2D, m_glName[1]);
-		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width / 2, m_height, GL_COMPRESSED_RED_RGTC1, (m_width / 2 * m_height) / 2, (GLvoid*)((m_width * m_height) / 2));
+		LOG_ERROR("a zero copy picture cannot be uploaded with gaps between the rows or into the packed texture.");
+		return false; //excluded by getExternalPictureMemory() and the decoder
+	}
+	if (!m_glName[0])
+		return true;
 
-		glBindTexture(GL_TEXTURE_2D, m_glName[2]);
-		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width / 2, m_height, GL_COMPRESSED_RED_RGTC1, (m_width / 2 * m_height) / 2, (GLvoid*)((m_width / 2 * m_height) / 2 + (m_width * m_height) / 2));
+	GLintptr planeOffsets[MAX_UPLOAD_PLANES];
+	for (int i = 0; i < m_uploadPlans[0]->getNumPlanes(); i++)
+	{
+		planeOffsets[i] = m_pictureMemory.getOffset(pic->asPlanes[i].pPlane);
 	}
-	else if (m_chroma_subsampling == _444)
+	bool measured = beginTimerQuery();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pictureMemory.getBuffer());
+	m_uploadPlans[0]->uploadTextures(m_glName, planeOffsets);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (measured)
 	{
-		glBindTexture(GL_TEXTURE_2D, m_glName[1]);
-		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_COMPRESSED_RED_RGTC1, (m_width * m_height) / 2, (GLvoid*)((m_width * m_height) / 2));
+		endTimerQuery();
+	}
+	m_pictureMemory.markInUse(pic->pPlanesData);
+	return true;
+}
 
-		glBindTexture(GL_TEXTURE_2D, m_glName[2]);
-		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_COMPRESSED_RED_RGTC1, (m_width * m_height) / 2, (GLvoid*)((m_width * m_height)));
+/***********************************************************************************************/
+ExternalPictureMemory* GlTextureAccess::getExternalPictureMemory()
+{
+	/*
+	The memory is mapped write-only, so every picture in it has to take the zero copy path, the upload workers must never
+	copy from it. The packed texture cannot take that path.
+	*/
+	if (!m_useZeroCopy || !m_usePersistentMapping || m_packed)
+		return nullptr;
+	return &m_pictureMemory;
+}
+
+/***********************************************************************************************/
+bool GlTextureAccess::finishPendingUpload(unsigned int timeoutMs)
+{
+	if (!m_uploadPending)
+		return true;
+
+	if (!m_uploadPool->wait(&m_uploadJob, timeoutMs))
+		return false;
+
+	m_uploadPending = false;
+	if (m_heartbeats)
+	{
+		m_heartbeats->leave(WATCHDOG_STAGE_UPLOAD);
 	}
+	if (m_persistentMapping)
+		return true; //nothing to unmap
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pboIds[m_curPBOIndex]);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return true;
 }
 
 /***********************************************************************************************/
 bool GlTextureAccess::applyPictureData(const Spin_Picture* pic)
 {
+	TRACE_SCOPE("stage");
 	enablePBO();  //if using Unity3d we have to initialize PBOs in this Gl-context.
-	if (m_ready)
+	if (!finishPendingUpload(m_maxWaitForGPUUploadMs))
+	{
+		LOG_WARNING("timeout for GPU upload reached!");
+		return false;
+	}
+	if (m_framePending)
+	{
+		apply();
+	}
+
+	if (m_persistentMapping && m_useZeroCopy)
 	{
-		unsigned int counter = 0;
-		while ((m_shouldWaitForGpuUpload_1 || m_shouldWaitForGpuUpload_2) && counter < m_maxWaitForGPUUploadSteps)
+		m_pictureMemory.update();
+		if (m_pictureMemory.contains(pic->pPlanesData))
 		{
-			counter++;
-			Sleep(0.1);
+			//the upload workers must not copy from the write-only mapping, the picture is uploaded from there or not at all
+			if (!applyZeroCopy(pic))
+				return false;
+			m_ready = true;
+			return true;
 		}
+	}
 
-		if (counter == m_maxWaitForGPUUploadSteps)
+	if (m_persistentMapping)
+	{
+		unsigned int nextSlot = (m_curPBOIndex + 1) % NUMBER_PERSISTENT_PBO_SLOTS;
+		if (!waitForSlot(nextSlot))
 		{
-			cout << "timeout for GPU upload reached! \n";
+			LOG_WARNING("timeout for GPU upload reached!");
 			return false;
 		}
-		apply();
+		upladeDataToPBO(pic, m_persistentPtr + nextSlot * m_slotSize);
+		m_curPBOIndex = nextSlot;
+		m_uploadPending = true;
+		m_framePending = true;
+		m_ready = true;
+		return true;
 	}
+
 	unsigned int nextPBOIndex = (m_curPBOIndex + 1) % NUMBER_PBO;
 	//prepare the next buffer
 	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pboIds[nextPBOIndex]);
@@ -333,23 +429,50 @@ bool GlTextureAccess::applyPictureData(const Spin_Picture* pic)
 
 	if (ptr)
 	{
+		//the buffer stays mapped until the workers are done, it gets unmapped right before the next apply()
 		upladeDataToPBO(pic, ptr);
-		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
 		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 		m_curPBOIndex = nextPBOIndex;
+		m_uploadPending = true;
+		m_framePending = true;
 		m_ready = true;
 		return true;
 	}
 
 	//because of some unknown reason, sometimes we get a GLError at this place right after the start. Reinitializing the PBOs fixes the problme.
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	glDeleteBuffers(NUMBER_PBO, m_pboIds);
 	m_pboReady = false;
-	cout << "Warning: Got a GL Problem. PBO will be reinitialized..." << endl;
+	LOG_WARNING("Got a GL Problem. PBO will be reinitialized...");
 	return false;
 }
 
+/***********************************************************************************************/
+void GlTextureAccess::flush()
+{
+	/*
+	Without flush() the staged frame is uploaded with the next picture. A busy upload job is not waited for, the frame
+	is uploaded by applyPictureData() then.
+	*/
+	if (!m_pboReady)
+		return;
+	if (m_useTimerQueries)
+	{
+		readTimerQueries(); //so that the result is current even if no frame is uploaded
+	}
+	if (!m_framePending)
+		return;
+	if (m_uploadPending && !m_uploadPool->isDone(&m_uploadJob))
+		return;
+	if (finishPendingUpload(0))
+	{
+		apply();
+	}
+}
+
 /***********************************************************************************************/
 void GlTextureAccess::clearBuffer()
 {
 	m_ready = false;
+	m_framePending = false;
 }
\ No newline at end of file
@@ -0,0 +1,200 @@
+/*
+Unit test of the parts of ImmersifyCore that need neither an OpenGL context nor a decoder:
+- the pulldown patterns of Cadence, including the break of 23.976 fps at 60 Hz
+- the quantiles of LatencyHistogram
+- the reuse of released spans by the allocator of the video atlas
+- the upscale of a BC4 block decoded at a lower resolution for scrubbing
+*/
+#include "AtlasSpans.h"
+#include "Cadence.h"
+#include "LatencyHistogram.h"
+#include "ScrubCache.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static int s_failures = 0;
+
+static bool check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		s_failures++;
+	}
+	return condition;
+}
+
+// true if the frames starting at 0 are shown for the repeated pattern of vsyncs
+static bool hasPattern(const Cadence& cadence, const int* pattern, int length, int numFrames)
+{
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		if (cadence.getNumVsyncs(frame) != pattern[frame % length])
+			return false;
+	}
+	return true;
+}
+
+static void testCadence()
+{
+	printf("cadence\n");
+	char description[128];
+	Cadence cadence;
+	cadence.set(24, 1, 60);
+	const int pulldown[2] = { 3, 2 };
+	check(hasPattern(cadence, pulldown, 2, 1000), "24 fps at 60 Hz is 3:2");
+	cadence.describe(description, sizeof(description));
+	check(strncmp(description, "3:2 (", 5) == 0, "24 fps at 60 Hz is described as 3:2 without a break");
+
+	cadence.set(24, 1, 120);
+	const int even[1] = { 5 };
+	check(hasPattern(cadence, even, 1, 1000), "24 fps at 120 Hz is 5:5");
+	cadence.describe(description, sizeof(description));
+	check(strncmp(description, "5:5 (", 5) == 0, "24 fps at 120 Hz is described as 5:5");
+
+	cadence.set(50, 1, 60);
+	const int pal[5] = { 1, 1, 2, 1, 1 };
+	check(hasPattern(cadence, pal, 5, 1000), "50 fps at 60 Hz is 1:1:2:1:1");
+	cadence.describe(description, sizeof(description));
+	check(strncmp(description, "1:1:2:1:1 (", 11) == 0, "50 fps at 60 Hz is described as 1:1:2:1:1");
+
+	// 3:2 needs 1000 vsyncs for 400 frames, 23.976 fps at 60 Hz needs exactly one more
+	cadence.set(24000, 1001, 60);
+	bool pulldownOnly = true;
+	bool onePerBlock = true;
+	for (int frame = 0; frame < 4000; frame++)
+	{
+		int vsyncs = cadence.getNumVsyncs(frame);
+		pulldownOnly = pulldownOnly && (vsyncs == 2 || vsyncs == 3);
+		if (frame % 400 == 0)
+		{
+			onePerBlock = onePerBlock && cadence.getVsync(frame + 400) - cadence.getVsync(frame) == 1001;
+		}
+	}
+	check(pulldownOnly, "23.976 fps at 60 Hz shows every frame for 2 or 3 vsyncs");
+	check(onePerBlock, "23.976 fps at 60 Hz gets one vsync more every 400 frames");
+	cadence.describe(description, sizeof(description));
+	check(strstr(description, "one vsync more every 400 frames") != NULL, "the break of 23.976 fps at 60 Hz is described");
+
+	// 59.94 Hz is snapped to 60000/1001, so 23.976 fps is an exact 3:2 again
+	cadence.set(24000, 1001, 59.94);
+	check(hasPattern(cadence, pulldown, 2, 4000), "23.976 fps at 59.94 Hz is 3:2 without a break");
+}
+
+static void testHistogram()
+{
+	printf("latency histogram\n");
+	LatencyHistogram histogram;
+	for (int i = 1; i <= 1000; i++)
+	{
+		histogram.record(i * 0.1); // 0.1 ms to 100 ms
+	}
+	LatencyStats stats;
+	histogram.getStats(stats);
+	check(stats.count == 1000, "every value is counted");
+	// the buckets are 1/16 of a power of two wide, their middle is at most 1/32 off
+	check(std::fabs(stats.p50MS - 50.0) <= 50.0 / 32, "p50 is within the width of a bucket");
+	check(std::fabs(stats.p90MS - 90.0) <= 90.0 / 32, "p90 is within the width of a bucket");
+	check(std::fabs(stats.minMS - 0.1) < 1e-9 && std::fabs(stats.maxMS - 100.0) < 1e-9, "min and max are exact");
+	check(std::fabs(stats.meanMS - 50.05) < 1e-6, "the mean is exact");
+
+	// values below LINEAR_HISTOGRAM_BUCKETS us have a bucket each
+	histogram.reset();
+	for (int i = 0; i < 10; i++)
+	{
+		histogram.record(i < 9 ? 0.005 : 0.020);
+	}
+	histogram.getStats(stats);
+	check(stats.p50MS == 0.005 && stats.p90MS == 0.005 && stats.p99MS == 0.020, "small values are exact");
+}
+
+static void testAtlasSpans()
+{
+	printf("atlas spans\n");
+	std::vector<AtlasSpan> freeSpans;
+	size_t end = 0;
+	const size_t limit = 200;
+	size_t a = allocateSpan(freeSpans, end, 100);
+	size_t b = allocateSpan(freeSpans, end, 50);
+	size_t c = allocateSpan(freeSpans, end, 30);
+	check(a == 0 && b == 100 && c == 150 && end == 180 && freeSpans.empty(), "the spans are allocated behind each other");
+	check(!canAllocateSpan(freeSpans, end, limit, 40), "a span does not fit behind the end");
+
+	releaseSpan(freeSpans, end, b, 50);
+	check(end == 180 && freeSpans.size() == 1, "a released span in the middle is kept free");
+	check(canAllocateSpan(freeSpans, end, limit, 40), "a released span can be allocated again");
+	size_t d = allocateSpan(freeSpans, end, 40);
+	check(d == b && end == 180, "a released span is reused instead of growing the end");
+	check(freeSpans.size() == 1 && freeSpans[0].offset == 140 && freeSpans[0].size == 10, "the rest of the span stays free");
+
+	size_t e = allocateSpan(freeSpans, end, 20);
+	check(e == 180 && end == 200, "a span that fits nowhere is allocated behind the end");
+	releaseSpan(freeSpans, end, c, 30);
+	check(freeSpans.size() == 1 && freeSpans[0].offset == 140 && freeSpans[0].size == 40, "neighbouring free spans are merged");
+	releaseSpan(freeSpans, end, e, 20);
+	check(end == 140 && freeSpans.empty(), "free spans at the end move the end back");
+	releaseSpan(freeSpans, end, a, 100);
+	releaseSpan(freeSpans, end, d, 40);
+	check(end == 0 && freeSpans.empty(), "releasing everything empties the allocator");
+}
+
+// a BC4 block with the endpoints e0 and e1 and a 3 bit index per texel in row major order
+static uint64_t makeBC4Block(uint8_t e0, uint8_t e1, const int indices[16])
+{
+	uint64_t block = (uint64_t)e0 | ((uint64_t)e1 << 8);
+	for (int i = 0; i < 16; i++)
+	{
+		block |= (uint64_t)indices[i] << (16 + 3 * i);
+	}
+	return block;
+}
+
+static void testBC4Upscale()
+{
+	printf("BC4 upscale\n");
+	const int sourceIndices[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 7, 6, 5, 4, 3, 2, 1, 0 };
+	uint64_t source = makeBC4Block(0x10, 0xF0, sourceIndices);
+	uint64_t target[4] = { 0, 0, 0, 0 };
+
+	Spin_Picture src;
+	Spin_Picture dst;
+	memset(&src, 0, sizeof(src));
+	memset(&dst, 0, sizeof(dst));
+	src.asPlanes[0].pPlane = &source;
+	src.asPlanes[0].iWidth = 1; // in blocks
+	src.asPlanes[0].iHeight = 1;
+	src.asPlanes[0].iStride = 1;
+	dst.asPlanes[0].pPlane = target;
+	dst.asPlanes[0].iWidth = 2;
+	dst.asPlanes[0].iHeight = 2;
+	dst.asPlanes[0].iStride = 2;
+	upscaleBC4Picture(&src, 1, &dst);
+
+	// every quarter of the source block becomes a block of its own, every texel is repeated 2x2
+	const int topLeft[16] = { 0, 0, 1, 1, 0, 0, 1, 1, 4, 4, 5, 5, 4, 4, 5, 5 };
+	const int topRight[16] = { 2, 2, 3, 3, 2, 2, 3, 3, 6, 6, 7, 7, 6, 6, 7, 7 };
+	const int bottomLeft[16] = { 7, 7, 6, 6, 7, 7, 6, 6, 3, 3, 2, 2, 3, 3, 2, 2 };
+	const int bottomRight[16] = { 5, 5, 4, 4, 5, 5, 4, 4, 1, 1, 0, 0, 1, 1, 0, 0 };
+	check(target[0] == makeBC4Block(0x10, 0xF0, topLeft), "the top left quarter is scaled up");
+	check(target[1] == makeBC4Block(0x10, 0xF0, topRight), "the top right quarter is scaled up");
+	check(target[2] == makeBC4Block(0x10, 0xF0, bottomLeft), "the bottom left quarter is scaled up");
+	check(target[3] == makeBC4Block(0x10, 0xF0, bottomRight), "the bottom right quarter is scaled up");
+}
+
+int main()
+{
+	testCadence();
+	testHistogram();
+	testAtlasSpans();
+	testBC4Upscale();
+
+	if (s_failures)
+	{
+		printf("%d checks failed\n", s_failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,519 @@
+/*
+Headless test of the texture upload of GlTextureAccess on Mesa's software rasterizer (llvmpipe). It creates a
+surfaceless EGL context, so that it runs without a window or a GPU, e.g. on a build server:
+
+	GALLIUM_DRIVER=llvmpipe LP_NUM_THREADS=2 GlTextureAccessTest
+
+Every frame is a BC4 4:2:0 picture with a pattern of its own, alternating between pictures with and without stride.
+The textures are read back after every upload and compared with the planes of the picture. The test covers:
+- more frames than the ring of the persistently mapped PBO has slots, with persistent mapping on and off
+- the timeout of the fence of a ring slot while the GPU is still busy, and the recovery afterwards
+- the GPU timer queries: a result after a few uploads, the ring of query pairs while all of them are in flight, and
+  that a query is reused only once its result is available
+The GPU is kept busy with a long running fragment shader, which is calibrated to run for GPU_LOAD_MS. Without
+rasterizer threads (LP_NUM_THREADS=0, the default of llvmpipe on a single core) llvmpipe renders on the calling thread,
+so the GPU is never busy and the timeout tests fail.
+*/
+#include "glTextureAccess.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+const unsigned int VIDEO_WIDTH = 256;
+const unsigned int VIDEO_HEIGHT = 128;
+const int NUMBER_PLANES = 3;
+const unsigned int STRIDE_PADDING_BLOCKS = 5; // added to the rows of strided pictures
+const unsigned char PADDING_BYTE = 0xEE;
+const int GPU_LOAD_SIZE = 1024;
+const double GPU_LOAD_MS = 2000; // much longer than staging a few frames
+
+static int s_failures = 0;
+
+static bool check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		s_failures++;
+	}
+	return condition;
+}
+
+// a BC4 4:2:0 picture like the decoder returns it, the blocks are a pattern of the frame number
+struct TestPicture
+{
+	Spin_Picture pic;
+	std::vector<unsigned char> data;
+	bool strided;
+
+	TestPicture(int frame, bool withStride)
+	{
+		strided = withStride;
+		memset(&pic, 0, sizeof(pic));
+		pic.ePixFormat = SE_PF_BC4_420;
+		size_t planeOffsets[NUMBER_PLANES];
+		size_t size = 0;
+		for (int i = 0; i < NUMBER_PLANES; i++)
+		{
+			Spin_Plane& plane = pic.asPlanes[i];
+			unsigned int width = i == 0 ? VIDEO_WIDTH : VIDEO_WIDTH / 2;
+			unsigned int height = i == 0 ? VIDEO_HEIGHT : VIDEO_HEIGHT / 2;
+			plane.iWidth = (width + 3) / 4; // in BC4 blocks of 8 bytes
+			plane.iHeight = (height + 3) / 4;
+			plane.iStride = plane.iWidth + (strided ? STRIDE_PADDING_BLOCKS : 0);
+			planeOffsets[i] = size;
+			size += (size_t)plane.iStride * 8 * plane.iHeight;
+		}
+		data.assign(size, PADDING_BYTE);
+		pic.pPlanesData = data.data();
+		pic.iAllocSize = (int)size;
+		for (int i = 0; i < NUMBER_PLANES; i++)
+		{
+			Spin_Plane& plane = pic.asPlanes[i];
+			plane.pPlane = data.data() + planeOffsets[i];
+			for (int row = 0; row < plane.iHeight; row++)
+			{
+				unsigned char* dst = (unsigned char*)plane.pPlane + (size_t)row * plane.iStride * 8;
+				for (int x = 0; x < plane.iWidth * 8; x++)
+				{
+					dst[x] = (unsigned char)(frame * 37 + i * 101 + row * 13 + x * 7);
+				}
+			}
+		}
+	}
+
+	TestPicture(const TestPicture&) = delete;
+	TestPicture& operator=(const TestPicture&) = delete;
+};
+
+static bool createContext()
+{
+	// the surfaceless platform of Mesa needs no window system, the default display is the fallback for other EGLs
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+	{
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	if (display == EGL_NO_DISPLAY)
+	{
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	EGLint major = 0;
+	EGLint minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+	{
+		printf("could not initialize EGL (0x%x)\n", eglGetError());
+		return false;
+	}
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		printf("could not create a surfaceless OpenGL 4.5 context (0x%x)\n", eglGetError());
+		return false;
+	}
+
+	// the glewInit() of test/compat resolves the entry points with eglGetProcAddress, a GLEW for GLX has no display here
+	GLenum result = glewInit();
+	if (result != GLEW_OK)
+	{
+		printf("could not initialize GLEW: %s\n", (const char*)glewGetErrorString(result));
+		return false;
+	}
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	printf("renderer: %s, %s\n", renderer, (const char*)glGetString(GL_VERSION));
+	if (!strstr(renderer, "llvmpipe"))
+	{
+		printf("note: the renderer is not llvmpipe, set GALLIUM_DRIVER=llvmpipe for reproducible timings\n");
+	}
+	return true;
+}
+
+static void createTextures(GLuint textures[NUMBER_PLANES])
+{
+	glGenTextures(NUMBER_PLANES, textures);
+	for (int i = 0; i < NUMBER_PLANES; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_COMPRESSED_RED_RGTC1, i == 0 ? VIDEO_WIDTH : VIDEO_WIDTH / 2, i == 0 ? VIDEO_HEIGHT : VIDEO_HEIGHT / 2);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// true if the textures hold the planes of pic
+static bool texturesMatch(const GLuint textures[NUMBER_PLANES], const TestPicture& pic)
+{
+	std::vector<unsigned char> texture;
+	for (int i = 0; i < NUMBER_PLANES; i++)
+	{
+		const Spin_Plane& plane = pic.pic.asPlanes[i];
+		size_t rowBytes = (size_t)plane.iWidth * 8;
+		texture.assign(rowBytes * plane.iHeight, 0);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glGetCompressedTexImage(GL_TEXTURE_2D, 0, texture.data());
+		for (int row = 0; row < plane.iHeight; row++)
+		{
+			if (memcmp(texture.data() + row * rowBytes, (const unsigned char*)plane.pPlane + (size_t)row * plane.iStride * 8, rowBytes) != 0)
+			{
+				glBindTexture(GL_TEXTURE_2D, 0);
+				return false;
+			}
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return true;
+}
+
+static bool upload(GlTextureAccess& access, const TestPicture& pic)
+{
+	access.setPicIsStrided(pic.strided);
+	return access.applyPictureData(&pic.pic);
+}
+
+// flushes until the frame staged last is on the textures
+static bool flushUntilMatch(GlTextureAccess& access, const GLuint textures[NUMBER_PLANES], const TestPicture& pic)
+{
+	for (int i = 0; i < 2000; i++)
+	{
+		access.flush();
+		if (texturesMatch(textures, pic))
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+/*
+A fragment shader that runs for a while on the whole framebuffer, all commands issued after it (the fences and timer
+queries of the upload) are done only after it.
+*/
+class GpuLoad
+{
+public:
+	GpuLoad()
+	{
+		const char* vertexSource =
+			"#version 330 core\n"
+			"void main() { gl_Position = vec4(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0, 0.0, 1.0); }\n";
+		const char* fragmentSource =
+			"#version 330 core\n"
+			"uniform int iterations;\n"
+			"out vec4 color;\n"
+			"void main() {\n"
+			"	float v = gl_FragCoord.x * 0.001;\n"
+			"	for (int i = 0; i < iterations; i++) v = sin(v * 1.0001 + gl_FragCoord.y * 0.001);\n"
+			"	color = vec4(v);\n"
+			"}\n";
+		m_program = glCreateProgram();
+		GLuint shaders[2] = { compile(GL_VERTEX_SHADER, vertexSource), compile(GL_FRAGMENT_SHADER, fragmentSource) };
+		for (int i = 0; i < 2; i++)
+		{
+			glAttachShader(m_program, shaders[i]);
+		}
+		glLinkProgram(m_program);
+		for (int i = 0; i < 2; i++)
+		{
+			glDeleteShader(shaders[i]);
+		}
+		GLint linked = 0;
+		glGetProgramiv(m_program, GL_LINK_STATUS, &linked);
+		check(linked != 0, "the shader of the GPU load links");
+
+		glGenVertexArrays(1, &m_vertexArray);
+		glGenRenderbuffers(1, &m_renderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, m_renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, GPU_LOAD_SIZE, GPU_LOAD_SIZE);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glGenFramebuffers(1, &m_framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_renderbuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		m_fence = 0;
+
+		// the time grows linearly with the iterations of the shader
+		m_iterations = 64;
+		auto start = std::chrono::steady_clock::now();
+		this->start();
+		finish();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		m_iterations = (std::max)(m_iterations, (int)(m_iterations * GPU_LOAD_MS / (std::max)(ms, 1.0)));
+	}
+
+	~GpuLoad()
+	{
+		finish();
+		glDeleteFramebuffers(1, &m_framebuffer);
+		glDeleteRenderbuffers(1, &m_renderbuffer);
+		glDeleteVertexArrays(1, &m_vertexArray);
+		glDeleteProgram(m_program);
+	}
+
+	// false if the GPU is done already, i.e. it does not run asynchronously
+	bool start()
+	{
+		finish();
+		glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+		glViewport(0, 0, GPU_LOAD_SIZE, GPU_LOAD_SIZE);
+		glUseProgram(m_program);
+		glUniform1i(glGetUniformLocation(m_program, "iterations"), m_iterations);
+		glBindVertexArray(m_vertexArray);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+		glUseProgram(0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+		return isBusy();
+	}
+
+	bool isBusy() const
+	{
+		return m_fence && glClientWaitSync(m_fence, 0, 0) == GL_TIMEOUT_EXPIRED;
+	}
+
+	void finish()
+	{
+		if (!m_fence)
+			return;
+		glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 60000000000ull);
+		glDeleteSync(m_fence);
+		m_fence = 0;
+	}
+
+private:
+	static GLuint compile(GLenum type, const char* source)
+	{
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		return shader;
+	}
+
+	GLuint m_program;
+	GLuint m_vertexArray;
+	GLuint m_renderbuffer;
+	GLuint m_framebuffer;
+	GLsync m_fence;
+	int m_iterations;
+};
+
+// more frames than the ring has slots, every texture is checked after the upload of the frame behind it
+static void testUploads(const GLuint textures[NUMBER_PLANES], bool persistentMapping)
+{
+	printf("uploads with persistent mapping %s\n", persistentMapping ? "on" : "off");
+	uintptr_t texturePtrs[NUMBER_PLANES] = { textures[0], textures[1], textures[2] };
+	GlTextureAccess access(texturePtrs, VIDEO_WIDTH, VIDEO_HEIGHT, _420);
+	access.setUsePersistentMapping(persistentMapping);
+	check(access.getGpuUploadTime() < 0, "no GPU upload time before the first upload");
+
+	const int numFrames = NUMBER_PERSISTENT_PBO_SLOTS + 3;
+	std::vector<TestPicture*> pictures; // the upload workers read from a picture until the next frame is staged
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		pictures.push_back(new TestPicture(frame, frame % 2 == 1));
+		if (!check(upload(access, *pictures[frame]), "a frame is staged"))
+			break;
+		if (frame == 0)
+		{
+			check(access.getUsesPersistentMapping() == persistentMapping, "the requested upload path is used");
+		}
+		else
+		{
+			check(texturesMatch(textures, *pictures[frame - 1]), "the textures hold the frame before");
+		}
+		check(glGetError() == GL_NO_ERROR, "no GL error during the upload");
+	}
+	if ((int)pictures.size() == numFrames)
+	{
+		check(flushUntilMatch(access, textures, *pictures.back()), "flush() uploads the last frame");
+	}
+
+	if (GLEW_ARB_timer_query)
+	{
+		glFinish();
+		access.flush(); //reads the timer queries
+		check(access.getGpuUploadTime() >= 0, "the GPU upload time is measured after a few uploads");
+	}
+	for (size_t i = 0; i < pictures.size(); i++)
+	{
+		delete pictures[i];
+	}
+}
+
+/*
+The slot after the current one is still read by the GPU, so applyPictureData() gives up after the maximum wait. The
+texture access has to recover once the GPU is done, without losing or mixing up frames.
+*/
+static void testFenceTimeout(const GLuint textures[NUMBER_PLANES], GpuLoad& load)
+{
+	printf("fence timeout of a ring slot\n");
+	uintptr_t texturePtrs[NUMBER_PLANES] = { textures[0], textures[1], textures[2] };
+	GlTextureAccess access(texturePtrs, VIDEO_WIDTH, VIDEO_HEIGHT, _420);
+	access.setUsePersistentMapping(true);
+	TestPicture frame0(0, false);
+	if (!check(upload(access, frame0) && access.getUsesPersistentMapping(), "the persistent PBO is used"))
+		return;
+
+	// the frames 0 and 1 are uploaded from the slots 1 and 2 behind the load, frame 2 is written into slot 0
+	TestPicture frame1(1, true);
+	TestPicture frame2(2, false);
+	TestPicture frame3(3, true);
+	if (!check(load.start(), "the GPU runs asynchronously (LP_NUM_THREADS > 0 for llvmpipe)"))
+		return;
+	check(upload(access, frame1), "frame 1 is staged");
+	check(upload(access, frame2), "frame 2 is staged");
+	// frame 2 is uploaded from slot 0, frame 3 has to wait for slot 1
+	access.setMaxWaitForGPUUpload(1);
+	check(!upload(access, frame3), "the frame is not staged while its slot is still read by the GPU");
+	check(load.isBusy(), "the frames in front of the timeout do not wait for the GPU");
+
+	access.setMaxWaitForGPUUpload(60000);
+	check(upload(access, frame3), "the frame is staged once the GPU is done");
+	check(texturesMatch(textures, frame2), "the frame in front of the timeout is on the textures");
+	TestPicture frame4(4, false);
+	check(upload(access, frame4), "the ring continues after the timeout");
+	check(texturesMatch(textures, frame3), "the frame staged after the timeout is on the textures");
+	check(flushUntilMatch(access, textures, frame4), "flush() uploads the last frame");
+	check(glGetError() == GL_NO_ERROR, "no GL error around the timeout");
+}
+
+/*
+Records the glQueryCounter() calls of the texture access through the GLEW entry point. A query object of the ring may
+only be issued again once the result of its previous use is available (GL_QUERY_RESULT_AVAILABLE).
+*/
+static PFNGLQUERYCOUNTERPROC s_queryCounter = NULL;
+static std::set<GLuint> s_issuedQueries;
+static int s_numQueriesIssued = 0;
+static int s_numQueriesReusedInFlight = 0;
+
+static void GLAPIENTRY recordQueryCounter(GLuint id, GLenum target)
+{
+	if (s_issuedQueries.count(id))
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			s_numQueriesReusedInFlight++;
+		}
+	}
+	s_issuedQueries.insert(id);
+	s_numQueriesIssued++;
+	s_queryCounter(id, target);
+}
+
+static void recordQueries(bool record)
+{
+	if (record && !s_queryCounter)
+	{
+		s_queryCounter = glQueryCounter;
+		glQueryCounter = recordQueryCounter;
+	}
+	else if (!record && s_queryCounter)
+	{
+		glQueryCounter = s_queryCounter;
+		s_queryCounter = NULL;
+	}
+	s_issuedQueries.clear();
+	s_numQueriesIssued = 0;
+	s_numQueriesReusedInFlight = 0;
+}
+
+/*
+All query pairs of the ring are issued behind the load, the uploads after them are not measured. No result may be
+read while they are in flight, and once the GPU is done the ring has to measure the uploads again.
+*/
+static void testTimerQueriesInFlight(const GLuint textures[NUMBER_PLANES], GpuLoad& load)
+{
+	if (!GLEW_ARB_timer_query)
+	{
+		printf("timer queries are not supported, skipped\n");
+		return;
+	}
+	printf("timer queries in flight\n");
+	uintptr_t texturePtrs[NUMBER_PLANES] = { textures[0], textures[1], textures[2] };
+	GlTextureAccess access(texturePtrs, VIDEO_WIDTH, VIDEO_HEIGHT, _420);
+	access.setUsePersistentMapping(false); //the ring of the persistent PBO would wait for its slots behind the load
+	const int numFrames = NUMBER_GPU_TIMER_QUERIES + 2;
+	std::vector<TestPicture*> pictures;
+	if (!check(load.start(), "the GPU runs asynchronously (LP_NUM_THREADS > 0 for llvmpipe)"))
+		return;
+	recordQueries(true);
+	bool staged = true;
+	for (int frame = 0; frame < numFrames && staged; frame++)
+	{
+		pictures.push_back(new TestPicture(frame, frame % 2 == 1));
+		staged = upload(access, *pictures[frame]);
+	}
+	check(staged, "the frames are staged while the queries are in flight");
+	access.flush();
+	check(s_numQueriesIssued == NUMBER_GPU_TIMER_QUERIES * 2, "only the pairs of the ring are issued while all of them are in flight");
+	check(load.isBusy(), "the uploads do not wait for the queries in flight");
+	check(access.getGpuUploadTime() < 0, "no upload time is read while all queries are in flight");
+	load.finish();
+	if (staged)
+	{
+		check(flushUntilMatch(access, textures, *pictures.back()), "the frames are uploaded while the queries are in flight");
+	}
+	glFinish();
+	access.flush();
+	check(access.getGpuUploadTime() >= 0, "the upload time is read once the queries are done");
+
+	// the ring measures again: every upload gets a pair, and the results arrive
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		TestPicture pic(numFrames + frame, frame % 2 == 0);
+		check(upload(access, pic), "a frame is staged after the queries are done");
+		check(flushUntilMatch(access, textures, pic), "the frame is uploaded after the queries are done");
+		glFinish();
+		access.flush();
+		double ms = access.getGpuUploadTime();
+		check(ms >= 0 && ms < GPU_LOAD_MS, "the upload time stays valid");
+	}
+	check(s_numQueriesIssued == (NUMBER_GPU_TIMER_QUERIES + numFrames) * 2, "every upload after the load is measured");
+	check(s_issuedQueries.size() == NUMBER_GPU_TIMER_QUERIES * 2, "the query objects of the ring are reused");
+	check(s_numQueriesReusedInFlight == 0, "a query is reused only once its result is available");
+	recordQueries(false);
+	check(glGetError() == GL_NO_ERROR, "no GL error around the timer queries");
+	for (size_t i = 0; i < pictures.size(); i++)
+	{
+		delete pictures[i];
+	}
+}
+
+int main()
+{
+	if (!createContext())
+		return 1;
+	GLuint textures[NUMBER_PLANES];
+	createTextures(textures);
+
+	testUploads(textures, true);
+	testUploads(textures, false);
+	{
+		GpuLoad load;
+		testFenceTimeout(textures, load);
+		testTimerQueriesInFlight(textures, load);
+	}
+	glDeleteTextures(NUMBER_PLANES, textures);
+
+	if (s_failures)
+	{
+		printf("%d checks failed\n", s_failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,101 @@
+/*
+A replacement of the GLEW library for the Linux build of the headless GL test. The prebuilt GLEW of libs/glew is a
+Windows library, and a GLEW built for GLX fails in glewInit() without a GLX display. This one resolves the entry points
+with eglGetProcAddress, which works for the surfaceless context of the test. It covers only the functions and flags
+used by the test and the sources it links, a missing one is reported by the linker.
+*/
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <string.h>
+
+#define GLEW_COMPAT_FUNCTIONS \
+	GLEW_COMPAT_FUNCTION(AttachShader) \
+	GLEW_COMPAT_FUNCTION(BindBuffer) \
+	GLEW_COMPAT_FUNCTION(BindFramebuffer) \
+	GLEW_COMPAT_FUNCTION(BindRenderbuffer) \
+	GLEW_COMPAT_FUNCTION(BindVertexArray) \
+	GLEW_COMPAT_FUNCTION(BufferData) \
+	GLEW_COMPAT_FUNCTION(BufferStorage) \
+	GLEW_COMPAT_FUNCTION(ClientWaitSync) \
+	GLEW_COMPAT_FUNCTION(CompileShader) \
+	GLEW_COMPAT_FUNCTION(CompressedTexSubImage2D) \
+	GLEW_COMPAT_FUNCTION(CreateProgram) \
+	GLEW_COMPAT_FUNCTION(CreateShader) \
+	GLEW_COMPAT_FUNCTION(DeleteBuffers) \
+	GLEW_COMPAT_FUNCTION(DeleteFramebuffers) \
+	GLEW_COMPAT_FUNCTION(DeleteProgram) \
+	GLEW_COMPAT_FUNCTION(DeleteQueries) \
+	GLEW_COMPAT_FUNCTION(DeleteRenderbuffers) \
+	GLEW_COMPAT_FUNCTION(DeleteShader) \
+	GLEW_COMPAT_FUNCTION(DeleteSync) \
+	GLEW_COMPAT_FUNCTION(DeleteVertexArrays) \
+	GLEW_COMPAT_FUNCTION(FenceSync) \
+	GLEW_COMPAT_FUNCTION(FramebufferRenderbuffer) \
+	GLEW_COMPAT_FUNCTION(GenBuffers) \
+	GLEW_COMPAT_FUNCTION(GenFramebuffers) \
+	GLEW_COMPAT_FUNCTION(GenQueries) \
+	GLEW_COMPAT_FUNCTION(GenRenderbuffers) \
+	GLEW_COMPAT_FUNCTION(GenVertexArrays) \
+	GLEW_COMPAT_FUNCTION(GetCompressedTexImage) \
+	GLEW_COMPAT_FUNCTION(GetProgramiv) \
+	GLEW_COMPAT_FUNCTION(GetQueryObjectiv) \
+	GLEW_COMPAT_FUNCTION(GetQueryObjectui64v) \
+	GLEW_COMPAT_FUNCTION(GetStringi) \
+	GLEW_COMPAT_FUNCTION(GetUniformLocation) \
+	GLEW_COMPAT_FUNCTION(LinkProgram) \
+	GLEW_COMPAT_FUNCTION(MapBuffer) \
+	GLEW_COMPAT_FUNCTION(MapBufferRange) \
+	GLEW_COMPAT_FUNCTION(QueryCounter) \
+	GLEW_COMPAT_FUNCTION(RenderbufferStorage) \
+	GLEW_COMPAT_FUNCTION(ShaderSource) \
+	GLEW_COMPAT_FUNCTION(TexStorage2D) \
+	GLEW_COMPAT_FUNCTION(Uniform1i) \
+	GLEW_COMPAT_FUNCTION(UnmapBuffer) \
+	GLEW_COMPAT_FUNCTION(UseProgram)
+
+#define GLEW_COMPAT_FUNCTION(name) decltype(__glew##name) __glew##name = NULL;
+GLEW_COMPAT_FUNCTIONS
+#undef GLEW_COMPAT_FUNCTION
+
+GLboolean __GLEW_VERSION_4_4 = GL_FALSE;
+GLboolean __GLEW_ARB_buffer_storage = GL_FALSE;
+GLboolean __GLEW_ARB_timer_query = GL_FALSE;
+
+/***********************************************************************************************/
+static GLboolean hasExtension(const char* extension)
+{
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; i++)
+	{
+		const char* name = (const char*)__glewGetStringi(GL_EXTENSIONS, i);
+		if (name && strcmp(name, extension) == 0)
+			return GL_TRUE;
+	}
+	return GL_FALSE;
+}
+
+/***********************************************************************************************/
+GLenum GLEWAPIENTRY glewInit(void)
+{
+#define GLEW_COMPAT_FUNCTION(name) __glew##name = (decltype(__glew##name))eglGetProcAddress("gl" #name);
+	GLEW_COMPAT_FUNCTIONS
+#undef GLEW_COMPAT_FUNCTION
+
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major == 0 || !__glewGetStringi)
+		return GLEW_ERROR_NO_GL_VERSION;
+	__GLEW_VERSION_4_4 = major > 4 || (major == 4 && minor >= 4) ? GL_TRUE : GL_FALSE;
+	__GLEW_ARB_buffer_storage = __GLEW_VERSION_4_4 || hasExtension("GL_ARB_buffer_storage") ? GL_TRUE : GL_FALSE;
+	__GLEW_ARB_timer_query = major > 3 || (major == 3 && minor >= 3) || hasExtension("GL_ARB_timer_query") ? GL_TRUE : GL_FALSE;
+	return GLEW_OK;
+}
+
+/***********************************************************************************************/
+const GLubyte* GLEWAPIENTRY glewGetErrorString(GLenum error)
+{
+	return (const GLubyte*)(error == GLEW_OK ? "No error" : "Missing GL version");
+}
@@ -0,0 +1,67 @@
+/*
+What the Windows build of the GL test gets from kernel32 and spinlib_rms, implemented with the standard library for
+its Linux build. Only the calls made by the sources of the test are covered.
+*/
+#include "windows.h"
+#include <spincommon.h>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+struct CompatThread
+{
+	std::thread thread;
+};
+
+/***********************************************************************************************/
+HANDLE CreateThread(void*, size_t, LPTHREAD_START_ROUTINE start, void* param, DWORD, DWORD* threadId)
+{
+	CompatThread* handle = new CompatThread;
+	handle->thread = std::thread([start, param]() { start(param); });
+	if (threadId)
+	{
+		*threadId = (DWORD)std::hash<std::thread::id>()(handle->thread.get_id());
+	}
+	return handle;
+}
+
+/***********************************************************************************************/
+DWORD WaitForSingleObject(HANDLE handle, DWORD)
+{
+	CompatThread* thread = (CompatThread*)handle;
+	if (thread->thread.joinable())
+	{
+		thread->thread.join();
+	}
+	return 0;
+}
+
+/***********************************************************************************************/
+BOOL CloseHandle(HANDLE handle)
+{
+	CompatThread* thread = (CompatThread*)handle;
+	if (thread->thread.joinable())
+	{
+		thread->thread.detach();
+	}
+	delete thread;
+	return TRUE;
+}
+
+/***********************************************************************************************/
+void Sleep(DWORD ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/***********************************************************************************************/
+DWORD GetCurrentThreadId()
+{
+	return (DWORD)std::hash<std::thread::id>()(std::this_thread::get_id());
+}
+
+/***********************************************************************************************/
+extern "C" double SpinLib_GetRealTime(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
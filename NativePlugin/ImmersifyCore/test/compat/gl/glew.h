@@ -0,0 +1,3 @@
+#pragma once
+// the sources include <gl/glew.h>, which only resolves on a case insensitive file system
+#include <GL/glew.h>
@@ -0,0 +1,29 @@
+#pragma once
+
+#ifndef __compat_windows_H__
+#define __compat_windows_H__
+
+/*
+The part of the Win32 API used by the sources of the headless GL test, for its Linux build only (see
+LinuxCompat.cpp). The Windows build never sees this directory.
+*/
+#include <stddef.h>
+#include <stdint.h>
+
+typedef void* HANDLE;
+typedef unsigned long DWORD;
+typedef int BOOL;
+typedef DWORD (*LPTHREAD_START_ROUTINE)(void* param);
+
+#define WINAPI
+#define INFINITE 0xFFFFFFFF
+#define TRUE 1
+#define FALSE 0
+
+HANDLE CreateThread(void* attributes, size_t stackSize, LPTHREAD_START_ROUTINE start, void* param, DWORD flags, DWORD* threadId);
+DWORD WaitForSingleObject(HANDLE handle, DWORD timeoutMs); // threads only, the timeout is ignored
+BOOL CloseHandle(HANDLE handle);
+void Sleep(DWORD ms);
+DWORD GetCurrentThreadId();
+
+#endif
@@ -8,6 +8,14 @@
 #include "Sequencer.h"
 #include "glTextureAccess.h"
 #include "DxTextureAccess.h"
+#include "GlVideoAtlas.h"
+#include "AtlasTextureAccess.h"
+#include "SequencerRegistry.h"
+#include "PlayerEvents.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include "TelemetryServer.h"
+#include "Watchdog.h"
 
 using namespace std;
 
@@ -62,7 +70,43 @@ void UNITY_INTERFACE_API OnRenderEventFunc(int eventID, void *sequencer)
 	}
 	catch (std::exception &e)
 	{
-		std::cerr << "caught exception in " << __func__ << ": " << e.what() << std::endl;
+		LOG_ERROR("caught exception in " << __func__ << ": " << e.what());
+	}
+}
+
+void UNITY_INTERFACE_API OnUpdateAllRenderEventFunc(int eventID)
+{
+	// updates all sequencers with one event, the eventID is not used
+	try
+	{
+		SequencerRegistry::updateAll();
+	}
+	catch (std::exception &e)
+	{
+		LOG_ERROR("caught exception in " << __func__ << ": " << e.what());
+	}
+}
+
+void UNITY_INTERFACE_API OnAtlasRenderEventFunc(int eventID, void *atlas)
+{
+	// negative eventIDs delete the atlas, all other eventIDs commit it. A commit has to be issued after the update
+	// events of all sequencers of the atlas.
+	try
+	{
+		if (atlas != nullptr)
+		{
+			if (eventID < 0)
+			{
+				delete static_cast<GlVideoAtlas*>(atlas);
+				return;
+			}
+
+			static_cast<GlVideoAtlas*>(atlas)->commit();
+		}
+	}
+	catch (std::exception &e)
+	{
+		LOG_ERROR("caught exception in " << __func__ << ": " << e.what());
 	}
 }
 
@@ -78,27 +122,112 @@ extern "C" intptr_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API CreateSequencer(c
 	return (intptr_t)sequencer;
 }
 
-extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API InitPlayer(Sequencer *sequencer, uintptr_t texturePtr1, uintptr_t texturePtr2, uintptr_t texturePtr3, int format)
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API InitPlayerWithAlpha(Sequencer *sequencer, uintptr_t texturePtr1, uintptr_t texturePtr2, uintptr_t texturePtr3, uintptr_t texturePtr4, int format)
 {
-	uintptr_t texturePtrArr[3];
+	// texturePtr4 is the alpha plane of 4:4:4:4 videos, the chroma textures are not used (0) for 4:0:0 videos
+	uintptr_t texturePtrArr[4];
 	texturePtrArr[0] = texturePtr1;
 	texturePtrArr[1] = texturePtr2;
 	texturePtrArr[2] = texturePtr3;
+	texturePtrArr[3] = texturePtr4;
 
 	const VideoInformation& vi = sequencer->getVideoInformation();
 	BaseTextureAccess* textureAccess = s_CurrentAPI->InitTexture(texturePtrArr, vi.width, vi.height, format, vi.chroma_subsampling);
 	sequencer->setTextureAccess(textureAccess);
 }
 
-extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API Play(Sequencer *sequencer, float framerate, bool shouldLoop)
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API InitPlayer(Sequencer *sequencer, uintptr_t texturePtr1, uintptr_t texturePtr2, uintptr_t texturePtr3, int format)
 {
-	// Depending on type:
-	BaseTextureAccess* baseTextureAccess = sequencer->getTextureAccess();
-	if (s_DeviceType == kUnityGfxRendererOpenGLCore)
+	InitPlayerWithAlpha(sequencer, texturePtr1, texturePtr2, texturePtr3, 0, format);
+}
+
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API InitPlayerPacked(Sequencer *sequencer, uintptr_t texturePtr, int format)
+{
+	// one BC4 texture with all planes, the size and the position of the planes are returned by GetPackedLayout
+	if (s_DeviceType != kUnityGfxRendererOpenGLCore)
 	{
-		// We already have PBO's initialized. so we have to skip the last frame
-		((GlTextureAccess*)baseTextureAccess)->clearBuffer();
+		LOG_ERROR("the packed texture layout is only supported for OpenGL.");
+		return false;
 	}
+	InitPlayerWithAlpha(sequencer, texturePtr, 0, 0, 0, format);
+	GlTextureAccess* glTextureAccess = dynamic_cast<GlTextureAccess*>(sequencer->getTextureAccess());
+	if (!glTextureAccess)
+		return false;
+	return glTextureAccess->setUsePackedTexture(true);
+}
+
+static int copyPackedLayout(const PackedTextureLayout& packedLayout, int* layout, int layoutSize)
+{
+	int values[3 + MAX_UPLOAD_PLANES * 4];
+	values[0] = packedLayout.textureWidth;
+	values[1] = packedLayout.textureHeight;
+	values[2] = packedLayout.numPlanes;
+	for (int i = 0; i < MAX_UPLOAD_PLANES; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			values[3 + i * 4 + j] = packedLayout.planeRects[i][j];
+		}
+	}
+	int numValues = 3 + packedLayout.numPlanes * 4;
+	for (int i = 0; i < numValues && i < layoutSize; i++)
+	{
+		layout[i] = values[i];
+	}
+	return numValues;
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetPackedLayout(Sequencer *sequencer, int* layout, int layoutSize)
+{
+	// layout: texture width, texture height, number of planes, followed by x, y, width, height (in pixels) per plane
+	const VideoInformation& vi = sequencer->getVideoInformation();
+	PackedTextureLayout packedLayout;
+	GlUploadPlan::getPackedLayout(vi.chroma_subsampling, vi.width, vi.height, packedLayout);
+	return copyPackedLayout(packedLayout, layout, layoutSize);
+}
+
+extern "C" intptr_t UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API CreateVideoAtlas(uintptr_t texturePtr, int width, int height)
+{
+	// one BC4 texture for many small videos, it has to be deleted with a negative eventID of GetAtlasRenderEventFunc on the render thread
+	if (s_DeviceType != kUnityGfxRendererOpenGLCore)
+	{
+		LOG_ERROR("the video atlas is only supported for OpenGL.");
+		return 0;
+	}
+	return (intptr_t)new GlVideoAtlas((GLuint)texturePtr, width, height);
+}
+
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API InitPlayerAtlas(Sequencer *sequencer, GlVideoAtlas* atlas)
+{
+	// the video gets a region of the atlas, its frames are uploaded by the commit event of GetAtlasRenderEventFunc
+	if (!atlas)
+		return false;
+	const VideoInformation& vi = sequencer->getVideoInformation();
+	AtlasTextureAccess* textureAccess = new AtlasTextureAccess(atlas, vi.width, vi.height, vi.chroma_subsampling);
+	if (!textureAccess->hasRegion())
+	{
+		delete textureAccess;
+		return false;
+	}
+	sequencer->setTextureAccess(textureAccess);
+	return true;
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetAtlasLayout(Sequencer *sequencer, int* layout, int layoutSize)
+{
+	// same as GetPackedLayout, the texture size is the size of the atlas and the planes are inside the region of the video
+	AtlasTextureAccess* textureAccess = dynamic_cast<AtlasTextureAccess*>(sequencer->getTextureAccess());
+	if (!textureAccess)
+		return 0;
+	PackedTextureLayout packedLayout;
+	textureAccess->getLayout(packedLayout);
+	return copyPackedLayout(packedLayout, layout, layoutSize);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API Play(Sequencer *sequencer, float framerate, bool shouldLoop)
+{
+	// We already have PBO's initialized. so we have to skip the last frame
+	sequencer->getTextureAccess()->clearBuffer();
 
 	const VideoInformation& videoInformation = sequencer->getVideoInformation();
 
@@ -110,6 +239,119 @@ extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API Play(Sequencer *seque
 	sequencer->play(framerate, shouldLoop);
 }
 
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetPersistentMappedUpload(Sequencer *sequencer, bool persistentMapping)
+{
+	// has to be called before Play. Uploads through one persistently mapped PBO with a fenced ring of slots instead of
+	// mapping a PBO every frame, OpenGL only. Returns false if the texture access does not support it.
+	GlTextureAccess* glTextureAccess = dynamic_cast<GlTextureAccess*>(sequencer->getTextureAccess());
+	if (!glTextureAccess)
+		return !persistentMapping;
+	glTextureAccess->setUsePersistentMapping(persistentMapping);
+	return true;
+}
+
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetZeroCopyUpload(Sequencer *sequencer, bool zeroCopy)
+{
+	// has to be called before Play. Only OpenGL supports decoding directly into the upload buffers, and not into the
+	// packed texture. Returns false if zero copy cannot be used.
+	GlTextureAccess* glTextureAccess = dynamic_cast<GlTextureAccess*>(sequencer->getTextureAccess());
+	if (!glTextureAccess)
+		return !zeroCopy;
+	return glTextureAccess->setUseZeroCopy(zeroCopy);
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetPlaybackSnapshot(Sequencer *sequencer, PlaybackSnapshot* snapshot, int snapshotSize)
+{
+	// replaces the single getters below with one call. snapshotSize is the size of the struct known to the caller, only
+	// that many bytes are written. Returns PLAYBACK_SNAPSHOT_VERSION.
+	PlaybackSnapshot current;
+	sequencer->getSnapshot(current);
+	memcpy(snapshot, &current, (std::min)((size_t)(std::max)(snapshotSize, 0), sizeof(PlaybackSnapshot)));
+	return PLAYBACK_SNAPSHOT_VERSION;
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetStats(Sequencer *sequencer, PlayerStats* stats, int statsSize)
+{
+	// counters and latency percentiles since the start or the last ResetStats, sized like GetPlaybackSnapshot.
+	// Returns PLAYER_STATS_VERSION.
+	PlayerStats current;
+	sequencer->getStats(current);
+	memcpy(stats, &current, (std::min)((size_t)(std::max)(statsSize, 0), sizeof(PlayerStats)));
+	return PLAYER_STATS_VERSION;
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ResetStats(Sequencer *sequencer)
+{
+	sequencer->resetStats();
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetBottleneck(Sequencer *sequencer, BottleneckReport* report, int reportSize)
+{
+	// the stage that limited the frame rate during the last window with the numbers behind it, sized like
+	// GetPlaybackSnapshot. Returns the BOTTLENECK.
+	BottleneckReport current;
+	sequencer->getBottleneck(current);
+	memcpy(report, &current, (std::min)((size_t)(std::max)(reportSize, 0), sizeof(BottleneckReport)));
+	return current.bottleneck;
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetBottleneckDescription(Sequencer *sequencer, char* buffer, int bufferSize)
+{
+	// the same as one readable line, e.g. "decode bound at 7680x4320 444, 43.0 fps sustained (target 60.0), ..."
+	BottleneckReport current;
+	sequencer->getBottleneck(current);
+	BottleneckClassifier::describe(current, buffer, bufferSize);
+	return current.bottleneck;
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetPlaybackSpeed(Sequencer *sequencer, float speed)
+{
+	// 0.1 to 8 times the frame rate. Above 1.5x the decoder skips frames that cannot be shown before decoding them.
+	sequencer->setPlaybackSpeed(speed);
+}
+
+extern "C" float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetPlaybackSpeed(Sequencer *sequencer)
+{
+	return (float)sequencer->getPlaybackSpeed();
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetScrubMode(Sequencer *sequencer, bool scrubbing, int log2DownScale)
+{
+	// while scrubbing SeekToMSec shows the key frame before the position, decoded at 1 / 2^log2DownScale (0 to 2) of
+	// the resolution and cached. Stopping it shows the exact frame of the last position.
+	sequencer->setScrubMode(scrubbing, log2DownScale);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetDisplayRefreshRate(Sequencer *sequencer, double refreshRateHz)
+{
+	// refresh rate of the display (e.g. Screen.currentResolution.refreshRateRatio), lets the frames follow a pulldown
+	// cadence like 3:2. 0 if unknown.
+	sequencer->setDisplayRefreshRate(refreshRateHz);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCadenceDescription(Sequencer *sequencer, char* buffer, int bufferSize)
+{
+	// e.g. "3:2, one vsync more every 400 frames (23.976 fps at 60.00 Hz)"
+	sequencer->getCadenceDescription(buffer, bufferSize);
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API PollPlayerEvents(PlayerEvent* events, int maxEvents)
+{
+	// drains the events of all players (once per frame from the main thread), returns the number of events written
+	return PlayerEvents::poll(events, maxEvents);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RegisterPlayerEventCallback(PlayerEventCallback callback)
+{
+	PlayerEvents::registerCallback(callback);
+}
+
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API DispatchPlayerEvents()
+{
+	// calls the registered callback for every queued event on the calling thread
+	return PlayerEvents::dispatch();
+}
+
 extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API IsReady(Sequencer *sequencer)
 {
 	return sequencer->isReady();
@@ -193,11 +435,98 @@ extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetMaxQueueSize(Sequen
 	return sequencer->getMaxQueueSize();
 }
 
+extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetNumStridedFrames(Sequencer *sequencer)
+{
+	return sequencer->getNumStridedFrames();
+}
+
+extern "C" float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetLastUpdateAllTimeMS()
+{
+	// render thread time of the last event of GetUpdateAllRenderEventFunc
+	return (float)SequencerRegistry::getLastUpdateAllTimeMs();
+}
+
+extern "C" float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetMaxUpdateAllTimeMS()
+{
+	return (float)SequencerRegistry::getMaxUpdateAllTimeMs();
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetLogLevel(int level)
+{
+	// LOG_LEVEL, -1 disables the log
+	Logger::setLevel(level);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RegisterLogCallback(FuncCallBack callback, int sinks)
+{
+	// sinks is a combination of LOG_SINK, the callback is called by the logger thread
+	Logger::setUnityCallback(callback);
+	Logger::setSinks(sinks);
+}
+
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetLogFile(const char* path)
+{
+	// the file is written if LOG_SINK_FILE is set, NULL closes it
+	return Logger::setLogFile(path);
+}
+
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ExportTelemetry(const char* binaryPath, const char* outputPath, int format)
+{
+	// converts a telemetry file written with shouldLog into TELEMETRY_FORMAT (0 = CSV, 1 = JSON)
+	return FrameTelemetry::exportRecords(binaryPath, outputPath, (TELEMETRY_FORMAT)format);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API EnableTrace(bool enable)
+{
+	Tracer::setEnabled(enable);
+}
+
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API DumpTrace(const char* path)
+{
+	// writes the recorded spans of all threads as Chrome trace event JSON (chrome://tracing, Perfetto)
+	return Tracer::dump(path);
+}
+
+extern "C" bool UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StartTelemetryServer(int port)
+{
+	// serves the stats of all players on 127.0.0.1:port, /metrics in the Prometheus text format and /stats as JSON
+	return TelemetryServer::start(port > 0 ? port : DEFAULT_TELEMETRY_PORT);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StopTelemetryServer()
+{
+	TelemetryServer::stop();
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StartWatchdog(int thresholdMs, int recovery, const char* dumpDirectory)
+{
+	// reports pipeline stages that make no progress for thresholdMs with PLAYER_EVENT_STALL and a dump into dumpDirectory,
+	// recovery is a WATCHDOG_RECOVERY
+	Watchdog::start(thresholdMs > 0 ? thresholdMs : 0, (WATCHDOG_RECOVERY)recovery, dumpDirectory);
+}
+
+extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StopWatchdog()
+{
+	Watchdog::stop();
+}
+
 extern "C" UnityRenderingEventAndData UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetRenderEventFunc()
 {
 	return OnRenderEventFunc;
 }
 
+extern "C" UnityRenderingEvent UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetUpdateAllRenderEventFunc()
+{
+	// for GL.IssuePluginEvent, replaces the update events of the single sequencers
+	return OnUpdateAllRenderEventFunc;
+}
+
+extern "C" UnityRenderingEventAndData UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetAtlasRenderEventFunc()
+{
+	// the data of the events is a GlVideoAtlas from CreateVideoAtlas
+	return OnAtlasRenderEventFunc;
+}
+
 extern "C" int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCurrentErrorCode(Sequencer *sequencer)
 {
 	return (int)sequencer->getCurrentErrorCode();
@@ -215,4 +544,7 @@ extern "C" void	UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginLoad(IUnit
 extern "C" void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload()
 {
 	s_Graphics->UnregisterDeviceEventCallback(OnGraphicsDeviceEvent);
+	Watchdog::stop();
+	TelemetryServer::stop();
+	Logger::shutdown();
 }